@@ -27,41 +27,111 @@
 
 extern const std::byte *DivinityMagic;
 
+// Moving more than this many bytes to make room for new metadata is reported as slow
+const int64_t LargeMoveSize = 256 * 1024 * 1024;
+
+/**
+ * @brief Move the chunks stored where the metadata is about to grow to the end of the resource file
+ *
+ * Only the chunks overlapping the new metadata region are copied, instead of shifting the whole data section,
+ * and their info entries are pointed to the copies.
+ *
+ * @param storage ContainerStorage object containing the resource to modify, with all the payloads written
+ * @param resourceContainer ResourceContainer object containing the resources's data
+ * @param info Info section to update
+ * @param dataAdd Number of bytes the metadata grows by
+ * @return Number of bytes moved, or -1 on error
+ */
+static int64_t MoveChunksOutOfMetadata(ContainerStorage &storage, ResourceContainer &resourceContainer, std::vector<std::byte> &info, int64_t dataAdd)
+{
+    int64_t metadataEnd = resourceContainer.DataOffset + dataAdd;
+    int64_t moveStart = -1, moveEnd = -1;
+
+    for (size_t i = 0; i < info.size() / 0x90; i++) {
+        int64_t fileOffset, compressedSize;
+        std::copy(info.begin() + 0x38 + i * 0x90, info.begin() + 0x40 + i * 0x90, (std::byte*)&fileOffset);
+        std::copy(info.begin() + 0x40 + i * 0x90, info.begin() + 0x48 + i * 0x90, (std::byte*)&compressedSize);
+
+        if (compressedSize <= 0 || fileOffset >= metadataEnd || fileOffset + compressedSize <= resourceContainer.DataOffset)
+            continue;
+
+        moveStart = moveStart == -1 ? fileOffset : std::min(moveStart, fileOffset);
+        moveEnd = std::max(moveEnd, fileOffset + compressedSize);
+    }
+
+    if (moveStart == -1)
+        return 0;
+
+    // The chunks are copied as one range, placed like appended chunks past the new metadata
+    int64_t dataEnd = std::max<int64_t>(resourceContainer.WriteQueue.FileSize, metadataEnd);
+    int64_t dataSectionLength = dataEnd - resourceContainer.DataOffset;
+    int64_t newStart = dataEnd + 0x10 - (dataSectionLength % 0x10) + 0x30;
+    int64_t moveSize = moveEnd - moveStart;
+
+    if (!resourceContainer.WriteQueue.DryRun) {
+        if (!storage.Grow(newStart + moveSize) || !storage.Write(newStart, storage.Mem + moveStart, moveSize))
+            return -1;
+    }
+
+    resourceContainer.WriteQueue.FileSize = newStart + moveSize;
+
+    for (size_t i = 0; i < info.size() / 0x90; i++) {
+        int64_t fileOffset, compressedSize;
+        std::copy(info.begin() + 0x38 + i * 0x90, info.begin() + 0x40 + i * 0x90, (std::byte*)&fileOffset);
+        std::copy(info.begin() + 0x40 + i * 0x90, info.begin() + 0x48 + i * 0x90, (std::byte*)&compressedSize);
+
+        if (compressedSize <= 0 || fileOffset >= metadataEnd || fileOffset + compressedSize <= resourceContainer.DataOffset)
+            continue;
+
+        fileOffset += newStart - moveStart;
+        std::copy((std::byte*)&fileOffset, (std::byte*)&fileOffset + 8, info.begin() + 0x38 + i * 0x90);
+    }
+
+    return moveSize;
+}
+
 /**
  * @brief Add new chunks to the given resource file
  * 
- * @param memoryMappedFile MemoryMappedFile object containing the resource to modify
+ * @param storage ContainerStorage object containing the resource to modify
  * @param resourceContainer ResourceContainer object containing the resources's data
  * @param os StringStream to output to
  */
-void AddChunks(MemoryMappedFile &memoryMappedFile, ResourceContainer &resourceContainer, std::stringstream &os)
+void AddChunks(ContainerStorage &storage, ResourceContainer &resourceContainer, std::stringstream &os)
 {
     if (resourceContainer.NewModFileList.empty())
         return;
 
-    std::stable_sort(resourceContainer.NewModFileList.begin(), resourceContainer.NewModFileList.end(),
-        [](const ResourceModFile &resource1, const ResourceModFile &resource2) { return resource1.Parent.LoadPriority > resource2.Parent.LoadPriority; });
+    std::stable_sort(resourceContainer.NewModFileList.begin(), resourceContainer.NewModFileList.end(), IsAppliedBefore<ResourceModFile>);
 
-    std::vector<std::byte> header(memoryMappedFile.Mem, memoryMappedFile.Mem + resourceContainer.InfoOffset);
+    std::vector<std::byte> header(resourceContainer.InfoOffset);
+    storage.Read(0, header.data(), header.size());
 
-    std::vector<std::byte> info(memoryMappedFile.Mem + resourceContainer.InfoOffset, memoryMappedFile.Mem + resourceContainer.NamesOffset);
+    std::vector<std::byte> info(resourceContainer.NamesOffset - resourceContainer.InfoOffset);
+    storage.Read(resourceContainer.InfoOffset, info.data(), info.size());
 
-    std::vector<std::byte> nameOffsets(memoryMappedFile.Mem + resourceContainer.NamesOffset, memoryMappedFile.Mem + resourceContainer.NamesOffsetEnd);
+    std::vector<std::byte> nameOffsets(resourceContainer.NamesOffsetEnd - resourceContainer.NamesOffset);
+    storage.Read(resourceContainer.NamesOffset, nameOffsets.data(), nameOffsets.size());
 
-    std::vector<std::byte> names(memoryMappedFile.Mem + resourceContainer.NamesOffsetEnd, memoryMappedFile.Mem + resourceContainer.UnknownOffset);
+    std::vector<std::byte> names(resourceContainer.UnknownOffset - resourceContainer.NamesOffsetEnd);
+    storage.Read(resourceContainer.NamesOffsetEnd, names.data(), names.size());
 
-    std::vector<std::byte> unknown(memoryMappedFile.Mem + resourceContainer.UnknownOffset, memoryMappedFile.Mem + resourceContainer.Dummy7Offset);
+    std::vector<std::byte> unknown(resourceContainer.Dummy7Offset - resourceContainer.UnknownOffset);
+    storage.Read(resourceContainer.UnknownOffset, unknown.data(), unknown.size());
 
     int64_t nameIdsOffset = resourceContainer.Dummy7Offset + (resourceContainer.TypeCount * 4);
 
-    std::vector<std::byte> typeIds(memoryMappedFile.Mem + resourceContainer.Dummy7Offset, memoryMappedFile.Mem + nameIdsOffset);
+    std::vector<std::byte> typeIds(nameIdsOffset - resourceContainer.Dummy7Offset);
+    storage.Read(resourceContainer.Dummy7Offset, typeIds.data(), typeIds.size());
 
-    std::vector<std::byte> nameIds(memoryMappedFile.Mem + nameIdsOffset, memoryMappedFile.Mem + resourceContainer.IdclOffset);
+    std::vector<std::byte> nameIds(resourceContainer.IdclOffset - nameIdsOffset);
+    storage.Read(nameIdsOffset, nameIds.data(), nameIds.size());
 
-    std::vector<std::byte> idcl(memoryMappedFile.Mem + resourceContainer.IdclOffset, memoryMappedFile.Mem + resourceContainer.DataOffset);
+    std::vector<std::byte> idcl(resourceContainer.DataOffset - resourceContainer.IdclOffset);
+    storage.Read(resourceContainer.IdclOffset, idcl.data(), idcl.size());
 
-    std::vector<std::byte> data(memoryMappedFile.Mem + resourceContainer.DataOffset, memoryMappedFile.Mem + memoryMappedFile.Size);
-    int64_t originalDataSize = data.size();
+    std::vector<PendingWrite> newPayloads;
+    int64_t dataEnd = resourceContainer.WriteQueue.FileSize;
 
     int32_t infoOldLength = info.size();
     int32_t nameIdsOldLength = nameIds.size();
@@ -115,11 +185,8 @@ void AddChunks(MemoryMappedFile &memoryMappedFile, ResourceContainer &resourceCo
         }
 
         ResourceDataEntry resourceData;
-        std::map<uint64_t, ResourceDataEntry>::iterator x = ResourceDataMap.find(CalculateResourceFileNameHash(modFile.Name));
-
-        if (x != ResourceDataMap.end()) {
-            resourceData = x->second;
 
+        if (ResourceDataMap.Find(CalculateResourceFileNameHash(modFile.Name), resourceData)) {
             modFile.ResourceType = modFile.ResourceType.empty() ? resourceData.ResourceType : modFile.ResourceType;
             modFile.Version = !modFile.Version.has_value() ? (uint16_t)resourceData.Version : modFile.Version;
             modFile.StreamDbHash = !modFile.StreamDbHash.has_value() ? resourceData.StreamDbHash : modFile.StreamDbHash;
@@ -210,12 +277,24 @@ void AddChunks(MemoryMappedFile &memoryMappedFile, ResourceContainer &resourceCo
         ResourceName newResourceName(modFile.Name, modFile.Name);
         resourceContainer.NamesList.push_back(newResourceName);
 
-        uint64_t compressedSize = modFile.FileBytes.size();
+        uint64_t compressedSize = modFile.GetSize();
         uint64_t uncompressedSize = compressedSize;
         std::byte compressionMode = (std::byte)0;
 
         if (modFile.Name.find(".tga") != std::string::npos) {
-            if (!memcmp(modFile.FileBytes.data(), DivinityMagic, 8)) {
+            if (modFile.FileSource.has_value()) {
+                if (modFile.FileSourceUncompressedSize.has_value()) {
+                    uncompressedSize = modFile.FileSourceUncompressedSize.value();
+                    modFile.FileSource.value().Offset += 16;
+                    modFile.FileSource.value().Size -= 16;
+                    compressedSize = modFile.FileSource.value().Size;
+                    compressionMode = (std::byte)2;
+
+                    if (Verbose)
+                        os << "\tSuccessfully set compressed texture data for file " << modFile.Name << '\n';
+                }
+            }
+            else if (!memcmp(modFile.FileBytes.data(), DivinityMagic, 8)) {
                 std::copy(modFile.FileBytes.begin() + 8, modFile.FileBytes.begin() + 16, (std::byte*)&uncompressedSize);
 
                 modFile.FileBytes = std::vector<std::byte>(modFile.FileBytes.begin() + 16, modFile.FileBytes.end());
@@ -225,11 +304,16 @@ void AddChunks(MemoryMappedFile &memoryMappedFile, ResourceContainer &resourceCo
                 if (Verbose)
                     os << "\tSuccessfully set compressed texture data for file " << modFile.Name << '\n';
             }
+            else if (CompressTextures && PlanOnly) {
+                // Textures are only compressed when the mods are loaded, the plan keeps their uncompressed size
+                resourceContainer.Work.CompressedBytes += modFile.FileBytes.size();
+            }
             else if (CompressTextures) {
                 std::vector<std::byte> compressedData;
+                resourceContainer.Work.CompressedBytes += modFile.FileBytes.size();
 
                 try {
-                    compressedData = OodleCompress(modFile.FileBytes, OodleFormat::Kraken, OodleCompressionLevel::Normal);
+                    compressedData = TextureCompressionCache.Compress(modFile.FileBytes, OodleFormat::Kraken, OodleCompressionLevel::Normal);
 
                     if (compressedData.empty())
                         throw std::exception();
@@ -248,11 +332,20 @@ void AddChunks(MemoryMappedFile &memoryMappedFile, ResourceContainer &resourceCo
             }
         }
 
-        int64_t resourceFileSize = memoryMappedFile.Size;
-        int64_t placement = 0x10 - (data.size() % 0x10) + 0x30;
-        int64_t fileOffset = resourceFileSize + (data.size() - originalDataSize) + placement;
-        data.resize(data.size() + placement + modFile.FileBytes.size());
-        std::copy(modFile.FileBytes.begin(), modFile.FileBytes.end(), data.end() - modFile.FileBytes.size());
+        int64_t fileOffset = resourceContainer.DataSectionAllocator.Allocate(compressedSize);
+
+        if (fileOffset == -1) {
+            int64_t dataSectionLength = dataEnd - resourceContainer.DataOffset;
+            int64_t placement = 0x10 - (dataSectionLength % 0x10) + 0x30;
+            fileOffset = dataEnd + placement;
+            dataEnd = fileOffset + compressedSize;
+            resourceContainer.DataSectionAllocator.AppendedBytes += compressedSize;
+        }
+
+        if (modFile.FileSource.has_value())
+            newPayloads.push_back(PendingWrite(fileOffset, modFile.FileSource.value()));
+        else
+            newPayloads.push_back(PendingWrite(fileOffset, std::move(modFile.FileBytes)));
 
         int64_t nameId = resourceContainer.GetResourceNameId(modFile.Name);
         nameIds.resize(nameIds.size() + 16);
@@ -386,51 +479,67 @@ void AddChunks(MemoryMappedFile &memoryMappedFile, ResourceContainer &resourceCo
 
     info.reserve(2 * (0x38 + info.size() + 8));
 
-    for (int32_t i = 0; i < info.size() / 0x90; i++) {
-        int32_t fileOffset = 0x38 + (i * 0x90);
+    for (auto &newPayload : newPayloads)
+        resourceContainer.WriteQueue.Push(std::move(newPayload));
 
-        int64_t newOffsetPlusDataAdd;
-        std::copy(info.begin() + fileOffset, info.begin() + fileOffset + 8, (std::byte*)&newOffsetPlusDataAdd);
-        newOffsetPlusDataAdd += dataAdd;
+    // Make sure all payloads are written before moving the chunks out of the way of the new metadata
+    if (!resourceContainer.WriteQueue.Commit(storage)) {
+        os << RED << "ERROR: " << RESET << "Failed to write mod files to " << resourceContainer.Path << '\n';
+        return;
+    }
+
+    if (dataAdd != 0) {
+        int64_t movedBytes = MoveChunksOutOfMetadata(storage, resourceContainer, info, dataAdd);
 
-        std::copy((std::byte*)&newOffsetPlusDataAdd, (std::byte*)&newOffsetPlusDataAdd + 8, info.begin() + fileOffset);
+        // The original data the metadata grows over is kept in the container's snapshot, to restore it later
+        if (movedBytes != -1 && !SaveDisplacedData(storage, resourceContainer.DataOffset, dataAdd, os))
+            return;
+
+        if (movedBytes == -1 || !storage.GrowMetadata(resourceContainer.DataOffset + dataAdd)) {
+            os << RED << "ERROR: " << RESET << "Failed to resize " << resourceContainer.Path << '\n';
+            return;
+        }
+
+        resourceContainer.Work.MovedBytes += movedBytes;
+
+        if (movedBytes > LargeMoveSize) {
+            os << RED << "WARNING: " << RESET << "Moved " << movedBytes << " byte(s) to make room for the new metadata in "
+                << YELLOW << resourceContainer.Path << RESET << '\n';
+        }
+        else if (Verbose && movedBytes > 0) {
+            os << "Moved " << GREEN << movedBytes << " byte(s) " << RESET << "to make room for the new metadata in "
+                << YELLOW << resourceContainer.Path << RESET << "." << '\n';
+        }
     }
 
     uint64_t pos = 0;
-    std::copy(header.begin(), header.end(), memoryMappedFile.Mem + pos);
+    storage.Write(pos, header.data(), header.size());
     pos += header.size();
 
-    std::copy(info.begin(), info.end(), memoryMappedFile.Mem + pos);
+    storage.Write(pos, info.data(), info.size());
     pos += info.size();
 
-    std::copy(nameOffsets.begin(), nameOffsets.end(), memoryMappedFile.Mem + pos);
+    storage.Write(pos, nameOffsets.data(), nameOffsets.size());
     pos += nameOffsets.size();
 
-    std::copy(names.begin(), names.end(), memoryMappedFile.Mem + pos);
+    storage.Write(pos, names.data(), names.size());
     pos += names.size();
 
-    std::copy(unknown.begin(), unknown.end(), memoryMappedFile.Mem + pos);
+    storage.Write(pos, unknown.data(), unknown.size());
     pos += unknown.size();
 
-    std::copy(typeIds.begin(), typeIds.end(), memoryMappedFile.Mem + pos);
+    storage.Write(pos, typeIds.data(), typeIds.size());
     pos += typeIds.size();
 
-    std::copy(nameIds.begin(), nameIds.end(), memoryMappedFile.Mem + pos);
+    storage.Write(pos, nameIds.data(), nameIds.size());
     pos += nameIds.size();
 
-    std::copy(idcl.begin(), idcl.end(), memoryMappedFile.Mem + pos);
+    storage.Write(pos, idcl.data(), idcl.size());
     pos += idcl.size();
 
-    if (pos + data.size() > memoryMappedFile.Size) {
-        int64_t newContainerSize = pos + data.size();
-
-        if (!memoryMappedFile.ResizeFile(newContainerSize)) {
-            os << RED << "ERROR: " << RESET << "Failed to resize " << resourceContainer.Path << '\n';
-            return;
-        }
-    }
+    resourceContainer.WriteQueue.Reset(storage.Size);
 
-    std::copy(data.begin(), data.end(), memoryMappedFile.Mem + pos);
+    resourceContainer.Work.AddedFiles += newChunksCount;
 
     if (newChunksCount != 0)
         os << "Number of files added: " << GREEN << newChunksCount << " file(s) " << RESET << "in " << YELLOW << resourceContainer.Path << RESET << "." << '\n';
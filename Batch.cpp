@@ -0,0 +1,272 @@
+/*
+* This file is part of EternalModLoaderCpp (https://github.com/PowerBall253/EternalModLoaderCpp).
+* Copyright (C) 2021 PowerBall253
+*
+* EternalModLoaderCpp is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* EternalModLoaderCpp is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with EternalModLoaderCpp. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <iostream>
+#include <filesystem>
+#include <fstream>
+#include <chrono>
+
+#include "ModLoader/ModLoader.hpp"
+
+namespace chrono = std::chrono;
+
+extern std::map<std::string, std::vector<std::byte>> SharedZipEntries;
+extern std::map<std::string, int32_t> SharedZipEntryUses;
+extern uint64_t SharedZipEntriesSize;
+extern std::atomic<int32_t> SharedZipEntryHits;
+extern std::atomic<int32_t> SharedZipEntryMisses;
+
+/**
+ * @brief Game directory to load mods into in batch mode
+ *
+ */
+class BatchJob {
+public:
+    std::string GamePath;
+    std::string ModsPath;
+    std::set<std::string> ZipEntryKeys;
+
+    /**
+     * @brief Construct a new BatchJob object
+     *
+     * @param gamePath Path to the game directory
+     * @param modsPath Path to the Mods folder to load the mods from
+     */
+    BatchJob(std::string gamePath, std::string modsPath)
+    {
+        GamePath = gamePath;
+        ModsPath = modsPath;
+    }
+};
+
+/**
+ * @brief Read the game directories listed in a job file
+ *
+ * Each line holds a game directory, optionally followed by a tab and the Mods folder to use, if not the game directory's own.
+ * Empty lines and lines starting with '#' are ignored.
+ *
+ * @param jobFilePath Path to the job file
+ * @param jobs Vector to push the jobs to
+ * @return True on success, false otherwise
+ */
+bool ReadBatchJobs(const std::string &jobFilePath, std::vector<BatchJob> &jobs)
+{
+    std::ifstream jobFile(jobFilePath);
+
+    if (!jobFile)
+        return false;
+
+    std::string line;
+
+    while (std::getline(jobFile, line)) {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        size_t tab = line.find('\t');
+        std::string gamePath = line.substr(0, tab);
+        std::string modsPath = tab == std::string::npos ? gamePath + Separator + "Mods" : line.substr(tab + 1);
+
+        try {
+            jobs.push_back(BatchJob(std::filesystem::absolute(gamePath).lexically_normal().string(),
+                std::filesystem::absolute(modsPath).lexically_normal().string()));
+        }
+        catch (...) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Count the game directories using each zip entry, so only the entries used more than once are kept
+ *
+ * @param jobs Vector containing the jobs to run
+ */
+void CountSharedZipEntries(std::vector<BatchJob> &jobs)
+{
+    for (auto &job : jobs) {
+        std::vector<std::string> zippedMods;
+        std::vector<std::string> unzippedMods;
+
+        try {
+            FindMods(job.ModsPath, zippedMods, unzippedMods);
+        }
+        catch (...) {
+            continue;
+        }
+
+        for (auto &zippedMod : zippedMods)
+            GetSharedZipEntryKeys(zippedMod, job.ZipEntryKeys);
+
+        for (auto &key : job.ZipEntryKeys)
+            SharedZipEntryUses[key]++;
+    }
+}
+
+/**
+ * @brief Release the zip entries no game directory left to load uses
+ *
+ * @param job BatchJob object containing the game directory whose mods were just loaded
+ */
+void ReleaseSharedZipEntries(BatchJob &job)
+{
+    for (auto &key : job.ZipEntryKeys) {
+        auto sharedEntryUses = SharedZipEntryUses.find(key);
+
+        if (sharedEntryUses == SharedZipEntryUses.end() || --sharedEntryUses->second > 0)
+            continue;
+
+        SharedZipEntryUses.erase(sharedEntryUses);
+        auto sharedEntry = SharedZipEntries.find(key);
+
+        if (sharedEntry != SharedZipEntries.end()) {
+            SharedZipEntriesSize -= sharedEntry->second.size();
+            SharedZipEntries.erase(sharedEntry);
+        }
+    }
+}
+
+/**
+ * @brief Load the mods into a game directory, reusing the zip entries and compressed textures of the previous ones
+ *
+ * The mods are discovered and applied the same way as for a single game directory.
+ *
+ * @param job BatchJob object containing the game directory to load the mods into
+ * @return True on success, false otherwise
+ */
+bool ModLoader::RunBatchJob(BatchJob &job)
+{
+    std::filesystem::path modsPath(job.ModsPath);
+
+    if (modsPath.filename().empty())
+        modsPath = modsPath.parent_path();
+
+    if (!std::filesystem::exists(job.GamePath + Separator + "base")) {
+        std::cout << RED << "ERROR: " << RESET << "Game directory " << job.GamePath << " does not exist!" << std::endl;
+        return false;
+    }
+
+    if (!std::filesystem::is_directory(modsPath)) {
+        std::cout << RED << "ERROR: " << RESET << "Mods folder " << modsPath.string() << " does not exist!" << std::endl;
+        return false;
+    }
+
+    std::cout << "Loading mods into " << YELLOW << job.GamePath << RESET << "..." << '\n';
+
+    GamePath = job.GamePath;
+
+    if (!DiscoverMods(DiscoveryMode::Load, modsPath.string()))
+        return false;
+
+    ApplyMods();
+
+    // The results stay in memory for the next game directories
+    TextureCompressionCache.Prune();
+
+    return true;
+}
+
+/**
+ * @brief Load mods into all the game directories listed in a job file, one after the other
+ *
+ * Zip entries used by several game directories are only extracted once, and textures only compressed once.
+ * The mods must be discovered again afterwards.
+ *
+ * @param jobFilePath Path to the job file
+ * @param options Options affecting how mods are loaded
+ * @return Exit code indicating success/failure
+ */
+int32_t ModLoader::RunBatch(const std::string &jobFilePath, ModLoaderOptions options)
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    chrono::steady_clock::time_point batchBegin = chrono::steady_clock::now();
+    std::vector<BatchJob> jobs;
+
+    if (!ReadBatchJobs(jobFilePath, jobs)) {
+        std::cout << RED << "ERROR: " << RESET << "Failed to read the job file " << jobFilePath << std::endl;
+        return 1;
+    }
+
+    std::string gamePath = GamePath;
+    Options = options;
+    UseOptions();
+    IsDiscovered = false;
+    IsApplied = false;
+    ShareZipEntries = true;
+
+    CountSharedZipEntries(jobs);
+    SetBuffer();
+
+    int32_t loadedCount = 0;
+
+    for (auto &job : jobs) {
+        chrono::steady_clock::time_point jobBegin = chrono::steady_clock::now();
+        bool success;
+
+        try {
+            success = RunBatchJob(job);
+        }
+        catch (...) {
+            std::cout << RED << "ERROR: " << RESET << "Failed to load the mods into " << job.GamePath << std::endl;
+            success = false;
+        }
+
+        ReleaseSharedZipEntries(job);
+
+        if (!success)
+            continue;
+
+        chrono::steady_clock::time_point jobEnd = chrono::steady_clock::now();
+        double jobTime = chrono::duration_cast<chrono::microseconds>(jobEnd - jobBegin).count() / 1000000.0;
+
+        std::cout << GREEN << "Loaded the mods into " << job.GamePath << " in " << jobTime << " seconds." << RESET << std::endl;
+        loadedCount++;
+    }
+
+    delete[] Buffer;
+    Buffer = NULL;
+    ShareZipEntries = false;
+    SharedZipEntries.clear();
+    SharedZipEntryUses.clear();
+    SharedZipEntriesSize = 0;
+    TextureCompressionCache.Clear();
+    GamePath = gamePath;
+
+    chrono::steady_clock::time_point batchEnd = chrono::steady_clock::now();
+    double batchTime = chrono::duration_cast<chrono::microseconds>(batchEnd - batchBegin).count() / 1000000.0;
+
+    if (Verbose) {
+        std::cout << GREEN << "Zip entries extracted: " << SharedZipEntryMisses << ", reused from other game directories: " << SharedZipEntryHits << ".\n";
+
+        if (CompressTextures) {
+            std::cout << "Textures compressed: " << TextureCompressionCache.Misses << ", reused from the cache: "
+                << TextureCompressionCache.Hits << ".\n";
+        }
+
+        std::cout << RESET;
+    }
+
+    std::cout << "Loaded the mods into " << GREEN << loadedCount << " of " << jobs.size() << " game directories" << RESET << "." << '\n';
+    std::cout << GREEN << "Total time taken: " << batchTime << " seconds." << RESET << std::endl;
+
+    return loadedCount == (int32_t)jobs.size() ? 0 : 1;
+}
\ No newline at end of file
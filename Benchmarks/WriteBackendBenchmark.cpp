@@ -0,0 +1,169 @@
+/*
+* This file is part of EternalModLoaderCpp (https://github.com/PowerBall253/EternalModLoaderCpp).
+* Copyright (C) 2021 PowerBall253
+*
+* EternalModLoaderCpp is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* EternalModLoaderCpp is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with EternalModLoaderCpp. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <string>
+#include <cstring>
+
+#include "MemoryMappedFile/MemoryMappedFile.hpp"
+#include "WriteQueue/WriteQueue.hpp"
+#include "IoUring/IoUring.hpp"
+
+namespace chrono = std::chrono;
+
+bool MultiThreading = true;
+bool StreamingStores = false;
+WriteBackend PayloadWriteBackend = WriteBackend::Mmap;
+bool DirectIo = false;
+
+/**
+ * @brief Create a container-like file and inject the same set of payloads into it with the given backend
+ *
+ * @param path Path to the file to create
+ * @param baseSize Size of the file before the injection
+ * @param payloads Payloads to append
+ * @param commitTime Set to the time taken by the commit, in seconds
+ * @param syncTime Set to the time taken to flush the file to disk after the commit, in seconds
+ * @return True on success, false otherwise
+ */
+bool RunInjection(const std::string &path, int64_t baseSize, std::vector<std::vector<std::byte>> &payloads, double &commitTime, double &syncTime)
+{
+    std::filesystem::remove(path);
+    std::ofstream(path, std::ios::binary).close();
+    std::filesystem::resize_file(path, baseSize);
+
+    MemoryMappedFile memoryMappedFile(path);
+    WriteQueue writeQueue;
+    writeQueue.Reset(memoryMappedFile.Size);
+
+    int64_t offset = baseSize;
+
+    for (auto &payload : payloads) {
+        offset += 0x10 - (offset % 0x10) + 0x30;
+        writeQueue.Push(offset, payload);
+        offset += payload.size();
+    }
+
+    chrono::steady_clock::time_point commitBegin = chrono::steady_clock::now();
+
+    if (!writeQueue.Commit(memoryMappedFile))
+        return false;
+
+    chrono::steady_clock::time_point commitEnd = chrono::steady_clock::now();
+
+#ifdef __linux__
+    msync(memoryMappedFile.Mem, memoryMappedFile.Size, MS_SYNC);
+    int fileDescriptor = open(path.c_str(), O_RDWR);
+    fsync(fileDescriptor);
+    close(fileDescriptor);
+#endif
+
+    chrono::steady_clock::time_point syncEnd = chrono::steady_clock::now();
+
+    commitTime = chrono::duration_cast<chrono::microseconds>(commitEnd - commitBegin).count() / 1000000.0;
+    syncTime = chrono::duration_cast<chrono::microseconds>(syncEnd - commitEnd).count() / 1000000.0;
+
+    return true;
+}
+
+/**
+ * @brief Benchmark's main entrypoint
+ *
+ * Compares the mmap, pwrite and io_uring write backends (with and without direct I/O) on the same injection:
+ * a mix of small and large payloads appended to a container-sized file.
+ *
+ * @param argc Number of arguments passed to program
+ * @param argv Array of arguments passed to program
+ * @return Exit code
+ */
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        std::cout << "Usage:\n";
+        std::cout << argv[0] << " <scratch file path> [payload MiB] [base MiB]" << std::endl;
+        return 1;
+    }
+
+    std::string path = argv[1];
+    int64_t payloadBytes = (argc > 2 ? std::stoll(argv[2]) : 256) * 1024 * 1024;
+    int64_t baseSize = (argc > 3 ? std::stoll(argv[3]) : 64) * 1024 * 1024;
+
+    // Same payloads for every backend: mostly small files, and a few big textures
+    std::mt19937_64 random(0);
+    std::vector<std::vector<std::byte>> payloads;
+
+    for (int64_t total = 0; total < payloadBytes;) {
+        int64_t size = random() % 8 == 0 ? 8 * 1024 * 1024 + random() % (16 * 1024 * 1024) : 1024 + random() % (256 * 1024);
+        size = std::min(size, payloadBytes - total);
+
+        std::vector<std::byte> payload(size);
+
+        for (auto &byte : payload)
+            byte = (std::byte)random();
+
+        payloads.push_back(std::move(payload));
+        total += size;
+    }
+
+    std::cout << payloads.size() << " payload(s), " << payloadBytes << " byte(s) in total." << std::endl;
+
+    struct {
+        const char *Name;
+        WriteBackend Backend;
+        bool DirectIo;
+    } runs[] = {
+        { "mmap", WriteBackend::Mmap, false },
+#ifdef __linux__
+        { "pwrite", WriteBackend::Pwrite, false },
+        { "pwrite + direct I/O", WriteBackend::Pwrite, true },
+        { "io_uring", WriteBackend::IoUring, false },
+        { "io_uring + direct I/O", WriteBackend::IoUring, true },
+#endif
+    };
+
+    for (auto &run : runs) {
+#ifdef __linux__
+        if (run.Backend == WriteBackend::IoUring && !IoUring::IsAvailable()) {
+            std::cout << run.Name << ": not available." << std::endl;
+            continue;
+        }
+#endif
+
+        PayloadWriteBackend = run.Backend;
+        DirectIo = run.DirectIo;
+
+        double commitTime, syncTime;
+
+        bool success = RunInjection(path, baseSize, payloads, commitTime, syncTime);
+        std::filesystem::remove(path);
+
+        if (!success) {
+            std::cout << run.Name << ": failed." << std::endl;
+            continue;
+        }
+
+        std::cout << run.Name << ": commit " << commitTime << " s, commit + sync " << commitTime + syncTime << " s." << std::endl;
+    }
+
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,578 @@
+/*
+* This file is part of EternalModLoaderCpp (https://github.com/PowerBall253/EternalModLoaderCpp).
+* Copyright (C) 2021 PowerBall253
+*
+* EternalModLoaderCpp is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* EternalModLoaderCpp is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with EternalModLoaderCpp. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <iostream>
+#include <algorithm>
+#include <filesystem>
+#include <cstring>
+#include <sstream>
+#include <thread>
+#include <cerrno>
+
+#ifdef __linux__
+#include <sys/stat.h>
+#endif
+
+#include "EternalModLoader.hpp"
+
+extern std::vector<std::string> ResourceContainerPathList;
+
+// Suffix of the file a container is compacted into before replacing it
+const std::string CompactedFileSuffix = ".compact";
+
+/**
+ * @brief Compute the offsets the given extents will be moved to, packed from the given start
+ *
+ * Every extent keeps its offset modulo 16, so the payload alignment is preserved.
+ *
+ * @param extents Vector containing the sorted, disjoint extents to move
+ * @param start Offset of the first byte to pack the extents from
+ * @return Vector containing the new offset of each extent
+ */
+std::vector<int64_t> GetCompactedOffsets(std::vector<DataExtent> &extents, int64_t start)
+{
+    std::vector<int64_t> newOffsets;
+    newOffsets.reserve(extents.size());
+
+    int64_t position = start;
+
+    for (auto &extent : extents) {
+        int64_t newOffset = position + (((extent.Offset - position) % 0x10) + 0x10) % 0x10;
+        newOffsets.push_back(newOffset);
+        position = newOffset + extent.Size;
+    }
+
+    return newOffsets;
+}
+
+/**
+ * @brief Get the new offset of the given offset after compaction
+ *
+ * Offsets outside of every extent, like those of empty chunks, are moved to the new offset of the next extent,
+ * or to the end of the compacted data, so they stay inside the compacted file.
+ *
+ * @param extents Vector containing the sorted, disjoint extents being moved
+ * @param newOffsets Vector containing the new offset of each extent
+ * @param offset Offset to relocate
+ * @param end End of the compacted data
+ * @return New offset
+ */
+int64_t RelocateOffset(std::vector<DataExtent> &extents, std::vector<int64_t> &newOffsets, int64_t offset, int64_t end)
+{
+    auto x = std::upper_bound(extents.begin(), extents.end(), offset,
+        [](int64_t offset, const DataExtent &extent) { return offset < extent.Offset; });
+
+    size_t index = std::distance(extents.begin(), x);
+
+    if (x != extents.begin() && offset < extents[index - 1].Offset + extents[index - 1].Size)
+        return newOffsets[index - 1] + (offset - extents[index - 1].Offset);
+
+    return index < extents.size() ? newOffsets[index] : end;
+}
+
+/**
+ * @brief Write the compacted container to disk, streaming the extents in offset order
+ *
+ * @param memoryMappedFile MemoryMappedFile object containing the container to compact
+ * @param compactedPath Path to write the compacted container to
+ * @param prefix Bytes to write before the extents, with the offsets already relocated
+ * @param extents Vector containing the sorted, disjoint extents to keep
+ * @param newOffsets Vector containing the new offset of each extent
+ * @param bufferSize Size of the copy buffer
+ * @return True on success, false otherwise
+ */
+bool WriteCompactedContainer(
+    MemoryMappedFile &memoryMappedFile,
+    std::string &compactedPath,
+    std::vector<std::byte> &prefix,
+    std::vector<DataExtent> &extents,
+    std::vector<int64_t> &newOffsets,
+    int64_t bufferSize
+)
+{
+    FILE *compactedFile = fopen(compactedPath.c_str(), "wb");
+
+    if (!compactedFile)
+        return false;
+
+    std::vector<std::byte> buffer(bufferSize);
+    int64_t bufferUsed = 0;
+    int64_t position = 0;
+    bool success = true;
+
+    // Append the given bytes (or zeroes if NULL) to the buffer, writing it out when full
+    auto writeBytes = [&](const std::byte *bytes, int64_t size) {
+        while (size > 0 && success) {
+            int64_t toCopy = std::min(size, bufferSize - bufferUsed);
+
+            if (bytes != NULL) {
+                std::copy(bytes, bytes + toCopy, buffer.begin() + bufferUsed);
+                bytes += toCopy;
+            }
+            else {
+                std::fill(buffer.begin() + bufferUsed, buffer.begin() + bufferUsed + toCopy, (std::byte)0);
+            }
+
+            bufferUsed += toCopy;
+            position += toCopy;
+            size -= toCopy;
+
+            if (bufferUsed == bufferSize) {
+                success = fwrite(buffer.data(), 1, bufferUsed, compactedFile) == bufferUsed;
+                bufferUsed = 0;
+            }
+        }
+    };
+
+    writeBytes(prefix.data(), prefix.size());
+
+    for (int32_t i = 0; i < extents.size(); i++) {
+        writeBytes(NULL, newOffsets[i] - position);
+        writeBytes(memoryMappedFile.Mem + extents[i].Offset, extents[i].Size);
+    }
+
+    if (success && bufferUsed > 0)
+        success = fwrite(buffer.data(), 1, bufferUsed, compactedFile) == bufferUsed;
+
+    if (fclose(compactedFile) != 0)
+        success = false;
+
+    // The compacted copy replaces the container, it must be complete on disk before the rename
+    if (success && !SyncFile(compactedPath))
+        success = false;
+
+    return success;
+}
+
+/**
+ * @brief Replace the given container with its compacted copy
+ *
+ * The copy gets the container's permissions, and the rename is flushed to disk
+ * so a crash can't leave the container missing.
+ *
+ * @param memoryMappedFile MemoryMappedFile object containing the container to replace, will be deleted
+ * @param path Path to the container
+ * @param compactedPath Path to the compacted container
+ * @param os StringStream to output to
+ * @return True on success, false otherwise
+ */
+bool ReplaceWithCompactedContainer(MemoryMappedFile *memoryMappedFile, std::string &path, std::string &compactedPath, std::stringstream &os)
+{
+    delete memoryMappedFile;
+
+    try {
+        std::filesystem::permissions(compactedPath, std::filesystem::status(path).permissions());
+        std::filesystem::rename(compactedPath, path);
+    }
+    catch (...) {
+        std::filesystem::remove(compactedPath);
+        return false;
+    }
+
+    std::string directoryPath = std::filesystem::absolute(path).parent_path().string();
+
+    if (!SyncDirectory(directoryPath))
+        os << RED << "WARNING: " << RESET << "Failed to flush " << directoryPath << " to disk" << '\n';
+
+    return true;
+}
+
+/**
+ * @brief Compact the given resource container, dropping all data not referenced by its info table
+ *
+ * @param path Path to the resource container
+ * @param bufferSize Size of the copy buffer to use
+ * @param os StringStream to output to
+ * @return Number of bytes recovered
+ */
+int64_t CompactResourceContainer(std::string path, int64_t bufferSize, std::stringstream &os)
+{
+    MemoryMappedFile *memoryMappedFile;
+
+    try {
+        memoryMappedFile = new MemoryMappedFile(path);
+    }
+    catch (...) {
+        os << RED << "ERROR: " << RESET << "Failed to open " << YELLOW << path << RESET << " for writing!" << '\n';
+        return 0;
+    }
+
+    ResourceContainer resourceContainer(std::filesystem::path(path).filename().string(), path);
+    ReadResource(*memoryMappedFile, resourceContainer);
+
+    std::vector<DataExtent> &extents = resourceContainer.LiveExtents;
+
+    for (auto &extent : extents) {
+        if (extent.Offset < resourceContainer.DataOffset || extent.Offset + extent.Size > memoryMappedFile->Size) {
+            os << RED << "ERROR: " << RESET << "Found data outside of the data section in " << YELLOW << path << RESET << ", skipping" << '\n';
+            delete memoryMappedFile;
+            return 0;
+        }
+    }
+
+    std::vector<int64_t> newOffsets = GetCompactedOffsets(extents, resourceContainer.DataOffset);
+    int64_t newSize = extents.empty() ? resourceContainer.DataOffset : newOffsets.back() + extents.back().Size;
+
+    if (newSize >= memoryMappedFile->Size) {
+        delete memoryMappedFile;
+        return 0;
+    }
+
+    std::vector<std::byte> prefix(memoryMappedFile->Mem, memoryMappedFile->Mem + resourceContainer.DataOffset);
+
+    for (auto &chunk : resourceContainer.ChunkList) {
+        int64_t fileOffset;
+        std::copy(memoryMappedFile->Mem + chunk.FileOffset, memoryMappedFile->Mem + chunk.FileOffset + 8, (std::byte*)&fileOffset);
+
+        int64_t newFileOffset = RelocateOffset(extents, newOffsets, fileOffset, newSize);
+        std::copy((std::byte*)&newFileOffset, (std::byte*)&newFileOffset + 8, prefix.begin() + chunk.FileOffset);
+    }
+
+    std::string compactedPath = path + CompactedFileSuffix;
+
+    if (!WriteCompactedContainer(*memoryMappedFile, compactedPath, prefix, extents, newOffsets, bufferSize)) {
+        os << RED << "ERROR: " << RESET << "Failed to write " << YELLOW << compactedPath << RESET << '\n';
+        delete memoryMappedFile;
+        std::filesystem::remove(compactedPath);
+        return 0;
+    }
+
+    int64_t recoveredBytes = memoryMappedFile->Size - newSize;
+
+    if (!ReplaceWithCompactedContainer(memoryMappedFile, path, compactedPath, os)) {
+        os << RED << "ERROR: " << RESET << "Failed to replace " << YELLOW << path << RESET << " with its compacted copy" << '\n';
+        return 0;
+    }
+
+    os << "Recovered " << GREEN << recoveredBytes << " byte(s) " << RESET << "in " << YELLOW << path << RESET << "." << '\n';
+    return recoveredBytes;
+}
+
+/**
+ * @brief Check that the sound data of the given container lies after its sound entries and inside the file
+ *
+ * @param memoryMappedFile MemoryMappedFile object containing the sound container
+ * @param soundContainer SoundContainer object containing the sound container's data
+ * @return True if valid, false otherwise
+ */
+bool IsSoundDataValid(MemoryMappedFile &memoryMappedFile, SoundContainer &soundContainer)
+{
+    if (soundContainer.LiveExtents.empty())
+        return true;
+
+    for (auto &soundEntry : soundContainer.SoundEntries) {
+        if (soundEntry.InfoOffset + 8 > soundContainer.LiveExtents.front().Offset)
+            return false;
+    }
+
+    return soundContainer.LiveExtents.back().Offset + soundContainer.LiveExtents.back().Size <= memoryMappedFile.Size;
+}
+
+/**
+ * @brief Compact the given sound container, dropping all data not referenced by its sound entries
+ *
+ * @param path Path to the sound container
+ * @param bufferSize Size of the copy buffer to use
+ * @param os StringStream to output to
+ * @return Number of bytes recovered
+ */
+int64_t CompactSoundContainer(std::string path, int64_t bufferSize, std::stringstream &os)
+{
+    MemoryMappedFile *memoryMappedFile;
+
+    try {
+        memoryMappedFile = new MemoryMappedFile(path);
+    }
+    catch (...) {
+        os << RED << "ERROR: " << RESET << "Failed to open " << YELLOW << path << RESET << " for writing!" << '\n';
+        return 0;
+    }
+
+    SoundContainer soundContainer(std::filesystem::path(path).stem().string(), path);
+    ReadSoundEntries(*memoryMappedFile, soundContainer);
+
+    std::vector<DataExtent> &extents = soundContainer.LiveExtents;
+
+    if (extents.empty()) {
+        delete memoryMappedFile;
+        return 0;
+    }
+
+    // Everything before the first sound is kept as is
+    int64_t dataStart = extents.front().Offset;
+
+    if (!IsSoundDataValid(*memoryMappedFile, soundContainer)) {
+        os << RED << "ERROR: " << RESET << "Found overlapping sound data in " << YELLOW << path << RESET << ", skipping" << '\n';
+        delete memoryMappedFile;
+        return 0;
+    }
+
+    std::vector<int64_t> newOffsets = GetCompactedOffsets(extents, dataStart);
+    int64_t newSize = newOffsets.back() + extents.back().Size;
+
+    if (newSize >= memoryMappedFile->Size) {
+        delete memoryMappedFile;
+        return 0;
+    }
+
+    std::vector<std::byte> prefix(memoryMappedFile->Mem, memoryMappedFile->Mem + dataStart);
+
+    for (auto &soundEntry : soundContainer.SoundEntries) {
+        uint32_t soundOffset;
+        std::copy(memoryMappedFile->Mem + soundEntry.InfoOffset + 4, memoryMappedFile->Mem + soundEntry.InfoOffset + 8, (std::byte*)&soundOffset);
+
+        soundOffset = RelocateOffset(extents, newOffsets, soundOffset, newSize);
+        std::copy((std::byte*)&soundOffset, (std::byte*)&soundOffset + 4, prefix.begin() + soundEntry.InfoOffset + 4);
+    }
+
+    std::string compactedPath = path + CompactedFileSuffix;
+
+    if (!WriteCompactedContainer(*memoryMappedFile, compactedPath, prefix, extents, newOffsets, bufferSize)) {
+        os << RED << "ERROR: " << RESET << "Failed to write " << YELLOW << compactedPath << RESET << '\n';
+        delete memoryMappedFile;
+        std::filesystem::remove(compactedPath);
+        return 0;
+    }
+
+    int64_t recoveredBytes = memoryMappedFile->Size - newSize;
+
+    if (!ReplaceWithCompactedContainer(memoryMappedFile, path, compactedPath, os)) {
+        os << RED << "ERROR: " << RESET << "Failed to replace " << YELLOW << path << RESET << " with its compacted copy" << '\n';
+        return 0;
+    }
+
+    os << "Recovered " << GREEN << recoveredBytes << " byte(s) " << RESET << "in " << YELLOW << path << RESET << "." << '\n';
+    return recoveredBytes;
+}
+
+/**
+ * @brief Release the disk space used by the given ranges of a file, without changing its size
+ *
+ * Only whole filesystem blocks are released, partial blocks at the edges of a range are kept as they are.
+ *
+ * @param path Path to the file
+ * @param holes Vector containing the ranges to release
+ * @param os StringStream to output to
+ * @return Number of bytes of disk space released, or -1 on error
+ */
+int64_t PunchHoles(std::string &path, std::vector<DataExtent> &holes, std::stringstream &os)
+{
+#ifdef __linux__
+    int fileDescriptor = open(path.c_str(), O_RDWR);
+
+    if (fileDescriptor == -1) {
+        os << RED << "ERROR: " << RESET << "Failed to open " << YELLOW << path << RESET << " for writing!" << '\n';
+        return -1;
+    }
+
+    struct stat fileInfo;
+
+    if (fstat(fileDescriptor, &fileInfo) == -1) {
+        close(fileDescriptor);
+        return -1;
+    }
+
+    int64_t blockSize = fileInfo.st_blksize > 0 ? fileInfo.st_blksize : 4096;
+    int64_t allocatedBefore = (int64_t)fileInfo.st_blocks * 512;
+
+    for (auto &hole : holes) {
+        int64_t start = (hole.Offset + blockSize - 1) / blockSize * blockSize;
+        int64_t end = (hole.Offset + hole.Size) / blockSize * blockSize;
+
+        if (end <= start)
+            continue;
+
+        if (fallocate(fileDescriptor, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, start, end - start) == -1) {
+            os << RED << "ERROR: " << RESET << "Failed to punch holes in " << YELLOW << path << RESET << ": " << strerror(errno) << '\n';
+            close(fileDescriptor);
+            return -1;
+        }
+    }
+
+    if (fstat(fileDescriptor, &fileInfo) == -1) {
+        close(fileDescriptor);
+        return -1;
+    }
+
+    close(fileDescriptor);
+    return std::max<int64_t>(allocatedBefore - (int64_t)fileInfo.st_blocks * 512, 0);
+#else
+    os << RED << "ERROR: " << RESET << "Hole punching is not supported on this platform" << '\n';
+    return -1;
+#endif
+}
+
+/**
+ * @brief Release the disk space used by data not referenced by the given resource container's info table
+ *
+ * @param path Path to the resource container
+ * @param os StringStream to output to
+ * @return Number of bytes of disk space released
+ */
+int64_t PunchResourceContainerHoles(std::string path, std::stringstream &os)
+{
+    MemoryMappedFile *memoryMappedFile;
+
+    try {
+        memoryMappedFile = new MemoryMappedFile(path);
+    }
+    catch (...) {
+        os << RED << "ERROR: " << RESET << "Failed to open " << YELLOW << path << RESET << " for writing!" << '\n';
+        return 0;
+    }
+
+    ResourceContainer resourceContainer(std::filesystem::path(path).filename().string(), path);
+    ReadResource(*memoryMappedFile, resourceContainer);
+
+    std::vector<DataExtent> holes = GetHoles(resourceContainer.LiveExtents, resourceContainer.DataOffset, memoryMappedFile->Size);
+    delete memoryMappedFile;
+
+    int64_t releasedBytes = PunchHoles(path, holes, os);
+
+    if (releasedBytes <= 0)
+        return 0;
+
+    os << "Released " << GREEN << releasedBytes << " byte(s) " << RESET << "in " << YELLOW << path << RESET << "." << '\n';
+    return releasedBytes;
+}
+
+/**
+ * @brief Release the disk space used by data not referenced by the given sound container's sound entries
+ *
+ * @param path Path to the sound container
+ * @param os StringStream to output to
+ * @return Number of bytes of disk space released
+ */
+int64_t PunchSoundContainerHoles(std::string path, std::stringstream &os)
+{
+    MemoryMappedFile *memoryMappedFile;
+
+    try {
+        memoryMappedFile = new MemoryMappedFile(path);
+    }
+    catch (...) {
+        os << RED << "ERROR: " << RESET << "Failed to open " << YELLOW << path << RESET << " for writing!" << '\n';
+        return 0;
+    }
+
+    SoundContainer soundContainer(std::filesystem::path(path).stem().string(), path);
+    ReadSoundEntries(*memoryMappedFile, soundContainer);
+
+    if (soundContainer.LiveExtents.empty()) {
+        delete memoryMappedFile;
+        return 0;
+    }
+
+    if (!IsSoundDataValid(*memoryMappedFile, soundContainer)) {
+        os << RED << "ERROR: " << RESET << "Found overlapping sound data in " << YELLOW << path << RESET << ", skipping" << '\n';
+        delete memoryMappedFile;
+        return 0;
+    }
+
+    std::vector<DataExtent> holes = GetHoles(soundContainer.LiveExtents, soundContainer.LiveExtents.front().Offset, memoryMappedFile->Size);
+    delete memoryMappedFile;
+
+    int64_t releasedBytes = PunchHoles(path, holes, os);
+
+    if (releasedBytes <= 0)
+        return 0;
+
+    os << "Released " << GREEN << releasedBytes << " byte(s) " << RESET << "in " << YELLOW << path << RESET << "." << '\n';
+    return releasedBytes;
+}
+
+/**
+ * @brief Compact all resource and sound containers in the game directory
+ *
+ * Containers are compacted in parallel, each thread getting an equal share of the memory budget for its copy buffer.
+ * When punching holes, the unreferenced data is released from disk instead, without rewriting the containers.
+ *
+ * @param memoryBudget Memory budget for the copy buffers, in bytes
+ * @param punchHoles Whether to punch holes instead of rewriting the containers
+ */
+void CompactContainers(int64_t memoryBudget, bool punchHoles)
+{
+    std::vector<std::string> resourcePaths = ResourceContainerPathList;
+    std::vector<std::string> soundPaths;
+    std::string soundContainersPath = BasePath + "sound" + Separator + "soundbanks" + Separator + "pc" + Separator;
+
+    if (std::filesystem::is_directory(soundContainersPath)) {
+        for (auto &file : std::filesystem::directory_iterator(soundContainersPath)) {
+            if (file.path().extension().string() == ".snd")
+                soundPaths.push_back(file.path().string());
+        }
+    }
+
+    size_t containerCount = resourcePaths.size() + soundPaths.size();
+    size_t threadCount = 1;
+
+    if (MultiThreading)
+        threadCount = std::min<size_t>(std::max(std::thread::hardware_concurrency(), 1U), containerCount);
+
+    if (threadCount == 0)
+        return;
+
+    int64_t bufferSize = std::max<int64_t>(memoryBudget / threadCount, 4096);
+
+    std::vector<std::stringstream> compactStreams(containerCount);
+    std::atomic<size_t> nextContainer = 0;
+    std::atomic<int64_t> totalRecoveredBytes = 0;
+
+    auto compactWorker = [&]() {
+        for (size_t i = nextContainer++; i < containerCount; i = nextContainer++) {
+            // The unreferenced data includes the original data kept for restoring the container
+            ContainerSnapshot snapshot;
+            snapshot.ContainerPath = i < resourcePaths.size() ? resourcePaths[i] : soundPaths[i - resourcePaths.size()];
+
+            if (snapshot.Exists()) {
+                compactStreams[i] << RED << "WARNING: " << RESET << "Skipped " << YELLOW << snapshot.ContainerPath << RESET
+                    << ", it can be restored to its original state. Delete " << snapshot.GetPath() << " to compact it." << '\n';
+                continue;
+            }
+
+            if (punchHoles) {
+                if (i < resourcePaths.size())
+                    totalRecoveredBytes += PunchResourceContainerHoles(resourcePaths[i], compactStreams[i]);
+                else
+                    totalRecoveredBytes += PunchSoundContainerHoles(soundPaths[i - resourcePaths.size()], compactStreams[i]);
+            }
+            else {
+                if (i < resourcePaths.size())
+                    totalRecoveredBytes += CompactResourceContainer(resourcePaths[i], bufferSize, compactStreams[i]);
+                else
+                    totalRecoveredBytes += CompactSoundContainer(soundPaths[i - resourcePaths.size()], bufferSize, compactStreams[i]);
+            }
+        }
+    };
+
+    std::vector<std::thread> compactThreads;
+    compactThreads.reserve(threadCount - 1);
+
+    for (size_t i = 0; i < threadCount - 1; i++)
+        compactThreads.push_back(std::thread(compactWorker));
+
+    compactWorker();
+
+    for (auto &thread : compactThreads)
+        thread.join();
+
+    for (auto &compactStream : compactStreams)
+        std::cout << compactStream.str();
+
+    std::cout << (punchHoles ? "Released " : "Recovered ") << GREEN << totalRecoveredBytes << " byte(s) " << RESET << "in total." << '\n';
+}
\ No newline at end of file
@@ -0,0 +1,329 @@
+/*
+* This file is part of EternalModLoaderCpp (https://github.com/PowerBall253/EternalModLoaderCpp).
+* Copyright (C) 2021 PowerBall253
+*
+* EternalModLoaderCpp is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* EternalModLoaderCpp is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with EternalModLoaderCpp. If not, see <https://www.gnu.org/licenses/>.
+*/
+#include <iostream>
+#include <vector>
+#include <string>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <openssl/evp.h>
+
+#include "CompressionCache/CompressionCache.hpp"
+
+// Cache entry file signature
+const char CompressionCacheMagic[8] = { 'E', 'M', 'L', 'O', 'O', 'D', 'L', '2' };
+
+// Size of the key, a SHA-256 digest
+const int64_t CompressionCacheKeySize = 32;
+
+// Size of the cache entry header: magic, key, decompressed size and compression method
+const int64_t CompressionCacheHeaderSize = 52;
+
+// Size of the results kept in memory for the current load, larger results are compressed again if needed
+const uint64_t CompressionCacheMaxMemory = 256 * 1024 * 1024;
+
+// Size of the entries kept on disk between runs, the least recently used ones are removed past it
+const uint64_t CompressionCacheMaxDiskSize = 1024 * 1024 * 1024;
+
+/**
+ * @brief Get the key of the given data compressed with the given method
+ *
+ * @param decompressedData Data to compress
+ * @param method Compression format and level
+ * @return SHA-256 digest of the method and data, or an empty string on failure
+ */
+static std::string GetCompressionCacheKey(std::vector<std::byte> &decompressedData, int32_t method)
+{
+    std::string key(CompressionCacheKeySize, '\0');
+    EVP_MD_CTX *digestContext = EVP_MD_CTX_new();
+
+    if (digestContext == NULL)
+        return "";
+
+    bool success = EVP_DigestInit_ex(digestContext, EVP_sha256(), NULL) == 1
+        && EVP_DigestUpdate(digestContext, &method, 4) == 1
+        && EVP_DigestUpdate(digestContext, decompressedData.data(), decompressedData.size()) == 1
+        && EVP_DigestFinal_ex(digestContext, (unsigned char*)key.data(), NULL) == 1;
+
+    EVP_MD_CTX_free(digestContext);
+
+    return success ? key : "";
+}
+
+/**
+ * @brief Get the path to the given cache entry's file
+ *
+ * @param key Cache entry's key
+ * @return Path to the entry's file
+ */
+std::string CompressionCache::GetEntryPath(const std::string &key) const
+{
+    std::stringstream entryPath;
+    entryPath << std::hex << std::setfill('0');
+
+    for (auto c : key)
+        entryPath << std::setw(2) << (int32_t)(uint8_t)c;
+
+    entryPath << ".oodle";
+
+    return (std::filesystem::path(Directory) / entryPath.str()).string();
+}
+
+/**
+ * @brief Load the given entry from the cache directory
+ *
+ * Loaded entries are marked as recently used, so they're the last ones pruned.
+ *
+ * @param key Cache entry's key
+ * @param decompressedSize Size of the data that was compressed, to check the entry against
+ * @param method Compression format and level, to check the entry against
+ * @param compressedData Vector to load the compressed data into
+ * @return True if the entry was found, false otherwise
+ */
+bool CompressionCache::Load(const std::string &key, uint64_t decompressedSize, int32_t method, std::vector<std::byte> &compressedData)
+{
+    if (Directory.empty())
+        return false;
+
+    std::string entryPath = GetEntryPath(key);
+    std::ifstream entryFile(entryPath, std::ios::binary);
+
+    if (!entryFile)
+        return false;
+
+    std::byte header[CompressionCacheHeaderSize];
+    uint64_t entryDecompressedSize;
+    int32_t entryMethod;
+
+    if (!entryFile.read((char*)header, CompressionCacheHeaderSize) || memcmp(header, CompressionCacheMagic, 8) != 0
+        || memcmp(header + 8, key.data(), CompressionCacheKeySize) != 0) {
+            return false;
+    }
+
+    std::copy(header + 40, header + 48, (std::byte*)&entryDecompressedSize);
+    std::copy(header + 48, header + 52, (std::byte*)&entryMethod);
+
+    if (entryDecompressedSize != decompressedSize || entryMethod != method)
+        return false;
+
+    try {
+        compressedData.resize(std::filesystem::file_size(entryPath) - CompressionCacheHeaderSize);
+    }
+    catch (...) {
+        return false;
+    }
+
+    if (compressedData.empty() || !entryFile.read((char*)compressedData.data(), compressedData.size()))
+        return false;
+
+    try {
+        std::filesystem::last_write_time(entryPath, std::filesystem::file_time_type::clock::now());
+    }
+    catch (...) {
+    }
+
+    return true;
+}
+
+/**
+ * @brief Save the given entry to the cache directory
+ *
+ * The entry is written to a temporary file first, so other runs never see it incomplete.
+ *
+ * @param key Cache entry's key
+ * @param decompressedSize Size of the data that was compressed
+ * @param method Compression format and level
+ * @param compressedData Compressed data
+ */
+void CompressionCache::Save(const std::string &key, uint64_t decompressedSize, int32_t method, std::vector<std::byte> &compressedData)
+{
+    if (Directory.empty())
+        return;
+
+    std::stringstream tempPath;
+    tempPath << GetEntryPath(key) << '.' << std::this_thread::get_id() << ".tmp";
+
+    try {
+        std::filesystem::create_directories(Directory);
+
+        std::ofstream entryFile(tempPath.str(), std::ios::binary);
+        entryFile.write(CompressionCacheMagic, 8);
+        entryFile.write(key.data(), CompressionCacheKeySize);
+        entryFile.write((char*)&decompressedSize, 8);
+        entryFile.write((char*)&method, 4);
+        entryFile.write((char*)compressedData.data(), compressedData.size());
+        entryFile.close();
+
+        if (entryFile)
+            std::filesystem::rename(tempPath.str(), GetEntryPath(key));
+        else
+            std::filesystem::remove(tempPath.str());
+    }
+    catch (...) {
+        return;
+    }
+}
+
+/**
+ * @brief Compress the given data with Oodle, or get the result of compressing the same data before
+ *
+ * If several threads compress the same data at once, only the first one does it, the others waiting for its result.
+ *
+ * @param decompressedData Byte vector containing the data to compress
+ * @param format Oodle format to use for compression
+ * @param compressionLevel Oodle compression level to use for compression
+ * @return A byte vector containing the compressed data, or an empty byte vector on failure
+ */
+std::vector<std::byte> CompressionCache::Compress(std::vector<std::byte> &decompressedData, OodleFormat format, OodleCompressionLevel compressionLevel)
+{
+    uint64_t decompressedSize = decompressedData.size();
+    int32_t method = (int32_t)format << 16 | (int32_t)compressionLevel;
+    std::string key = GetCompressionCacheKey(decompressedData, method);
+
+    if (key.empty()) {
+        Misses++;
+
+        try {
+            return OodleCompress(decompressedData, format, compressionLevel);
+        }
+        catch (...) {
+            return std::vector<std::byte>();
+        }
+    }
+
+    std::promise<std::vector<std::byte>> result;
+    std::shared_future<std::vector<std::byte>> entry;
+    bool isFirst = false;
+
+    Mutex.lock();
+
+    if (Entries.count(key) == 0) {
+        entry = result.get_future().share();
+        Entries[key] = entry;
+        isFirst = true;
+    }
+    else {
+        entry = Entries[key];
+    }
+
+    Mutex.unlock();
+
+    if (!isFirst) {
+        Hits++;
+        return entry.get();
+    }
+
+    std::vector<std::byte> compressedData;
+
+    if (Load(key, decompressedSize, method, compressedData)) {
+        Hits++;
+    }
+    else {
+        Misses++;
+
+        try {
+            compressedData = OodleCompress(decompressedData, format, compressionLevel);
+        }
+        catch (...) {
+            compressedData.resize(0);
+        }
+
+        if (!compressedData.empty())
+            Save(key, decompressedSize, method, compressedData);
+    }
+
+    result.set_value(compressedData);
+
+    // Threads already waiting for the result keep their copy of it
+    Mutex.lock();
+
+    if (MemoryUsage + compressedData.size() > CompressionCacheMaxMemory)
+        Entries.erase(key);
+    else
+        MemoryUsage += compressedData.size();
+
+    Mutex.unlock();
+
+    return compressedData;
+}
+
+/**
+ * @brief Release the results kept in memory
+ *
+ * Called after each load, the results stay available from the cache directory.
+ */
+void CompressionCache::Clear()
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    Entries.clear();
+    MemoryUsage = 0;
+}
+
+/**
+ * @brief Remove the least recently used entries from the cache directory, until it fits its size limit
+ *
+ * Entries in an older format can't be used anymore and are always removed.
+ */
+void CompressionCache::Prune()
+{
+    if (Directory.empty())
+        return;
+
+    try {
+        if (!std::filesystem::is_directory(Directory))
+            return;
+
+        std::vector<std::pair<std::filesystem::file_time_type, std::filesystem::path>> entryFiles;
+        uint64_t directorySize = 0;
+
+        for (const auto &file : std::filesystem::directory_iterator(Directory)) {
+            if (!file.is_regular_file() || file.path().extension() != ".oodle")
+                continue;
+
+            if (file.path().stem().string().size() != CompressionCacheKeySize * 2) {
+                std::filesystem::remove(file.path());
+                continue;
+            }
+
+            entryFiles.push_back(std::make_pair(file.last_write_time(), file.path()));
+            directorySize += file.file_size();
+        }
+
+        if (directorySize <= CompressionCacheMaxDiskSize)
+            return;
+
+        std::sort(entryFiles.begin(), entryFiles.end());
+
+        for (auto &[lastWriteTime, entryPath] : entryFiles) {
+            if (directorySize <= CompressionCacheMaxDiskSize)
+                break;
+
+            uint64_t entrySize = std::filesystem::file_size(entryPath);
+
+            if (std::filesystem::remove(entryPath))
+                directorySize -= entrySize;
+        }
+    }
+    catch (...) {
+        return;
+    }
+}
\ No newline at end of file
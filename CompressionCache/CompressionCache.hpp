@@ -0,0 +1,59 @@
+/*
+* This file is part of EternalModLoaderCpp (https://github.com/PowerBall253/EternalModLoaderCpp).
+* Copyright (C) 2021 PowerBall253
+*
+* EternalModLoaderCpp is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* EternalModLoaderCpp is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with EternalModLoaderCpp. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef COMPRESSIONCACHE_HPP
+#define COMPRESSIONCACHE_HPP
+
+#include <vector>
+#include <string>
+#include <map>
+#include <mutex>
+#include <future>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+#include "Oodle/Oodle.hpp"
+
+/**
+ * @brief Content-addressed cache of Oodle compression results
+ *
+ * Results are keyed by a SHA-256 digest of the input bytes, the format and the compression level.
+ * They're kept in memory for the current load, up to a size limit, so data going into several containers
+ * is only compressed once, and in a directory on disk between runs, if one is set.
+ */
+class CompressionCache {
+public:
+    std::string Directory;
+    std::atomic<int32_t> Hits = 0;
+    std::atomic<int32_t> Misses = 0;
+
+    std::vector<std::byte> Compress(std::vector<std::byte> &decompressedData, OodleFormat format, OodleCompressionLevel compressionLevel);
+    void Clear();
+    void Prune();
+private:
+    std::mutex Mutex;
+    std::map<std::string, std::shared_future<std::vector<std::byte>>> Entries;
+    uint64_t MemoryUsage = 0;
+
+    std::string GetEntryPath(const std::string &key) const;
+    bool Load(const std::string &key, uint64_t decompressedSize, int32_t method, std::vector<std::byte> &compressedData);
+    void Save(const std::string &key, uint64_t decompressedSize, int32_t method, std::vector<std::byte> &compressedData);
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,285 @@
+/*
+* This file is part of EternalModLoaderCpp (https://github.com/PowerBall253/EternalModLoaderCpp).
+* Copyright (C) 2021 PowerBall253
+*
+* EternalModLoaderCpp is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* EternalModLoaderCpp is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with EternalModLoaderCpp. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <iostream>
+#include <filesystem>
+#include <algorithm>
+#include <climits>
+#include <map>
+#include <tuple>
+
+#include "miniz/miniz.h"
+#include "EternalModLoader.hpp"
+
+/**
+ * @brief Mod file claimed by one or more mods, and the ones whose data can end up in the container
+ *
+ * Mod files replacing a resource are applied in order, so the last one applied wins.
+ * Mod files adding a new resource are skipped once it's been added, so the first one applied wins.
+ * Which case applies is only known once the container is read, so both mod files are kept.
+ */
+class ModFileClaim {
+public:
+    std::string ModFilePath;
+    std::string ModName;
+    int32_t LoadPriority = 0;
+    std::string AddedModFilePath;
+    std::string AddedModName;
+    int32_t AddedLoadPriority = 0;
+    std::vector<std::string> OverriddenModFilePaths;
+
+    /**
+     * @brief Construct a new ModFileClaim object
+     *
+     * @param modFilePath Path of the mod file claiming the resource
+     * @param modName Name of the mod the file belongs to
+     * @param loadPriority Load priority of the mod the file belongs to
+     */
+    ModFileClaim(std::string modFilePath, std::string modName, int32_t loadPriority)
+    {
+        ModFilePath = modFilePath;
+        ModName = modName;
+        LoadPriority = loadPriority;
+        AddedModFilePath = modFilePath;
+        AddedModName = modName;
+        AddedLoadPriority = loadPriority;
+    }
+
+    ModFileClaim() {}
+};
+
+// Mod files to load, keyed by their container and resource name, resolved before any of them is extracted
+std::map<std::string, ModFileClaim> ModFileClaims;
+
+/**
+ * @brief Get the key identifying the resource a mod file replaces, the same way the mod loading functions name it
+ *
+ * Files under EternalMod (assets info and strings JSON files) are merged with each other instead of replacing a resource,
+ * so they never conflict.
+ *
+ * @param modFilePath Path of the mod file, relative to the zip or the Mods folder, with '/' separators
+ * @return Container and resource name of the mod file, or an empty string if it can't conflict with other mod files
+ */
+std::string GetModFileClaimKey(const std::string &modFilePath)
+{
+    if (modFilePath.empty() || modFilePath.back() == '/')
+        return "";
+
+    std::vector<std::string> modFilePathParts = SplitString(modFilePath, '/');
+
+    if (modFilePathParts.size() < 2 || ToLower(modFilePathParts[1]) == "eternalmod")
+        return "";
+
+    std::string resourceName = modFilePathParts[0];
+    std::string modFileName = modFilePath;
+
+    if (ToLower(resourceName) == "generated")
+        resourceName = "gameresources";
+    else
+        modFileName = modFilePath.substr(resourceName.size() + 1);
+
+    if (UpToDateContainers.count(resourceName) != 0)
+        return "";
+
+    if (!PathToResourceContainer(resourceName + ".resources").empty())
+        return resourceName + '\t' + modFileName;
+
+    if (PathToSoundContainer(resourceName).empty())
+        return "";
+
+    // Unsupported sound files are skipped when loading, they can't override anything
+    std::string soundExtension = std::filesystem::path(modFileName).extension().string();
+
+    if (std::find(SupportedFileFormats.begin(), SupportedFileFormats.end(), soundExtension) == SupportedFileFormats.end())
+        return "";
+
+    return resourceName + '\t' + std::filesystem::path(modFileName).filename().string();
+}
+
+/**
+ * @brief Check if a mod file is applied before another one (see IsAppliedBefore):
+ * the one with the highest load priority value first, then the lowest mod name, then the lowest path,
+ * so it never depends on the order mods were found in
+ *
+ * @param modFilePath1 Path of the first mod file
+ * @param modName1 Name of the mod the first file belongs to
+ * @param loadPriority1 Load priority of the mod the first file belongs to
+ * @param modFilePath2 Path of the second mod file
+ * @param modName2 Name of the mod the second file belongs to
+ * @param loadPriority2 Load priority of the mod the second file belongs to
+ * @return True if the first mod file is applied before the second one, false otherwise
+ */
+bool IsClaimAppliedBefore(const std::string &modFilePath1, const std::string &modName1, int32_t loadPriority1,
+    const std::string &modFilePath2, const std::string &modName2, int32_t loadPriority2)
+{
+    if (loadPriority1 != loadPriority2)
+        return loadPriority1 > loadPriority2;
+
+    return std::tie(modName1, modFilePath1) < std::tie(modName2, modFilePath2);
+}
+
+/**
+ * @brief Claim the resource replaced or added by a mod file, keeping the claims of the mod files that win
+ *
+ * The mod file applied last wins if the resource is in the container, and the one applied first wins if it's added to it.
+ *
+ * @param key Container and resource name of the mod file
+ * @param modFilePath Path of the mod file
+ * @param modName Name of the mod the file belongs to
+ * @param loadPriority Load priority of the mod the file belongs to
+ */
+void ClaimModFile(const std::string &key, const std::string &modFilePath, const std::string &modName, int32_t loadPriority)
+{
+    auto x = ModFileClaims.find(key);
+
+    if (x == ModFileClaims.end()) {
+        ModFileClaims[key] = ModFileClaim(modFilePath, modName, loadPriority);
+        return;
+    }
+
+    ModFileClaim &claim = x->second;
+    std::string replacedModFilePath = claim.ModFilePath;
+    std::string addedModFilePath = claim.AddedModFilePath;
+
+    if (IsClaimAppliedBefore(claim.ModFilePath, claim.ModName, claim.LoadPriority, modFilePath, modName, loadPriority)) {
+        claim.ModFilePath = modFilePath;
+        claim.ModName = modName;
+        claim.LoadPriority = loadPriority;
+    }
+
+    if (IsClaimAppliedBefore(modFilePath, modName, loadPriority, claim.AddedModFilePath, claim.AddedModName, claim.AddedLoadPriority)) {
+        claim.AddedModFilePath = modFilePath;
+        claim.AddedModName = modName;
+        claim.AddedLoadPriority = loadPriority;
+    }
+
+    // Mod files that can't win either way are overridden
+    for (auto &candidate : { replacedModFilePath, addedModFilePath, modFilePath }) {
+        if (candidate != claim.ModFilePath && candidate != claim.AddedModFilePath
+            && std::find(claim.OverriddenModFilePaths.begin(), claim.OverriddenModFilePaths.end(), candidate) == claim.OverriddenModFilePaths.end()) {
+                claim.OverriddenModFilePaths.push_back(candidate);
+        }
+    }
+}
+
+/**
+ * @brief Claim the resources replaced by the files of a zipped mod, reading only its central directory and EternalMod.json
+ *
+ * @param zippedMod Zipped mod path
+ */
+void ClaimZippedModFiles(const std::string &zippedMod)
+{
+    mz_zip_archive modZip;
+    mz_zip_zero_struct(&modZip);
+
+    if (!mz_zip_reader_init_file(&modZip, zippedMod.c_str(), 0))
+        return;
+
+    Mod mod(std::filesystem::path(zippedMod).filename().string());
+    char *unzippedModJson;
+    size_t unzippedModJsonSize;
+
+    if ((unzippedModJson = (char*)mz_zip_reader_extract_file_to_heap(&modZip, "EternalMod.json", &unzippedModJsonSize, 0)) != NULL) {
+        std::string modJson(unzippedModJson, unzippedModJsonSize);
+        free(unzippedModJson);
+
+        try {
+            mod = Mod(mod.Name, modJson);
+        }
+        catch (...) {
+        }
+    }
+
+    // The mod is skipped when loading
+    if (mod.RequiredVersion > Version) {
+        mz_zip_reader_end(&modZip);
+        return;
+    }
+
+    for (mz_uint i = 0; i < mz_zip_reader_get_num_files(&modZip); i++) {
+        mz_zip_archive_file_stat zipEntryStat;
+
+        if (!mz_zip_reader_file_stat(&modZip, i, &zipEntryStat))
+            continue;
+
+        std::string key = GetModFileClaimKey(zipEntryStat.m_filename);
+
+        if (!key.empty())
+            ClaimModFile(key, zippedMod + '/' + zipEntryStat.m_filename, mod.Name, mod.LoadPriority);
+    }
+
+    mz_zip_reader_end(&modZip);
+}
+
+/**
+ * @brief Resolve the conflicts between the mods' files before loading them,
+ * so the files overridden by other mods are never extracted, read or written
+ *
+ * @param zippedMods Zipped mod paths
+ * @param unzippedMods Loose mod file paths
+ */
+void ResolveModConflicts(std::vector<std::string> &zippedMods, std::vector<std::string> &unzippedMods)
+{
+    ModFileClaims.clear();
+
+    for (auto &zippedMod : zippedMods)
+        ClaimZippedModFiles(zippedMod);
+
+    // Loose mod files are loaded last, with the lowest possible load priority
+    for (auto &unzippedMod : unzippedMods) {
+        std::string modFilePath = unzippedMod;
+        std::replace(modFilePath.begin(), modFilePath.end(), Separator, '/');
+
+        std::string key = GetModFileClaimKey(GetLooseModFileName(unzippedMod));
+
+        if (!key.empty())
+            ClaimModFile(key, modFilePath, "", INT_MIN);
+    }
+
+    int32_t overriddenCount = 0;
+
+    for (auto &[key, claim] : ModFileClaims)
+        overriddenCount += claim.OverriddenModFilePaths.size();
+
+    if (overriddenCount == 0)
+        return;
+
+    std::cout << "Skipping " << GREEN << overriddenCount << " mod file(s) " << RESET << "overridden by other mods..." << '\n';
+
+    if (Verbose) {
+        for (auto &[key, claim] : ModFileClaims) {
+            for (auto &overriddenModFilePath : claim.OverriddenModFilePaths)
+                std::cout << '\t' << YELLOW << claim.ModFilePath << RESET << " overrides " << overriddenModFilePath << '\n';
+        }
+    }
+}
+
+/**
+ * @brief Check if a mod file was overridden by another mod's file when resolving conflicts
+ *
+ * @param containerName Name of the container the mod file goes into
+ * @param modFileName Name of the resource the mod file replaces
+ * @param modFilePath Path of the mod file, prefixed with the zip's path for zipped mods, with '/' separators
+ * @return True if other mod files replace or add the same resource and win either way, false otherwise
+ */
+bool IsModFileOverridden(const std::string &containerName, const std::string &modFileName, const std::string &modFilePath)
+{
+    auto claim = ModFileClaims.find(containerName + '\t' + modFileName);
+
+    return claim != ModFileClaims.end() && claim->second.ModFilePath != modFilePath && claim->second.AddedModFilePath != modFilePath;
+}
\ No newline at end of file
@@ -0,0 +1,219 @@
+/*
+* This file is part of EternalModLoaderCpp (https://github.com/PowerBall253/EternalModLoaderCpp).
+* Copyright (C) 2021 PowerBall253
+*
+* EternalModLoaderCpp is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* EternalModLoaderCpp is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with EternalModLoaderCpp. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+
+#include "ContainerJournal/ContainerJournal.hpp"
+
+// Journal file signature
+const char JournalMagic[8] = { 'E', 'M', 'L', 'J', 'R', 'N', 'L', '2' };
+
+// Size of the header before the metadata: magic and metadata size
+const int64_t JournalHeaderSize = 16;
+
+/**
+ * @brief Compute the FNV-1a hash of the given bytes
+ *
+ * @param bytes Bytes to hash
+ * @param size Number of bytes to hash
+ * @param hash Hash to continue from
+ * @return Hash of the bytes
+ */
+uint64_t JournalChecksum(const std::byte *bytes, size_t size, uint64_t hash)
+{
+    for (size_t i = 0; i < size; i++) {
+        hash ^= (uint8_t)bytes[i];
+        hash *= 0x100000001B3;
+    }
+
+    return hash;
+}
+
+/**
+ * @brief Seek to the given offset of the file
+ *
+ * @param file File to seek in
+ * @param offset Offset to seek to
+ * @return True on success, false otherwise
+ */
+bool SeekFile(FILE *file, int64_t offset)
+{
+#ifdef _WIN32
+    return _fseeki64(file, offset, SEEK_SET) == 0;
+#else
+    return fseeko(file, offset, SEEK_SET) == 0;
+#endif
+}
+
+/**
+ * @brief Flush the file's buffers and changes to disk
+ *
+ * @param file File to flush
+ * @return True on success, false otherwise
+ */
+bool FlushFile(FILE *file)
+{
+    if (fflush(file) != 0)
+        return false;
+
+#ifdef _WIN32
+    return _commit(_fileno(file)) == 0;
+#else
+    return fsync(fileno(file)) == 0;
+#endif
+}
+
+/**
+ * @brief Get the path to the container's journal
+ *
+ * @return Path to the journal
+ */
+std::string ContainerJournal::GetPath() const
+{
+    return ContainerPath + ".journal";
+}
+
+/**
+ * @brief Write the journal next to the container
+ *
+ * @param flush Whether to flush the journal to disk before returning
+ * @return True on success, false otherwise
+ */
+bool ContainerJournal::Save(bool flush)
+{
+    FILE *journalFile = fopen(GetPath().c_str(), "wb");
+
+    if (!journalFile)
+        return false;
+
+    std::vector<std::byte> journalBytes(JournalHeaderSize + Metadata.size() + 8);
+    uint64_t metadataSize = Metadata.size();
+
+    std::copy((std::byte*)JournalMagic, (std::byte*)JournalMagic + 8, journalBytes.begin());
+    std::copy((std::byte*)&metadataSize, (std::byte*)&metadataSize + 8, journalBytes.begin() + 8);
+    std::copy(Metadata.begin(), Metadata.end(), journalBytes.begin() + JournalHeaderSize);
+
+    uint64_t checksum = JournalChecksum(journalBytes.data(), journalBytes.size() - 8);
+    std::copy((std::byte*)&checksum, (std::byte*)&checksum + 8, journalBytes.end() - 8);
+
+    bool success = fwrite(journalBytes.data(), 1, journalBytes.size(), journalFile) == journalBytes.size();
+    success = (flush ? FlushFile(journalFile) : fflush(journalFile) == 0) && success;
+    fclose(journalFile);
+
+#ifndef _WIN32
+    // Make sure the journal's directory entry is on disk too
+    if (flush && success) {
+        int directoryFileDescriptor = open(std::filesystem::path(GetPath()).parent_path().string().c_str(), O_RDONLY);
+
+        if (directoryFileDescriptor != -1) {
+            fsync(directoryFileDescriptor);
+            close(directoryFileDescriptor);
+        }
+    }
+#endif
+
+    return success;
+}
+
+/**
+ * @brief Load the given journal
+ *
+ * @param journalPath Path to the journal to load
+ * @return True if the journal is complete, false otherwise
+ */
+bool ContainerJournal::Load(const std::string &journalPath)
+{
+    ContainerPath = journalPath.substr(0, journalPath.size() - std::string(".journal").size());
+
+    FILE *journalFile = fopen(journalPath.c_str(), "rb");
+
+    if (!journalFile)
+        return false;
+
+    std::byte header[JournalHeaderSize];
+    uint64_t metadataSize = 0;
+    bool success = fread(header, 1, JournalHeaderSize, journalFile) == JournalHeaderSize && memcmp(header, JournalMagic, 8) == 0;
+
+    if (success) {
+        std::copy(header + 8, header + 16, (std::byte*)&metadataSize);
+
+        success = metadataSize <= std::filesystem::file_size(journalPath);
+    }
+
+    if (success) {
+        Metadata.resize(metadataSize);
+        uint64_t checksum;
+
+        success = fread(Metadata.data(), 1, metadataSize, journalFile) == metadataSize
+            && fread(&checksum, 1, 8, journalFile) == 8
+            && checksum == JournalChecksum(Metadata.data(), metadataSize, JournalChecksum(header, JournalHeaderSize));
+    }
+
+    fclose(journalFile);
+
+    return success;
+}
+
+/**
+ * @brief Apply the journal to the container by writing the new metadata
+ *
+ * Applying a journal again after an interruption gives the same result.
+ *
+ * @param flush Whether to flush the container to disk before returning
+ * @return True on success, false otherwise
+ */
+bool ContainerJournal::Apply(bool flush)
+{
+    FILE *containerFile = fopen(ContainerPath.c_str(), "r+b");
+
+    if (!containerFile)
+        return false;
+
+    bool success = SeekFile(containerFile, 0) && fwrite(Metadata.data(), 1, Metadata.size(), containerFile) == Metadata.size();
+    success = (flush ? FlushFile(containerFile) : fflush(containerFile) == 0) && success;
+    fclose(containerFile);
+
+    return success;
+}
+
+/**
+ * @brief Delete the journal once it's been applied
+ *
+ * @return True on success, false otherwise
+ */
+bool ContainerJournal::Remove()
+{
+    try {
+        std::filesystem::remove(GetPath());
+    }
+    catch (...) {
+        return false;
+    }
+
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,52 @@
+/*
+* This file is part of EternalModLoaderCpp (https://github.com/PowerBall253/EternalModLoaderCpp).
+* Copyright (C) 2021 PowerBall253
+*
+* EternalModLoaderCpp is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* EternalModLoaderCpp is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with EternalModLoaderCpp. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef CONTAINERJOURNAL_HPP
+#define CONTAINERJOURNAL_HPP
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+
+/**
+ * @brief Journal of the metadata changes to a container, kept next to it while they're applied
+ *
+ * The journal is written once all the new payloads are on disk, and holds the container's new metadata,
+ * which may run into the start of the old data section once the chunks stored there have been moved away.
+ * If the journal is complete, an interrupted run can be rolled forward by applying it again.
+ * Otherwise the container's metadata was never touched, and the journal is just discarded.
+ */
+class ContainerJournal {
+public:
+    std::string ContainerPath;
+    std::vector<std::byte> Metadata;
+
+    std::string GetPath() const;
+    bool Save(bool flush);
+    bool Load(const std::string &journalPath);
+    bool Apply(bool flush);
+    bool Remove();
+};
+
+uint64_t JournalChecksum(const std::byte *bytes, size_t size, uint64_t hash = 0xCBF29CE484222325);
+bool SeekFile(FILE *file, int64_t offset);
+bool FlushFile(FILE *file);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,237 @@
+/*
+* This file is part of EternalModLoaderCpp (https://github.com/PowerBall253/EternalModLoaderCpp).
+* Copyright (C) 2021 PowerBall253
+*
+* EternalModLoaderCpp is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* EternalModLoaderCpp is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with EternalModLoaderCpp. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <cstring>
+#include <filesystem>
+#include <algorithm>
+
+#include "ContainerJournal/ContainerJournal.hpp"
+#include "ContainerSnapshot/ContainerSnapshot.hpp"
+
+// Snapshot file signature
+const char SnapshotMagic[8] = { 'E', 'M', 'L', 'S', 'N', 'A', 'P', '2' };
+
+// Size of the header before the metadata: magic, original size, metadata size, displaced data size, checksum and restore flag
+const int64_t SnapshotHeaderSize = 48;
+
+// Offset of the restore flag in the header, not covered by the checksum
+const int64_t SnapshotRestoreFlagOffset = 40;
+
+/**
+ * @brief Get the path to the container's snapshot
+ *
+ * @return Path to the snapshot
+ */
+std::string ContainerSnapshot::GetPath() const
+{
+    return ContainerPath + ".snapshot";
+}
+
+/**
+ * @brief Check if the container has a snapshot
+ *
+ * @return True if the snapshot exists, false otherwise
+ */
+bool ContainerSnapshot::Exists() const
+{
+    try {
+        return std::filesystem::exists(GetPath());
+    }
+    catch (...) {
+        return false;
+    }
+}
+
+/**
+ * @brief Write the snapshot next to the container
+ *
+ * The snapshot is written to a temporary file and flushed to disk before taking its final name,
+ * so it's either complete or missing, and an older version of it is replaced the same way.
+ *
+ * @return True on success, false otherwise
+ */
+bool ContainerSnapshot::Save()
+{
+    std::string tempPath = GetPath() + ".tmp";
+    FILE *snapshotFile = fopen(tempPath.c_str(), "wb");
+
+    if (!snapshotFile)
+        return false;
+
+    std::vector<std::byte> snapshotBytes(SnapshotHeaderSize + Metadata.size() + DisplacedData.size());
+    uint64_t metadataSize = Metadata.size();
+    uint64_t displacedSize = DisplacedData.size();
+
+    std::copy((std::byte*)SnapshotMagic, (std::byte*)SnapshotMagic + 8, snapshotBytes.begin());
+    std::copy((std::byte*)&OriginalSize, (std::byte*)&OriginalSize + 8, snapshotBytes.begin() + 8);
+    std::copy((std::byte*)&metadataSize, (std::byte*)&metadataSize + 8, snapshotBytes.begin() + 16);
+    std::copy((std::byte*)&displacedSize, (std::byte*)&displacedSize + 8, snapshotBytes.begin() + 24);
+    std::copy(Metadata.begin(), Metadata.end(), snapshotBytes.begin() + SnapshotHeaderSize);
+    std::copy(DisplacedData.begin(), DisplacedData.end(), snapshotBytes.begin() + SnapshotHeaderSize + metadataSize);
+
+    uint64_t checksum = JournalChecksum(snapshotBytes.data() + SnapshotHeaderSize, metadataSize + displacedSize, JournalChecksum(snapshotBytes.data(), 32));
+    std::copy((std::byte*)&checksum, (std::byte*)&checksum + 8, snapshotBytes.begin() + 32);
+
+    bool success = fwrite(snapshotBytes.data(), 1, snapshotBytes.size(), snapshotFile) == snapshotBytes.size();
+    success = FlushFile(snapshotFile) && success;
+    fclose(snapshotFile);
+
+    try {
+        if (success)
+            std::filesystem::rename(tempPath, GetPath());
+        else
+            std::filesystem::remove(tempPath);
+    }
+    catch (...) {
+        return false;
+    }
+
+    return success;
+}
+
+/**
+ * @brief Load the given container's snapshot
+ *
+ * @param containerPath Path to the container
+ * @return True on success, false if the snapshot is missing or corrupted
+ */
+bool ContainerSnapshot::Load(const std::string &containerPath)
+{
+    ContainerPath = containerPath;
+
+    FILE *snapshotFile = fopen(GetPath().c_str(), "rb");
+
+    if (!snapshotFile)
+        return false;
+
+    std::byte header[SnapshotHeaderSize];
+    uint64_t metadataSize = 0, displacedSize = 0, checksum = 0;
+    bool success = fread(header, 1, SnapshotHeaderSize, snapshotFile) == SnapshotHeaderSize && memcmp(header, SnapshotMagic, 8) == 0;
+
+    if (success) {
+        std::copy(header + 8, header + 16, (std::byte*)&OriginalSize);
+        std::copy(header + 16, header + 24, (std::byte*)&metadataSize);
+        std::copy(header + 24, header + 32, (std::byte*)&displacedSize);
+        std::copy(header + 32, header + 40, (std::byte*)&checksum);
+        RestoreStarted = header[SnapshotRestoreFlagOffset] != (std::byte)0;
+
+        uint64_t snapshotSize = std::filesystem::file_size(GetPath());
+        success = metadataSize <= OriginalSize && displacedSize <= OriginalSize - metadataSize
+            && metadataSize <= snapshotSize && displacedSize <= snapshotSize - metadataSize;
+    }
+
+    if (success) {
+        Metadata.resize(metadataSize);
+        DisplacedData.resize(displacedSize);
+
+        success = fread(Metadata.data(), 1, metadataSize, snapshotFile) == metadataSize
+            && fread(DisplacedData.data(), 1, displacedSize, snapshotFile) == displacedSize
+            && checksum == JournalChecksum(DisplacedData.data(), displacedSize,
+                JournalChecksum(Metadata.data(), metadataSize, JournalChecksum(header, 32)));
+    }
+
+    fclose(snapshotFile);
+
+    return success;
+}
+
+/**
+ * @brief Record that the container is being restored, so it isn't loaded into before the restore is run again
+ *
+ * @return True on success, false otherwise
+ */
+bool ContainerSnapshot::SaveRestoreStarted()
+{
+    FILE *snapshotFile = fopen(GetPath().c_str(), "r+b");
+
+    if (!snapshotFile)
+        return false;
+
+    std::byte restoreFlag[8] = { (std::byte)1 };
+
+    bool success = SeekFile(snapshotFile, SnapshotRestoreFlagOffset)
+        && fwrite(restoreFlag, 1, 8, snapshotFile) == 8
+        && FlushFile(snapshotFile);
+
+    fclose(snapshotFile);
+    RestoreStarted = true;
+
+    return success;
+}
+
+/**
+ * @brief Restore the container to the state it was in when the snapshot was taken
+ *
+ * Only bytes held in the snapshot are written, so an interrupted restore can simply be run again.
+ *
+ * @return True on success, false otherwise
+ */
+bool ContainerSnapshot::Restore()
+{
+    if (!RestoreStarted && !SaveRestoreStarted())
+        return false;
+
+    FILE *containerFile = fopen(ContainerPath.c_str(), "r+b");
+
+    if (!containerFile)
+        return false;
+
+    bool success = SeekFile(containerFile, Metadata.size())
+        && fwrite(DisplacedData.data(), 1, DisplacedData.size(), containerFile) == DisplacedData.size();
+
+    success = success && SeekFile(containerFile, 0) && fwrite(Metadata.data(), 1, Metadata.size(), containerFile) == Metadata.size();
+    success = FlushFile(containerFile) && success;
+    fclose(containerFile);
+
+    if (!success)
+        return false;
+
+    try {
+        std::filesystem::resize_file(ContainerPath, OriginalSize);
+    }
+    catch (...) {
+        return false;
+    }
+
+    containerFile = fopen(ContainerPath.c_str(), "r+b");
+
+    if (!containerFile)
+        return false;
+
+    success = FlushFile(containerFile);
+    fclose(containerFile);
+
+    return success;
+}
+
+/**
+ * @brief Delete the snapshot
+ *
+ * @return True on success, false otherwise
+ */
+bool ContainerSnapshot::Remove()
+{
+    try {
+        std::filesystem::remove(GetPath());
+    }
+    catch (...) {
+        return false;
+    }
+
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,53 @@
+/*
+* This file is part of EternalModLoaderCpp (https://github.com/PowerBall253/EternalModLoaderCpp).
+* Copyright (C) 2021 PowerBall253
+*
+* EternalModLoaderCpp is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* EternalModLoaderCpp is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with EternalModLoaderCpp. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef CONTAINERSNAPSHOT_HPP
+#define CONTAINERSNAPSHOT_HPP
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+
+/**
+ * @brief Snapshot of a container's metadata and size, taken the first time mods are loaded into it
+ *
+ * Mods only append data and patch the metadata, so the container's original data stays in place.
+ * When the metadata grows, the start of the original data section it overwrites is kept in the snapshot too.
+ * Restoring the container only takes writing these bytes back, rewriting the metadata and truncating it.
+ */
+class ContainerSnapshot {
+public:
+    std::string ContainerPath;
+    uint64_t OriginalSize = 0;
+    bool RestoreStarted = false;
+    std::vector<std::byte> Metadata;
+    std::vector<std::byte> DisplacedData;
+
+    std::string GetPath() const;
+    bool Exists() const;
+    bool Save();
+    bool Load(const std::string &containerPath);
+    bool Restore();
+    bool Remove();
+private:
+    bool SaveRestoreStarted();
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,69 @@
+/*
+* This file is part of EternalModLoaderCpp (https://github.com/PowerBall253/EternalModLoaderCpp).
+* Copyright (C) 2021 PowerBall253
+*
+* EternalModLoaderCpp is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* EternalModLoaderCpp is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with EternalModLoaderCpp. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <cstring>
+
+#include "ContainerStorage/ContainerStorage.hpp"
+
+/**
+ * @brief Read a range of the container
+ *
+ * @param offset Offset of the range to read
+ * @param dest Buffer to read the range into
+ * @param size Size of the range to read
+ * @return True on success, false if the range is out of bounds
+ */
+bool ContainerStorage::Read(uint64_t offset, std::byte *dest, uint64_t size)
+{
+    if (offset > Size || size > Size - offset)
+        return false;
+
+    std::memcpy(dest, Mem + offset, size);
+    return true;
+}
+
+/**
+ * @brief Write a range of the container
+ *
+ * @param offset Offset of the range to write
+ * @param src Bytes to write
+ * @param size Size of the range to write
+ * @return True on success, false if the range is out of bounds
+ */
+bool ContainerStorage::Write(uint64_t offset, const std::byte *src, uint64_t size)
+{
+    if (offset > Size || size > Size - offset)
+        return false;
+
+    std::memmove(Mem + offset, src, size);
+    return true;
+}
+
+/**
+ * @brief Make room for the container's metadata to grow up to the given size, growing the container if needed
+ * The data stored in the new metadata region must have been moved elsewhere beforehand.
+ * @param metadataSize New size of the metadata
+ * @return True on success, false otherwise
+ */
+bool ContainerStorage::GrowMetadata(uint64_t metadataSize)
+{
+    if (metadataSize > Size && !Grow(metadataSize))
+        return false;
+
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,49 @@
+/*
+* This file is part of EternalModLoaderCpp (https://github.com/PowerBall253/EternalModLoaderCpp).
+* Copyright (C) 2021 PowerBall253
+*
+* EternalModLoaderCpp is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* EternalModLoaderCpp is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with EternalModLoaderCpp. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef CONTAINERSTORAGE_HPP
+#define CONTAINERSTORAGE_HPP
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * @brief Storage holding a container's bytes while mods are loaded into it
+ *
+ * Implementations keep the whole container addressable through Mem,
+ * so bulk copies can still be done in place.
+ */
+class ContainerStorage {
+public:
+    std::string FilePath;
+    std::byte *Mem = NULL;
+    uint64_t Size = 0;
+
+    virtual ~ContainerStorage() {}
+
+    virtual bool Read(uint64_t offset, std::byte *dest, uint64_t size);
+    virtual bool Write(uint64_t offset, const std::byte *src, uint64_t size);
+    virtual bool GrowMetadata(uint64_t metadataSize);
+    virtual bool Grow(uint64_t newSize) = 0;
+    virtual bool Truncate(uint64_t newSize) = 0;
+    virtual bool Sync() = 0;
+    virtual void Prefetch(uint64_t /*offset*/, uint64_t /*size*/) {}
+};
+
+#endif
\ No newline at end of file
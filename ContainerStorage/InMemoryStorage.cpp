@@ -0,0 +1,121 @@
+/*
+* This file is part of EternalModLoaderCpp (https://github.com/PowerBall253/EternalModLoaderCpp).
+* Copyright (C) 2021 PowerBall253
+*
+* EternalModLoaderCpp is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* EternalModLoaderCpp is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with EternalModLoaderCpp. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <fstream>
+#include <filesystem>
+
+#include "ContainerStorage/InMemoryStorage.hpp"
+
+/**
+ * @brief Construct a new InMemoryStorage object holding a copy of the given file
+ *
+ * The file path isn't kept, so nothing is ever written back to the file.
+ *
+ * @param filePath Path to the file to load in memory
+ */
+InMemoryStorage::InMemoryStorage(std::string filePath)
+{
+    Bytes.resize(std::filesystem::file_size(filePath));
+
+    if (Bytes.empty())
+        throw std::exception();
+
+    std::ifstream file(filePath, std::ios::binary);
+
+    if (!file.read((char*)Bytes.data(), Bytes.size()))
+        throw std::exception();
+
+    Mem = Bytes.data();
+    Size = Bytes.size();
+}
+
+/**
+ * @brief Construct a new InMemoryStorage object holding the given bytes
+ *
+ * @param bytes Container's bytes
+ */
+InMemoryStorage::InMemoryStorage(std::vector<std::byte> bytes)
+{
+    Bytes = std::move(bytes);
+    Mem = Bytes.data();
+    Size = Bytes.size();
+}
+
+/**
+ * @brief Grow the container, filling the new space with zeroes
+ *
+ * @param newSize New size for the container
+ * @return True on success, false otherwise
+ */
+bool InMemoryStorage::Grow(uint64_t newSize)
+{
+    if (newSize < Size)
+        return false;
+
+    try {
+        Bytes.resize(newSize);
+    }
+    catch (...) {
+        return false;
+    }
+
+    Mem = Bytes.data();
+    Size = newSize;
+
+    return true;
+}
+
+/**
+ * @brief Truncate the container
+ *
+ * @param newSize New size for the container
+ * @return True on success, false otherwise
+ */
+bool InMemoryStorage::Truncate(uint64_t newSize)
+{
+    if (newSize > Size)
+        return false;
+
+    Bytes.resize(newSize);
+    Mem = Bytes.data();
+    Size = newSize;
+
+    return true;
+}
+
+/**
+ * @brief Sync the container, nothing to do in memory
+ *
+ * @return True
+ */
+bool InMemoryStorage::Sync()
+{
+    return true;
+}
+
+/**
+ * @brief Save the container to the given file
+ *
+ * @param filePath Path to the file to write
+ * @return True on success, false otherwise
+ */
+bool InMemoryStorage::Save(std::string filePath)
+{
+    std::ofstream file(filePath, std::ios::binary);
+    return (bool)file.write((char*)Bytes.data(), Bytes.size());
+}
\ No newline at end of file
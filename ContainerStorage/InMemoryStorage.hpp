@@ -0,0 +1,44 @@
+/*
+* This file is part of EternalModLoaderCpp (https://github.com/PowerBall253/EternalModLoaderCpp).
+* Copyright (C) 2021 PowerBall253
+*
+* EternalModLoaderCpp is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* EternalModLoaderCpp is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with EternalModLoaderCpp. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef INMEMORYSTORAGE_HPP
+#define INMEMORYSTORAGE_HPP
+
+#include <vector>
+
+#include "ContainerStorage/ContainerStorage.hpp"
+
+/**
+ * @brief Container storage held entirely in memory
+ *
+ * Changes never reach the file the container was loaded from, unless saved explicitly.
+ */
+class InMemoryStorage : public ContainerStorage {
+public:
+    std::vector<std::byte> Bytes;
+
+    InMemoryStorage(std::string filePath);
+    InMemoryStorage(std::vector<std::byte> bytes);
+
+    bool Grow(uint64_t newSize);
+    bool Truncate(uint64_t newSize);
+    bool Sync();
+    bool Save(std::string filePath);
+};
+
+#endif
\ No newline at end of file
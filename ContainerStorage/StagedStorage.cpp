@@ -0,0 +1,159 @@
+/*
+* This file is part of EternalModLoaderCpp (https://github.com/PowerBall253/EternalModLoaderCpp).
+* Copyright (C) 2021 PowerBall253
+*
+* EternalModLoaderCpp is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* EternalModLoaderCpp is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with EternalModLoaderCpp. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <cstring>
+#include <algorithm>
+
+#include "ContainerStorage/StagedStorage.hpp"
+
+/**
+ * @brief Construct a new StagedStorage object
+ *
+ * @param base Storage holding the container
+ * @param metadataSize Size of the metadata region at the start of the container
+ */
+StagedStorage::StagedStorage(ContainerStorage &base, uint64_t metadataSize) : Base(base)
+{
+    Metadata.resize(std::min(metadataSize, base.Size));
+    base.Read(0, Metadata.data(), Metadata.size());
+
+    FilePath = base.FilePath;
+    Mem = base.Mem;
+    Size = base.Size;
+}
+
+/**
+ * @brief Read a range of the container, from the staged metadata where they overlap
+ *
+ * @param offset Offset of the range to read
+ * @param dest Buffer to read the range into
+ * @param size Size of the range to read
+ * @return True on success, false if the range is out of bounds
+ */
+bool StagedStorage::Read(uint64_t offset, std::byte *dest, uint64_t size)
+{
+    uint64_t stagedSize = offset < Metadata.size() ? std::min(size, Metadata.size() - offset) : 0;
+
+    if (stagedSize > 0)
+        std::memcpy(dest, Metadata.data() + offset, stagedSize);
+
+    if (stagedSize == size)
+        return true;
+
+    return Base.Read(offset + stagedSize, dest + stagedSize, size - stagedSize);
+}
+
+/**
+ * @brief Write a range of the container, to the staged metadata where they overlap
+ *
+ * The staged metadata grows up to the size it was allowed to grow to.
+ *
+ * @param offset Offset of the range to write
+ * @param src Bytes to write
+ * @param size Size of the range to write
+ * @return True on success, false if the range is out of bounds
+ */
+bool StagedStorage::Write(uint64_t offset, const std::byte *src, uint64_t size)
+{
+    uint64_t metadataEnd = std::max<uint64_t>(MetadataEnd, Metadata.size());
+
+    if (offset + size > Metadata.size() && offset < metadataEnd)
+        Metadata.resize(std::min(offset + size, metadataEnd));
+
+    uint64_t stagedSize = offset < Metadata.size() ? std::min(size, Metadata.size() - offset) : 0;
+
+    if (stagedSize > 0) {
+        std::memmove(Metadata.data() + offset, src, stagedSize);
+        Modified = true;
+    }
+
+    if (stagedSize == size)
+        return true;
+
+    return Base.Write(offset + stagedSize, src + stagedSize, size - stagedSize);
+}
+
+/**
+ * @brief Let the staged metadata grow up to the given size, growing the underlying storage if needed
+ * @param metadataSize New size of the metadata
+ * @return True on success, false if it's smaller than the staged metadata
+ */
+bool StagedStorage::GrowMetadata(uint64_t metadataSize)
+{
+    if (metadataSize < Metadata.size())
+        return false;
+
+    if (metadataSize > Size && !Grow(metadataSize))
+        return false;
+
+    MetadataEnd = metadataSize;
+    return true;
+}
+
+/**
+ * @brief Grow the underlying storage
+ *
+ * @param newSize New size for the container
+ * @return True on success, false otherwise
+ */
+bool StagedStorage::Grow(uint64_t newSize)
+{
+    bool success = Base.Grow(newSize);
+
+    Mem = Base.Mem;
+    Size = Base.Size;
+
+    return success;
+}
+
+/**
+ * @brief Truncate the underlying storage
+ *
+ * @param newSize New size for the container
+ * @return True on success, false otherwise
+ */
+bool StagedStorage::Truncate(uint64_t newSize)
+{
+    bool success = Base.Truncate(newSize);
+
+    Mem = Base.Mem;
+    Size = Base.Size;
+
+    return success;
+}
+
+/**
+ * @brief Flush the underlying storage, without the staged metadata
+ *
+ * @return True on success, false otherwise
+ */
+bool StagedStorage::Sync()
+{
+    return Base.Sync();
+}
+
+/**
+ * @brief Start reading the given range of the underlying storage in the background
+ *
+ * @param offset Offset of the range to read
+ * @param size Size of the range to read
+ */
+void StagedStorage::Prefetch(uint64_t offset, uint64_t size)
+{
+    Base.Prefetch(offset, size);
+}
\ No newline at end of file
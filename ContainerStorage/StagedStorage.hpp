@@ -0,0 +1,52 @@
+/*
+* This file is part of EternalModLoaderCpp (https://github.com/PowerBall253/EternalModLoaderCpp).
+* Copyright (C) 2021 PowerBall253
+*
+* EternalModLoaderCpp is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* EternalModLoaderCpp is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with EternalModLoaderCpp. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef STAGEDSTORAGE_HPP
+#define STAGEDSTORAGE_HPP
+
+#include <vector>
+
+#include "ContainerStorage/ContainerStorage.hpp"
+
+/**
+ * @brief Container storage keeping changes to the container's metadata aside
+ *
+ * Reads and writes of the metadata region (the start of the container, up to its data section)
+ * go to a private copy, which can grow into the start of the data section,
+ * so the metadata can be written last, once all the payloads are on disk.
+ * Everything else goes straight to the underlying storage.
+ */
+class StagedStorage : public ContainerStorage {
+public:
+    ContainerStorage &Base;
+    std::vector<std::byte> Metadata;
+    uint64_t MetadataEnd = 0;
+    bool Modified = false;
+
+    StagedStorage(ContainerStorage &base, uint64_t metadataSize);
+
+    bool Read(uint64_t offset, std::byte *dest, uint64_t size);
+    bool Write(uint64_t offset, const std::byte *src, uint64_t size);
+    bool GrowMetadata(uint64_t metadataSize);
+    bool Grow(uint64_t newSize);
+    bool Truncate(uint64_t newSize);
+    bool Sync();
+    void Prefetch(uint64_t offset, uint64_t size);
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,138 @@
+/*
+* This file is part of EternalModLoaderCpp (https://github.com/PowerBall253/EternalModLoaderCpp).
+* Copyright (C) 2021 PowerBall253
+*
+* EternalModLoaderCpp is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* EternalModLoaderCpp is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with EternalModLoaderCpp. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <iostream>
+#include <algorithm>
+
+#include "DataSectionAllocator/DataSectionAllocator.hpp"
+
+// Alignment of payloads in the data section, relative to its start
+const int64_t DataAlignment = 0x10;
+
+/**
+ * @brief Sort the given extents and merge the overlapping ones
+ *
+ * @param extents Vector containing the extents to merge
+ * @return Vector containing the sorted, disjoint extents
+ */
+std::vector<DataExtent> MergeExtents(std::vector<DataExtent> extents)
+{
+    std::sort(extents.begin(), extents.end(),
+        [](const DataExtent &extent1, const DataExtent &extent2) { return extent1.Offset < extent2.Offset; });
+
+    std::vector<DataExtent> mergedExtents;
+
+    for (auto &extent : extents) {
+        if (extent.Size <= 0)
+            continue;
+
+        if (!mergedExtents.empty() && extent.Offset <= mergedExtents.back().Offset + mergedExtents.back().Size) {
+            int64_t end = std::max(mergedExtents.back().Offset + mergedExtents.back().Size, extent.Offset + extent.Size);
+            mergedExtents.back().Size = end - mergedExtents.back().Offset;
+            continue;
+        }
+
+        mergedExtents.push_back(extent);
+    }
+
+    return mergedExtents;
+}
+
+/**
+ * @brief Get the regions of the given range not covered by any live extent
+ *
+ * @param liveExtents Vector containing the sorted, disjoint live extents
+ * @param start Start of the range
+ * @param end End of the range
+ * @return Vector containing the holes in the range
+ */
+std::vector<DataExtent> GetHoles(std::vector<DataExtent> &liveExtents, int64_t start, int64_t end)
+{
+    std::vector<DataExtent> holes;
+    int64_t pos = start;
+
+    for (auto &extent : liveExtents) {
+        if (extent.Offset + extent.Size <= pos)
+            continue;
+
+        if (extent.Offset >= end)
+            break;
+
+        if (extent.Offset > pos)
+            holes.push_back(DataExtent(pos, extent.Offset - pos));
+
+        pos = extent.Offset + extent.Size;
+    }
+
+    if (pos < end)
+        holes.push_back(DataExtent(pos, end - pos));
+
+    return holes;
+}
+
+/**
+ * @brief Reset the allocator with the given holes
+ *
+ * @param holes Vector containing the unused regions of the data section
+ * @param alignmentBase Offset allocations are aligned relative to
+ */
+void DataSectionAllocator::Reset(std::vector<DataExtent> holes, int64_t alignmentBase)
+{
+    HolesBySize.clear();
+    AlignmentBase = alignmentBase;
+    ReclaimedBytes = 0;
+    AppendedBytes = 0;
+
+    for (auto &hole : holes)
+        HolesBySize.insert(std::make_pair(hole.Size, hole.Offset));
+}
+
+/**
+ * @brief Allocate space for a payload in the smallest hole that fits it
+ *
+ * @param size Size of the payload
+ * @return Offset of the allocated space, or -1 if no hole is big enough
+ */
+int64_t DataSectionAllocator::Allocate(int64_t size)
+{
+    if (size <= 0)
+        return -1;
+
+    for (auto x = HolesBySize.lower_bound(size); x != HolesBySize.end(); x++) {
+        int64_t holeSize = x->first;
+        int64_t holeOffset = x->second;
+        int64_t offset = holeOffset + (DataAlignment - ((holeOffset - AlignmentBase) % DataAlignment)) % DataAlignment;
+
+        if (offset + size > holeOffset + holeSize)
+            continue;
+
+        HolesBySize.erase(x);
+
+        if (offset - holeOffset >= DataAlignment)
+            HolesBySize.insert(std::make_pair(offset - holeOffset, holeOffset));
+
+        if (holeOffset + holeSize - offset - size >= DataAlignment)
+            HolesBySize.insert(std::make_pair(holeOffset + holeSize - offset - size, offset + size));
+
+        ReclaimedBytes += size;
+
+        return offset;
+    }
+
+    return -1;
+}
\ No newline at end of file
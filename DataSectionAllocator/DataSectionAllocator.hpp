@@ -0,0 +1,66 @@
+/*
+* This file is part of EternalModLoaderCpp (https://github.com/PowerBall253/EternalModLoaderCpp).
+* Copyright (C) 2021 PowerBall253
+*
+* EternalModLoaderCpp is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* EternalModLoaderCpp is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with EternalModLoaderCpp. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef DATASECTIONALLOCATOR_HPP
+#define DATASECTIONALLOCATOR_HPP
+
+#include <vector>
+#include <map>
+
+/**
+ * @brief Container data extent class
+ *
+ */
+class DataExtent {
+public:
+    int64_t Offset = 0;
+    int64_t Size = 0;
+
+    /**
+     * @brief Construct a new DataExtent object
+     *
+     * @param offset Extent's offset in the container
+     * @param size Extent's size
+     */
+    DataExtent(int64_t offset, int64_t size)
+    {
+        Offset = offset;
+        Size = size;
+    }
+};
+
+/**
+ * @brief Best-fit allocator over the unused regions of a container's data section
+ *
+ */
+class DataSectionAllocator {
+public:
+    int64_t ReclaimedBytes = 0;
+    int64_t AppendedBytes = 0;
+
+    void Reset(std::vector<DataExtent> holes, int64_t alignmentBase);
+    int64_t Allocate(int64_t size);
+private:
+    std::multimap<int64_t, int64_t> HolesBySize;
+    int64_t AlignmentBase = 0;
+};
+
+std::vector<DataExtent> MergeExtents(std::vector<DataExtent> extents);
+std::vector<DataExtent> GetHoles(std::vector<DataExtent> &liveExtents, int64_t start, int64_t end);
+
+#endif
\ No newline at end of file
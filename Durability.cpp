@@ -0,0 +1,291 @@
+/*
+* This file is part of EternalModLoaderCpp (https://github.com/PowerBall253/EternalModLoaderCpp).
+* Copyright (C) 2021 PowerBall253
+*
+* EternalModLoaderCpp is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* EternalModLoaderCpp is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with EternalModLoaderCpp. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <iostream>
+#include <chrono>
+#include <set>
+#include <filesystem>
+
+#ifdef __linux__
+#include <sys/stat.h>
+#endif
+
+#include "EternalModLoader.hpp"
+
+namespace chrono = std::chrono;
+
+/**
+ * @brief Flush the container's changes to disk, adding the time taken to ContainerSyncTime
+ *
+ * @param storage ContainerStorage object containing the container to flush
+ * @return True on success, false otherwise
+ */
+bool SyncContainer(ContainerStorage &storage)
+{
+    chrono::steady_clock::time_point syncBegin = chrono::steady_clock::now();
+    bool success = storage.Sync();
+    chrono::steady_clock::time_point syncEnd = chrono::steady_clock::now();
+
+    ContainerSyncTime += chrono::duration_cast<chrono::microseconds>(syncEnd - syncBegin).count();
+
+    return success;
+}
+
+/**
+ * @brief Flush the given file's changes to disk
+ *
+ * @param path Path to the file to flush
+ * @return True on success, false otherwise
+ */
+bool SyncFile(const std::string &path)
+{
+#ifdef _WIN32
+    HANDLE fileHandle = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+    if (fileHandle == INVALID_HANDLE_VALUE)
+        return false;
+
+    bool success = FlushFileBuffers(fileHandle);
+    CloseHandle(fileHandle);
+#else
+    int fileDescriptor = open(path.c_str(), O_RDONLY);
+
+    if (fileDescriptor == -1)
+        return false;
+
+    bool success = fsync(fileDescriptor) == 0;
+    close(fileDescriptor);
+#endif
+
+    return success;
+}
+
+/**
+ * @brief Flush the given directory's entries to disk, after creating or renaming files in it
+ *
+ * @param path Path to the directory to flush
+ * @return True on success, false otherwise
+ */
+bool SyncDirectory(const std::string &path)
+{
+#ifdef _WIN32
+    // Directory entries are flushed with the files on Windows
+    return true;
+#else
+    int directoryFileDescriptor = open(path.c_str(), O_RDONLY);
+
+    if (directoryFileDescriptor == -1)
+        return false;
+
+    bool success = fsync(directoryFileDescriptor) == 0;
+    close(directoryFileDescriptor);
+
+    return success;
+#endif
+}
+
+/**
+ * @brief Flush all the files written while loading mods to disk at once
+ *
+ * On Linux, each filesystem holding the written files is synced with a single syncfs call.
+ * Elsewhere, the files are flushed one by one.
+ *
+ * @return True on success, false otherwise
+ */
+bool GroupSync()
+{
+    std::vector<std::string> paths;
+
+    for (auto &resourceContainer : ResourceContainerList) {
+        if (!resourceContainer.Path.empty())
+            paths.push_back(resourceContainer.Path);
+    }
+
+    for (auto &soundContainer : SoundContainerList) {
+        if (!soundContainer.Path.empty())
+            paths.push_back(soundContainer.Path);
+    }
+
+    if (PackageMapSpecInfo.WasPackageMapSpecModified && !PackageMapSpecInfo.PackageMapSpecPath.empty())
+        paths.push_back(PackageMapSpecInfo.PackageMapSpecPath);
+
+    for (auto &journal : PendingJournals) {
+        if (std::filesystem::exists(journal.GetPath()))
+            paths.push_back(journal.GetPath());
+    }
+
+    bool success = true;
+
+#ifdef __linux__
+    std::set<dev_t> syncedDevices;
+
+    for (auto &path : paths) {
+        struct stat fileInfo;
+
+        if (stat(path.c_str(), &fileInfo) == -1 || syncedDevices.count(fileInfo.st_dev) != 0)
+            continue;
+
+        int fileDescriptor = open(path.c_str(), O_RDONLY);
+
+        if (fileDescriptor == -1) {
+            success = false;
+            continue;
+        }
+
+        success = syncfs(fileDescriptor) == 0 && success;
+        close(fileDescriptor);
+
+        syncedDevices.insert(fileInfo.st_dev);
+    }
+#else
+    for (auto &path : paths)
+        success = SyncFile(path) && success;
+#endif
+
+    return success;
+}
+
+/**
+ * @brief Check if container metadata changes should go through a journal
+ *
+ * The slow and in-place modes overwrite data the current metadata points to, so they can't be made crash-consistent this way.
+ *
+ * @return True if journals should be used, false otherwise
+ */
+bool UseContainerJournals()
+{
+    return Durability != DurabilityMode::None && !SlowMode && !InPlaceOverwrite && !MemoryOnly;
+}
+
+/**
+ * @brief Write the container's metadata changes through its journal, once its payloads are on disk
+ *
+ * In container mode, the journal is saved, applied and removed right away, adding the time taken to ContainerSyncTime.
+ * In group mode, it's queued to be committed with all the others at the end.
+ *
+ * @param journal ContainerJournal object containing the changes
+ * @return True on success, false otherwise
+ */
+bool CommitContainerJournal(ContainerJournal &journal)
+{
+    if (Durability == DurabilityMode::Group) {
+        mtx.lock();
+        PendingJournals.push_back(std::move(journal));
+        mtx.unlock();
+        return true;
+    }
+
+    chrono::steady_clock::time_point commitBegin = chrono::steady_clock::now();
+    bool success = journal.Save(true) && journal.Apply(true) && journal.Remove();
+    chrono::steady_clock::time_point commitEnd = chrono::steady_clock::now();
+
+    ContainerSyncTime += chrono::duration_cast<chrono::microseconds>(commitEnd - commitBegin).count();
+
+    return success;
+}
+
+/**
+ * @brief Commit the journals queued in group mode
+ *
+ * All the journals are saved and flushed at once, then applied and flushed at once, then removed.
+ *
+ * @return True on success, false otherwise
+ */
+bool CommitPendingJournals()
+{
+    bool success = true;
+
+    for (auto &journal : PendingJournals)
+        success = journal.Save(false) && success;
+
+    // Containers whose journal couldn't be saved are left untouched
+    if (!success || !GroupSync())
+        return false;
+
+    for (auto &journal : PendingJournals)
+        success = journal.Apply(false) && success;
+
+    if (!GroupSync() || !success)
+        return false;
+
+    for (auto &journal : PendingJournals)
+        success = journal.Remove() && success;
+
+    PendingJournals.clear();
+
+    return success;
+}
+
+/**
+ * @brief Flush all changes to disk at once, then commit the journals queued in group mode
+ *
+ * Containers whose journal couldn't be committed are marked as not committed.
+ */
+void GroupCommit()
+{
+    if (!GroupSync())
+        std::cout << RED << "ERROR: " << RESET << "Failed to flush the changes to disk" << std::endl;
+
+    if (!PendingJournals.empty() && !CommitPendingJournals()) {
+        std::cout << RED << "ERROR: " << RESET << "Failed to commit the changes to the containers" << std::endl;
+
+        for (auto &resourceContainer : ResourceContainerList)
+            resourceContainer.WasCommitted = false;
+
+        for (auto &soundContainer : SoundContainerList)
+            soundContainer.WasCommitted = false;
+    }
+}
+
+/**
+ * @brief Finish or discard the container changes left behind by an interrupted run
+ *
+ * Complete journals are applied again, rolling their container forward.
+ * Incomplete ones are deleted: their container's metadata was never touched, so it's still in its previous state.
+ */
+void RecoverContainerJournals()
+{
+    std::vector<std::string> journalPaths;
+
+    try {
+        for (auto &file : std::filesystem::recursive_directory_iterator(BasePath)) {
+            if (file.is_regular_file() && file.path().extension() == ".journal")
+                journalPaths.push_back(file.path().string());
+        }
+    }
+    catch (...) {
+        return;
+    }
+
+    for (auto &journalPath : journalPaths) {
+        ContainerJournal journal;
+
+        if (journal.Load(journalPath)) {
+            if (journal.Apply(true) && journal.Remove()) {
+                std::cout << YELLOW << "INFO: Finished the changes to " << journal.ContainerPath << " left by an interrupted run." << RESET << std::endl;
+            }
+            else {
+                std::cout << RED << "ERROR: " << RESET << "Failed to finish the changes to " << journal.ContainerPath
+                    << " left by an interrupted run, restore the game files before loading mods again." << std::endl;
+            }
+        }
+        else if (journal.Remove()) {
+            std::cout << YELLOW << "INFO: Discarded the incomplete changes to " << journal.ContainerPath << " left by an interrupted run." << RESET << std::endl;
+        }
+    }
+}
\ No newline at end of file
@@ -18,40 +18,13 @@
 
 #include <iostream>
 #include <filesystem>
-#include <algorithm>
 #include <cstring>
-#include <cstdlib>
-#include <climits>
 #include <chrono>
-#include <thread>
-#include <sstream>
 
-#include "EternalModLoader.hpp"
+#include "ModLoader/ModLoader.hpp"
 
 namespace chrono = std::chrono;
 
-const int32_t Version = 9;
-const std::string ResourceDataFileName = "rs_data";
-
-char Separator;
-std::string BasePath;
-bool Verbose = false;
-bool SlowMode = false;
-bool CompressTextures = false;
-bool MultiThreading = true;
-
-std::vector<ResourceContainer> ResourceContainerList;
-std::vector<SoundContainer> SoundContainerList;
-std::map<uint64_t, ResourceDataEntry> ResourceDataMap;
-
-std::vector<std::stringstream> stringStreams;
-int32_t streamIndex = 0;
-
-std::byte *Buffer = NULL;
-int64_t BufferSize = -1;
-
-std::mutex mtx;
-
 /**
  * @brief Program's main entrypoint
  * 
@@ -68,8 +41,6 @@ int main(int argc, char **argv)
     char coutBuf[8192];
     std::cout.rdbuf()->pubsetbuf(coutBuf, 8192);
 
-    Separator = std::filesystem::path::preferred_separator;
-
     // Enable colored output
     EnableColors();
 
@@ -77,14 +48,29 @@ int main(int argc, char **argv)
     if (argc == 1) {
         std::cout << "EternalModLoaderCpp by PowerBall253, based on EternalModLoader by proteh\n\n";
         std::cout << "Loads DOOM Eternal mods from ZIPs or loose files in 'Mods' folder into the .resources files in the specified directory.\n\n";
-        std::cout << "USAGE: " << argv[0] << " <game path | --version> [OPTIONS]\n";
-        std::cout << "\t--version - Prints the version number of the mod loader and exits with exit code same as the version number.\n\n";
+        std::cout << "USAGE: " << argv[0] << " <game path | --version | --batch <job file>> [OPTIONS]\n";
+        std::cout << "\t--version - Prints the version number of the mod loader and exits with exit code same as the version number.\n";
+        std::cout << "\t--batch <job file> - Load mods into all the game directories listed in the job file, one per line,"
+            " optionally followed by a tab and the Mods folder to use instead of the game directory's own.\n\n";
         std::cout << "OPTIONS:\n";
         std::cout << "\t--list-res - List the .resources files that will be modified and exit.\n";
         std::cout << "\t--verbose - Print more information during the mod loading process.\n";
         std::cout << "\t--slow - Slow mod loading mode that produces lighter files.\n";
         std::cout << "\t--compress-textures - Compress texture files during the mod loading process.\n";
-        std::cout << "\t--disable-multithreading - Disables multi-threaded mod loading." << std::endl;
+        std::cout << "\t--disable-multithreading - Disables multi-threaded mod loading.\n";
+        std::cout << "\t--in-place - Overwrite files in place when the new data fits, instead of appending it.\n";
+        std::cout << "\t--streaming-stores - Write very large mod files without going through the CPU caches.\n";
+        std::cout << "\t--write-backend <mmap|pwrite|io_uring> - How to write mod files to the containers (default: mmap). Linux only, except mmap.\n";
+        std::cout << "\t--direct-io - Write large mod files bypassing the page cache, with the pwrite and io_uring backends.\n";
+        std::cout << "\t--durability <none|container|group> - Don't flush changes to disk (default), flush each container after loading its mods, or flush everything at once at the end. Container metadata is written last, through a journal, so an interrupted run can be recovered from (not in slow or in-place mode).\n";
+        std::cout << "\t--memory-only - Load the mods into in-memory copies of the containers and discard them, to profile without disk writes.\n";
+        std::cout << "\t--plan - Report the work to do in each container and its predicted time, without modifying any, and exit.\n";
+        std::cout << "\t--watch - Keep running, and load the mods again into the containers they changed in whenever the 'Mods' folder changes. Linux only.\n";
+        std::cout << "\t--force - Load mods into all containers, even those whose mods haven't changed since the last run.\n";
+        std::cout << "\t--compact - Remove the data no longer referenced by the game from all containers and exit.\n";
+        std::cout << "\t--punch-holes - Release the disk space of the data no longer referenced by the game without rewriting the containers, and exit.\n";
+        std::cout << "\t--restore - Restore all containers to their state before mods were first loaded into them, and exit.\n";
+        std::cout << "\t--compact-memory <MiB> - Memory to use for the copy buffers while compacting (default: 64)." << std::endl;
         return 1;
     }
 
@@ -94,244 +80,236 @@ int main(int argc, char **argv)
         return Version;
     }
 
-    BasePath = std::string(argv[1]) + Separator + "base" + Separator;
+    // Load mods into the game directories listed in a job file
+    bool batchMode = !strcmp(argv[1], "--batch");
 
-    if (!std::filesystem::exists(BasePath)) {
+    if (batchMode && argc < 3) {
+        std::cout << RED << "ERROR: " << RESET << "No job file given!" << std::endl;
+        return 1;
+    }
+
+    if (!batchMode && !std::filesystem::exists(std::string(argv[1]) + Separator + "base" + Separator)) {
         std::cout << RED << "ERROR: " << RESET << "Game directory does not exist!" << std::endl;
         return 1;
     }
 
+    ModLoaderOptions options;
     bool listResources = false;
+    bool planOnly = false;
+    bool compactContainers = false;
+    bool punchHoles = false;
+    bool restoreContainers = false;
+    bool watchMods = false;
+    int64_t compactMemoryBudget = 64;
 
     // Check arguments passed to program
     if (argc > 2) {
-        for (int32_t i = 2; i < argc; i++) {
+        for (int32_t i = batchMode ? 3 : 2; i < argc; i++) {
             if (!strcmp(argv[i], "--list-res")) {
                 listResources = true;
             }
             else if (!strcmp(argv[i], "--verbose")) {
-                Verbose = true;
+                options.Verbose = true;
                 std::cout << YELLOW << "INFO: Verbose logging is enabled." << RESET << std::endl;
             }
             else if (!strcmp(argv[i], "--slow")) {
-                SlowMode = true;
+                options.SlowMode = true;
                 std::cout << YELLOW << "INFO: Slow mod loading mode is enabled." << RESET << std::endl;
             }
             else if (!strcmp(argv[i], "--compress-textures")) {
-                CompressTextures = true;
+                options.CompressTextures = true;
                 std::cout << YELLOW << "INFO: Texture compression is enabled." << RESET << std::endl;
             }
             else if (!strcmp(argv[i], "--disable-multithreading")) {
-                MultiThreading = false;
+                options.MultiThreading = false;
                 std::cout << YELLOW << "INFO: Multi-threading is disabled." << RESET << std::endl;
             }
-            else {
-                std::cout << RED << "ERROR: " << RESET << "Unknown argument: " << argv[i] << std::endl;
-                return 1;
+            else if (!strcmp(argv[i], "--in-place")) {
+                options.InPlaceOverwrite = true;
+                std::cout << YELLOW << "INFO: In-place overwrites are enabled." << RESET << std::endl;
             }
-        }
-    }
-
-    // Reserve enough space for all resource/sound containers
-    ResourceContainerList.reserve(80);
-    SoundContainerList.reserve(40);
-
-    // Parse rs_data
-    if (!listResources) {
-        std::string resourceDataFilePath = BasePath + ResourceDataFileName;
+            else if (!strcmp(argv[i], "--streaming-stores")) {
+                options.StreamingStores = true;
+                std::cout << YELLOW << "INFO: Streaming stores are enabled." << RESET << std::endl;
+            }
+            else if (!strcmp(argv[i], "--write-backend") && i + 1 < argc) {
+                i++;
 
-        if (std::filesystem::exists(resourceDataFilePath)) {
-            try {
-                ResourceDataMap = ParseResourceData(resourceDataFilePath);
+                if (!strcmp(argv[i], "mmap")) {
+                    options.PayloadWriteBackend = WriteBackend::Mmap;
+                }
+#ifdef __linux__
+                else if (!strcmp(argv[i], "pwrite")) {
+                    options.PayloadWriteBackend = WriteBackend::Pwrite;
+                }
+                else if (!strcmp(argv[i], "io_uring")) {
+                    options.PayloadWriteBackend = WriteBackend::IoUring;
+                }
+#endif
+                else {
+                    std::cout << RED << "ERROR: " << RESET << "Unsupported write backend: " << argv[i] << std::endl;
+                    return 1;
+                }
+            }
+            else if (!strcmp(argv[i], "--direct-io")) {
+                options.DirectIo = true;
+            }
+            else if (!strcmp(argv[i], "--durability") && i + 1 < argc) {
+                i++;
 
-                if (ResourceDataMap.empty())
-                    throw std::exception();
+                if (!strcmp(argv[i], "none")) {
+                    options.Durability = DurabilityMode::None;
+                }
+                else if (!strcmp(argv[i], "container")) {
+                    options.Durability = DurabilityMode::Container;
+                }
+                else if (!strcmp(argv[i], "group")) {
+                    options.Durability = DurabilityMode::Group;
+                }
+                else {
+                    std::cout << RED << "ERROR: " << RESET << "Unknown durability mode: " << argv[i] << std::endl;
+                    return 1;
+                }
             }
-            catch (...) {
-                std::cout << RED << "ERROR: " << RESET << "Failed to parse " << ResourceDataFileName << '\n';
+            else if (!strcmp(argv[i], "--memory-only")) {
+                options.MemoryOnly = true;
+                std::cout << YELLOW << "INFO: Memory-only mode is enabled, no changes will be written to disk." << RESET << std::endl;
             }
-        }
-        else {
-            if (Verbose) {
-                std::cout << RED << "WARNING: " << RESET << ResourceDataFileName << " was not found! There will be issues when adding existing new assets to containers..." << '\n';
+            else if (!strcmp(argv[i], "--plan")) {
+                planOnly = true;
+                std::cout << YELLOW << "INFO: Plan mode is enabled, no container will be modified." << RESET << std::endl;
             }
-        }
-    }
-
-    // Find mods
-    std::vector<std::string> zippedMods;
-    std::vector<std::string> unzippedMods;
-    std::vector<std::string> notFoundContainers;
-
-    for (const auto &file : std::filesystem::recursive_directory_iterator(std::string(argv[1]) + Separator + "Mods")) {
-        if (!std::filesystem::is_regular_file(file.path()))
-            continue;
+            else if (!strcmp(argv[i], "--compact")) {
+                compactContainers = true;
+            }
+            else if (!strcmp(argv[i], "--punch-holes")) {
+                punchHoles = true;
+            }
+            else if (!strcmp(argv[i], "--watch")) {
+                watchMods = true;
+            }
+            else if (!strcmp(argv[i], "--force")) {
+                options.Incremental = false;
+            }
+            else if (!strcmp(argv[i], "--restore")) {
+                restoreContainers = true;
+            }
+            else if (!strcmp(argv[i], "--compact-memory") && i + 1 < argc) {
+                try {
+                    compactMemoryBudget = std::stoll(argv[++i]);
 
-        if (file.path().extension() == ".zip" && file.path() == std::string(argv[1]) + Separator + "Mods" + Separator + file.path().filename().string()) {
-            zippedMods.push_back(file.path().string());
-        }
-        else if (file.path().extension() != ".zip") {
-            unzippedMods.push_back(file.path().string());
+                    if (compactMemoryBudget <= 0)
+                        throw std::exception();
+                }
+                catch (...) {
+                    std::cout << RED << "ERROR: " << RESET << "Invalid compaction memory budget: " << argv[i] << std::endl;
+                    return 1;
+                }
+            }
+            else {
+                std::cout << RED << "ERROR: " << RESET << "Unknown argument: " << argv[i] << std::endl;
+                return 1;
+            }
         }
     }
 
-    // Get the resource container paths
-    GetResourceContainerPathList();
+    if (planOnly && options.SlowMode) {
+        std::cout << RED << "ERROR: " << RESET << "Plan mode can't be used with slow mode." << std::endl;
+        return 1;
+    }
 
-    // Load zipped mods
-    chrono::steady_clock::time_point zippedModsBegin = chrono::steady_clock::now();
+    if (watchMods && (listResources || planOnly || options.SlowMode || options.MemoryOnly)) {
+        std::cout << RED << "ERROR: " << RESET << "Watch mode can't be used with --list-res, --plan, --slow or --memory-only." << std::endl;
+        return 1;
+    }
 
-    if (MultiThreading) {
-        std::vector<std::thread> zippedModLoadingThreads;
-        zippedModLoadingThreads.reserve(zippedMods.size());
+    if (batchMode && (listResources || planOnly || watchMods || compactContainers || punchHoles || restoreContainers)) {
+        std::cout << RED << "ERROR: " << RESET << "Batch mode can't be used with --list-res, --plan, --watch, --compact, --punch-holes or --restore." << std::endl;
+        return 1;
+    }
 
-        for (const auto &zippedMod : zippedMods)
-            zippedModLoadingThreads.push_back(std::thread(LoadZippedMod, zippedMod, listResources, std::ref(notFoundContainers)));
+#ifdef __linux__
+    if (options.PayloadWriteBackend == WriteBackend::IoUring && !IoUring::IsAvailable()) {
+        std::cout << RED << "WARNING: " << RESET << "io_uring is not available, falling back to pwrite." << std::endl;
+        options.PayloadWriteBackend = WriteBackend::Pwrite;
+    }
+#endif
 
-        for (auto &thread : zippedModLoadingThreads)
-            thread.join();
+    if (options.PayloadWriteBackend != WriteBackend::Mmap) {
+        std::cout << YELLOW << "INFO: Writing mod files with " << (options.PayloadWriteBackend == WriteBackend::IoUring ? "io_uring" : "pwrite")
+            << (options.DirectIo ? " and direct I/O" : "") << "." << RESET << std::endl;
     }
-    else {
-        for (const auto &zippedMod : zippedMods)
-            LoadZippedMod(zippedMod, listResources, notFoundContainers);
+    else if (options.DirectIo) {
+        std::cout << RED << "WARNING: " << RESET << "Direct I/O is only used by the pwrite and io_uring write backends." << std::endl;
     }
 
-    chrono::steady_clock::time_point zippedModsEnd = chrono::steady_clock::now();
-    double zippedModsTime = chrono::duration_cast<chrono::microseconds>(zippedModsEnd - zippedModsBegin).count() / 1000000.0;
-
-    // Load unzipped mods
-    chrono::steady_clock::time_point unzippedModsBegin = chrono::steady_clock::now();
-
-    std::atomic<int32_t> unzippedModCount = 0;
-    Mod globalLooseMod;
-    globalLooseMod.LoadPriority = INT_MIN;
+    ModLoader &modLoader = ModLoader::Get();
 
-    if (MultiThreading) {
-        std::vector<std::thread> unzippedModLoadingThreads;
-        unzippedModLoadingThreads.reserve(unzippedMods.size());
+    if (batchMode)
+        return modLoader.RunBatch(argv[2], options);
 
-        for (const auto &unzippedMod : unzippedMods)
-            unzippedModLoadingThreads.push_back(std::thread(LoadUnzippedMod, unzippedMod, listResources, std::ref(globalLooseMod), std::ref(unzippedModCount), std::ref(notFoundContainers)));
+    modLoader.Open(argv[1], options);
 
-        for (auto &thread : unzippedModLoadingThreads)
-            thread.join();
-        }
-    else {
-        for (const auto &unzippedMod : unzippedMods)
-            LoadUnzippedMod(unzippedMod, listResources, globalLooseMod, unzippedModCount, notFoundContainers);
-    }
+    // Restore containers to their original state, and exit
+    if (restoreContainers) {
+        chrono::steady_clock::time_point restoreBegin = chrono::steady_clock::now();
 
-    if (unzippedModCount > 0 && !listResources)
-        std::cout << "Found " << BLUE << unzippedModCount << " file(s) " << RESET << "in " << YELLOW << "'Mods' " << RESET << "folder..." << '\n';
+        modLoader.Restore();
 
-    chrono::steady_clock::time_point unzippedModsEnd = chrono::steady_clock::now();
-    double unzippedModsTime = chrono::duration_cast<chrono::microseconds>(unzippedModsEnd - unzippedModsBegin).count() / 1000000.0;
+        chrono::steady_clock::time_point restoreEnd = chrono::steady_clock::now();
+        double restoreTime = chrono::duration_cast<chrono::microseconds>(restoreEnd - restoreBegin).count() / 1000000.0;
 
-    // List resources to be modified and exit
-    if (listResources) {
-        for (auto &resourceContainer : ResourceContainerList) {
-            if (resourceContainer.Path.empty())
-                continue;
+        std::cout << GREEN << "Total time taken: " << restoreTime << " seconds." << RESET << std::endl;
+        return 0;
+    }
 
-            bool shouldListResource = false;
+    // Compact containers or punch holes in them, and exit
+    if (compactContainers || punchHoles) {
+        chrono::steady_clock::time_point compactBegin = chrono::steady_clock::now();
 
-            for (auto &modFile : resourceContainer.ModFileList) {
-                if (!modFile.IsAssetsInfoJson) {
-                    shouldListResource = true;
-                    break;
-                }
+        modLoader.Compact(compactMemoryBudget * 1024 * 1024, punchHoles);
 
-                if (!modFile.AssetsInfo.has_value())
-                    continue;
+        chrono::steady_clock::time_point compactEnd = chrono::steady_clock::now();
+        double compactTime = chrono::duration_cast<chrono::microseconds>(compactEnd - compactBegin).count() / 1000000.0;
 
-                if (modFile.AssetsInfo.value().Assets.empty()
-                    && modFile.AssetsInfo.value().Layers.empty()
-                    && modFile.AssetsInfo.value().Maps.empty())
-                        continue;
+        std::cout << GREEN << "Total time taken: " << compactTime << " seconds." << RESET << std::endl;
+        return 0;
+    }
 
-                shouldListResource = true;
-                break;
-            }
+    // Find the mods, and load the mod files of the containers whose mods changed
+    DiscoveryMode discoveryMode = listResources ? DiscoveryMode::List : planOnly ? DiscoveryMode::Plan : DiscoveryMode::Load;
 
-            if (shouldListResource)
-                std::cout << resourceContainer.Path << '\n';
-        }
+    if (!modLoader.Discover(discoveryMode))
+        return 1;
 
-        for (auto &soundContainer : SoundContainerList) {
-            if (soundContainer.Path.empty())
-                continue;
+    ModLoaderTimings &timings = modLoader.Timings;
 
-            std::cout << soundContainer.Path << '\n';
-        }
+    // List resources to be modified and exit
+    if (listResources) {
+        for (auto &containerPath : modLoader.GetContainersToModify())
+            std::cout << containerPath << '\n';
 
         std::cout.flush();
         return 0;
     }
 
-    // Display not found containers
-    for (auto &container : notFoundContainers)
-        std::cout << RED << "WARNING: " << YELLOW << container << RESET << " was not found! Skipping..." << std::endl;
-
-    std::cout.flush();
+    // Display the plan and exit
+    if (planOnly) {
+        modLoader.Plan();
 
-    // Set buffer for file i/o
-    try {
-        SetOptimalBufferSize(std::filesystem::absolute(".").root_path().string());
-    }
-    catch (...) {
-        std::cout << RED << "ERROR: " << RESET << "Error while determining the optimal buffer size, using 4096 as the default." << std::endl;
-
-        if (Buffer != NULL)
-            delete[] Buffer;
-
-        Buffer = new std::byte[4096];
+        std::cout << GREEN << "Total time taken: " << timings.Startup + timings.ZippedMods + timings.UnzippedMods + timings.ModLoading << " seconds." << RESET << std::endl;
+        return 0;
     }
 
     // Load mods
-    chrono::steady_clock::time_point modLoadingBegin = chrono::steady_clock::now();
-
-    stringStreams.resize(ResourceContainerList.size() + SoundContainerList.size());
-
-    if (MultiThreading) {
-        std::vector<std::thread> modLoadingThreads;
-        modLoadingThreads.reserve(ResourceContainerList.size() + SoundContainerList.size());
-
-        for (auto &resourceContainer : ResourceContainerList)
-            modLoadingThreads.push_back(std::thread(LoadResourceMods, std::ref(resourceContainer)));
-
-        for (auto &soundContainer : SoundContainerList)
-            modLoadingThreads.push_back(std::thread(LoadSoundMods, std::ref(soundContainer)));
-
-        for (int32_t i = 0; i < modLoadingThreads.size(); i++) {
-            modLoadingThreads[i].join();
-            std::cout << stringStreams[i].rdbuf();
-        }
-    }
-    else {
-        for (auto &resourceContainer : ResourceContainerList)
-            LoadResourceMods(resourceContainer);
-
-        for (auto &soundContainer : SoundContainerList)
-            LoadSoundMods(soundContainer);
-    }
-
-    // Modify PackageMapSpec JSON file in disk
-    PackageMapSpecInfo.ModifyPackageMapSpec();
-
-    // Delete buffer
-    delete[] Buffer;
+    modLoader.Apply();
 
     // Display metrics
-    chrono::steady_clock::time_point modLoadingEnd = chrono::steady_clock::now();
-    double modLoadingTime = chrono::duration_cast<chrono::microseconds>(modLoadingEnd - modLoadingBegin).count() / 1000000.0;
-
-    if (Verbose) {
-        std::cout << GREEN << "Zipped mods loaded in " << zippedModsTime << " seconds.\n";
-        std::cout << "Unzipped mods loaded in " << unzippedModsTime << " seconds.\n";
-        std::cout << "Injection finished in " << modLoadingTime << " seconds.\n";
-    }
+    modLoader.PrintTimings();
 
-    std::cout << GREEN << "Total time taken: " << zippedModsTime + unzippedModsTime + modLoadingTime << " seconds." << RESET << std::endl;
+    // Keep the indexes in memory, and load the mods again whenever they change
+    if (watchMods)
+        return modLoader.Watch();
 
     // Exit the program with error code 0
     return 0;
@@ -21,6 +21,7 @@
 
 #include <vector>
 #include <map>
+#include <set>
 #include <optional>
 #include <mutex>
 #include <atomic>
@@ -37,6 +38,14 @@
 #include "AssetsInfo/AssetsInfo.hpp"
 #include "BlangFile/BlangFile.hpp"
 #include "Colors/Colors.hpp"
+#include "CompressionCache/CompressionCache.hpp"
+#include "ContainerJournal/ContainerJournal.hpp"
+#include "ContainerSnapshot/ContainerSnapshot.hpp"
+#include "ContainerStorage/ContainerStorage.hpp"
+#include "ContainerStorage/InMemoryStorage.hpp"
+#include "ContainerStorage/StagedStorage.hpp"
+#include "DataSectionAllocator/DataSectionAllocator.hpp"
+#include "IoUring/IoUring.hpp"
 #include "MapResourcesFile/MapResourcesFile.hpp"
 #include "MemoryMappedFile/MemoryMappedFile.hpp"
 #include "Mod/Mod.hpp"
@@ -45,6 +54,17 @@
 #include "PackageMapSpec/PackageMapSpecInfo.hpp"
 #include "ResourceData/ResourceData.hpp"
 #include "Utils/Utils.hpp"
+#include "WriteQueue/WriteQueue.hpp"
+
+/**
+ * @brief When the changes made while loading mods are flushed to disk
+ * 
+ */
+enum class DurabilityMode {
+    None,
+    Container,
+    Group
+};
 
 /**
  * @brief ResourceModFile class
@@ -67,6 +87,8 @@ public:
     std::optional<std::byte> SpecialByte1 = std::nullopt;
     std::optional<std::byte> SpecialByte2 = std::nullopt;
     std::optional<std::byte> SpecialByte3 = std::nullopt;
+    std::optional<FileRange> FileSource = std::nullopt;
+    std::optional<uint64_t> FileSourceUncompressedSize = std::nullopt;
 
     /**
      * @brief Construct a new ResourceModFile object
@@ -79,6 +101,16 @@ public:
         Parent = parent;
         Name = name;
     }
+
+    /**
+     * @brief Get the size of the mod file's data, whether it's loaded or left on disk
+     * 
+     * @return Size of the mod file's data
+     */
+    uint64_t GetSize()
+    {
+        return FileSource.has_value() ? FileSource.value().Size : FileBytes.size();
+    }
 };
 
 /**
@@ -159,6 +191,24 @@ public:
     ResourceChunk() {}
 };
 
+/**
+ * @brief Work done, or to be done, to load the mods into a container
+ *
+ */
+class ContainerWork {
+public:
+    int32_t ReplacedFiles = 0;
+    int32_t AddedFiles = 0;
+    int32_t UnchangedFiles = 0;
+    int64_t WrittenBytes = 0;
+    int64_t AppendedBytes = 0;
+    int64_t ReclaimedBytes = 0;
+    int64_t MovedBytes = 0;
+    int64_t CompressedBytes = 0;
+    int32_t BlangEdits = 0;
+    int32_t MapResourcesEdits = 0;
+};
+
 /**
  * @brief ResourceContainer class
  * 
@@ -184,6 +234,14 @@ public:
     std::vector<ResourceChunk> ChunkList;
     std::vector<ResourceModFile> ModFileList;
     std::vector<ResourceModFile> NewModFileList;
+    std::vector<DataExtent> LiveExtents;
+    std::map<int64_t, int32_t> ChunkDataReferences;
+    int64_t OriginalDataEnd = 0;
+    int32_t UnchangedFileCount = 0;
+    bool WasCommitted = false;
+    ContainerWork Work;
+    class DataSectionAllocator DataSectionAllocator;
+    class WriteQueue WriteQueue;
 
     /**
      * @brief Construct a new ResourceContainer object
@@ -262,6 +320,11 @@ public:
     std::string Path;
     std::vector<SoundModFile> ModFileList;
     std::vector<SoundEntry> SoundEntries;
+    std::vector<DataExtent> LiveExtents;
+    int64_t MetadataSize = 0;
+    bool WasCommitted = false;
+    ContainerWork Work;
+    class WriteQueue WriteQueue;
 
     /**
      * @brief Construct a new SoundContainer object
@@ -313,19 +376,57 @@ inline bool operator==(ResourceChunk& chunk1, const ResourceChunk& chunk2)
     return chunk1.ResourceName.FullFileName == chunk2.ResourceName.FullFileName;
 }
 
+/**
+ * @brief Check if a mod file is applied before another one
+ *
+ * Mod files are applied from the highest load priority value to the lowest, so the lowest one wins,
+ * then by mod name and by path in the container, so the order never depends on the order mods were found in.
+ *
+ * @param modFile1 First ResourceModFile or SoundModFile object
+ * @param modFile2 Second ResourceModFile or SoundModFile object
+ * @return True if the first mod file is applied before the second one, false otherwise
+ */
+template <class ModFile>
+inline bool IsAppliedBefore(const ModFile &modFile1, const ModFile &modFile2)
+{
+    if (modFile1.Parent.LoadPriority != modFile2.Parent.LoadPriority)
+        return modFile1.Parent.LoadPriority > modFile2.Parent.LoadPriority;
+
+    if (modFile1.Parent.Name != modFile2.Parent.Name)
+        return modFile1.Parent.Name < modFile2.Parent.Name;
+
+    return modFile1.Name < modFile2.Name;
+}
+
 // Global variables
 extern const int32_t Version;
+extern const std::string ResourceDataFileName;
 
 extern char Separator;
 extern std::string BasePath;
+extern std::string ModsPath;
 extern bool Verbose;
 extern bool SlowMode;
 extern bool CompressTextures;
 extern bool MultiThreading;
+extern bool StreamingStores;
+extern bool InPlaceOverwrite;
+extern WriteBackend PayloadWriteBackend;
+extern bool DirectIo;
+extern bool MemoryOnly;
+extern DurabilityMode Durability;
+extern bool Incremental;
+extern bool PlanOnly;
+extern bool ShareZipEntries;
+extern std::atomic<int64_t> ContainerSyncTime;
+extern std::vector<ContainerJournal> PendingJournals;
 
 extern std::vector<ResourceContainer> ResourceContainerList;
 extern std::vector<SoundContainer> SoundContainerList;
-extern std::map<uint64_t, ResourceDataEntry> ResourceDataMap;
+extern ResourceDataIndex ResourceDataMap;
+extern std::map<std::string, std::string> ContainerManifests;
+extern std::set<std::string> UpToDateContainers;
+extern class CompressionCache TextureCompressionCache;
 extern const std::vector<std::string> SupportedFileFormats;
 
 extern std::vector<std::stringstream> stringStreams;
@@ -340,12 +441,20 @@ extern class PackageMapSpecInfo PackageMapSpecInfo;
 
 // Resource mods
 void LoadResourceMods(ResourceContainer &resourceContainer);
-void ReadResource(MemoryMappedFile &memoryMappedFile, ResourceContainer &resourceContainer);
-void ReadChunkInfo(MemoryMappedFile &memoryMappedFile, ResourceContainer &resourceContainer);
-void ReplaceChunks(MemoryMappedFile &memoryMappedFile, ResourceContainer &resourceContainer, std::stringstream &os);
-void AddChunks(MemoryMappedFile &memoryMappedFile, ResourceContainer &resourceContainer, std::stringstream &os);
+void LoadContainerMods(void (*loadResourceMods)(ResourceContainer&), void (*loadSoundMods)(SoundContainer&));
+void LoadResourceData();
+void ResetLoadedMods();
+void LoadZippedMods(std::vector<std::string> &zippedMods, bool listResources, std::vector<std::string> &notFoundContainers);
+void LoadUnzippedMods(std::vector<std::string> &unzippedMods, bool listResources, std::vector<std::string> &notFoundContainers);
+double CommitLoadedMods();
+void LoadAllMods(std::vector<std::string> &zippedMods, std::vector<std::string> &unzippedMods);
+void ReadResource(ContainerStorage &storage, ResourceContainer &resourceContainer);
+void ReadChunkInfo(ContainerStorage &storage, ResourceContainer &resourceContainer);
+void AddAllExtraResources();
+void ReplaceChunks(ContainerStorage &storage, ResourceContainer &resourceContainer, std::stringstream &os);
+void AddChunks(ContainerStorage &storage, ResourceContainer &resourceContainer, std::stringstream &os);
 bool SetModDataForChunk(
-    MemoryMappedFile &memoryMappedFile,
+    ContainerStorage &storage,
     ResourceContainer &resourceContainer,
     ResourceChunk &chunk,
     ResourceModFile &modFile,
@@ -356,9 +465,50 @@ bool SetModDataForChunk(
 
 // Sound mods
 void LoadSoundMods(SoundContainer &soundContainer);
-void ReadSoundEntries(MemoryMappedFile &memoryMappedFile, SoundContainer &soundContainer);
+void ReadSoundEntries(ContainerStorage &storage, SoundContainer &soundContainer);
 std::vector<SoundEntry> GetSoundEntriesToModify(SoundContainer &soundContainer, uint32_t soundModId);
-void ReplaceSounds(MemoryMappedFile &memoryMappedFile, SoundContainer &soundContainer, std::stringstream &os);
+void ReplaceSounds(ContainerStorage &storage, SoundContainer &soundContainer, std::stringstream &os);
+
+// Compaction
+void CompactContainers(int64_t memoryBudget, bool punchHoles);
+
+// Durability
+bool SyncContainer(ContainerStorage &storage);
+bool SyncFile(const std::string &path);
+bool SyncDirectory(const std::string &path);
+bool GroupSync();
+bool UseContainerJournals();
+bool CommitContainerJournal(ContainerJournal &journal);
+bool CommitPendingJournals();
+void GroupCommit();
+void RecoverContainerJournals();
+
+// Snapshots
+int64_t GetContainerMetadataSize(const std::string &containerPath);
+bool PrepareContainerSnapshot(ContainerStorage &storage, int64_t metadataSize, int64_t &originalDataEnd, std::stringstream &os);
+bool SaveDisplacedData(ContainerStorage &storage, int64_t offset, int64_t size, std::stringstream &os);
+bool RestoreContainer(const std::string &containerPath);
+void RestoreContainers();
+
+// Plans
+void PlanResourceMods(ResourceContainer &resourceContainer);
+void PlanSoundMods(SoundContainer &soundContainer);
+ContainerWork EstimateResourceWork(ResourceContainer &resourceContainer);
+ContainerWork EstimateSoundWork(SoundContainer &soundContainer);
+double EstimateWorkTime(const ContainerWork &work);
+void PrintPlanSummary();
+
+// Manifests
+void BuildContainerManifests(std::vector<std::string> &zippedMods, std::vector<std::string> &unzippedMods);
+int32_t FindUpToDateContainers();
+bool IsRestoreNeeded(const std::string &oldManifest, const std::string &newManifest);
+std::string PathToContainer(const std::string &containerName);
+int32_t RestoreChangedContainers(const std::map<std::string, std::string> &previousManifests);
+void WriteContainerManifests();
+
+// Conflicts
+void ResolveModConflicts(std::vector<std::string> &zippedMods, std::vector<std::string> &unzippedMods);
+bool IsModFileOverridden(const std::string &containerName, const std::string &modFileName, const std::string &modFilePath);
 
 // Path to containers
 std::string PathToResourceContainer(std::string name);
@@ -370,12 +520,17 @@ int32_t GetSoundContainer(std::string &soundContainerName);
 ResourceChunk *GetChunk(std::string name, ResourceContainer &resourceContainer);
 
 // Load mod files
+void FindMods(const std::string &modsPath, std::vector<std::string> &zippedMods, std::vector<std::string> &unzippedMods);
+std::string GetLooseModFileName(const std::string &unzippedMod);
+bool GetSharedZipEntryKeys(const std::string &zippedMod, std::set<std::string> &zipEntryKeys);
 void LoadZippedMod(std::string zippedMod, bool listResources, std::vector<std::string> &notFoundContainers);
+bool SetModFileSource(ResourceModFile &resourceModFile, FileRange source);
 void LoadUnzippedMod(std::string unzippedMod, bool listResources, Mod &globalLooseMod, std::atomic<int32_t> &unzippedModCount, std::vector<std::string> &notFoundContainers);
 
 // Misc
 std::vector<std::byte> IdCrypt(std::vector<std::byte> fileData, std::string internalPath, bool decrypt);
 void SetOptimalBufferSize(std::string driveRootPath);
+void SetBuffer();
 void GetResourceContainerPathList();
 
 #endif
\ No newline at end of file
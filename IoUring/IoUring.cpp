@@ -0,0 +1,230 @@
+/*
+* This file is part of EternalModLoaderCpp (https://github.com/PowerBall253/EternalModLoaderCpp).
+* Copyright (C) 2021 PowerBall253
+*
+* EternalModLoaderCpp is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* EternalModLoaderCpp is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with EternalModLoaderCpp. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifdef __linux__
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+#include "IoUring/IoUring.hpp"
+
+/**
+ * @brief Destroy the IoUring object
+ *
+ */
+IoUring::~IoUring()
+{
+    if (SubmissionEntries != NULL)
+        munmap(SubmissionEntries, SubmissionEntriesSize);
+
+    if (CompletionRing != NULL && CompletionRing != SubmissionRing)
+        munmap(CompletionRing, CompletionRingSize);
+
+    if (SubmissionRing != NULL)
+        munmap(SubmissionRing, SubmissionRingSize);
+
+    if (RingFileDescriptor != -1)
+        close(RingFileDescriptor);
+}
+
+/**
+ * @brief Set up the ring
+ *
+ * @param entries Number of submission entries
+ * @return True on success, false otherwise
+ */
+bool IoUring::Init(uint32_t entries)
+{
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+
+    RingFileDescriptor = syscall(__NR_io_uring_setup, entries, &params);
+
+    if (RingFileDescriptor < 0) {
+        RingFileDescriptor = -1;
+        return false;
+    }
+
+    SubmissionRingSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    CompletionRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+        SubmissionRingSize = CompletionRingSize = std::max(SubmissionRingSize, CompletionRingSize);
+
+    SubmissionRing = mmap(0, SubmissionRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, RingFileDescriptor, IORING_OFF_SQ_RING);
+
+    if (SubmissionRing == MAP_FAILED) {
+        SubmissionRing = NULL;
+        return false;
+    }
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        CompletionRing = SubmissionRing;
+    }
+    else {
+        CompletionRing = mmap(0, CompletionRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, RingFileDescriptor, IORING_OFF_CQ_RING);
+
+        if (CompletionRing == MAP_FAILED) {
+            CompletionRing = NULL;
+            return false;
+        }
+    }
+
+    SubmissionEntriesSize = params.sq_entries * sizeof(io_uring_sqe);
+    SubmissionEntries = (io_uring_sqe*)mmap(0, SubmissionEntriesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, RingFileDescriptor, IORING_OFF_SQES);
+
+    if (SubmissionEntries == MAP_FAILED) {
+        SubmissionEntries = NULL;
+        return false;
+    }
+
+    SubmissionHead = (uint32_t*)((char*)SubmissionRing + params.sq_off.head);
+    SubmissionTail = (uint32_t*)((char*)SubmissionRing + params.sq_off.tail);
+    SubmissionMask = (uint32_t*)((char*)SubmissionRing + params.sq_off.ring_mask);
+    SubmissionArray = (uint32_t*)((char*)SubmissionRing + params.sq_off.array);
+    CompletionHead = (uint32_t*)((char*)CompletionRing + params.cq_off.head);
+    CompletionTail = (uint32_t*)((char*)CompletionRing + params.cq_off.tail);
+    CompletionMask = (uint32_t*)((char*)CompletionRing + params.cq_off.ring_mask);
+    CompletionEntries = (io_uring_cqe*)((char*)CompletionRing + params.cq_off.cqes);
+
+    Entries = params.sq_entries;
+
+    return true;
+}
+
+/**
+ * @brief Register the given buffers with the kernel, so writes from them skip mapping them every time
+ *
+ * @param buffers Vector containing the buffers to register
+ * @param bufferSize Size of each buffer
+ * @return True on success, false otherwise
+ */
+bool IoUring::RegisterBuffers(std::vector<std::byte*> &buffers, size_t bufferSize)
+{
+    std::vector<iovec> bufferVectors(buffers.size());
+
+    for (size_t i = 0; i < buffers.size(); i++) {
+        bufferVectors[i].iov_base = buffers[i];
+        bufferVectors[i].iov_len = bufferSize;
+    }
+
+    BuffersRegistered = syscall(__NR_io_uring_register, RingFileDescriptor, IORING_REGISTER_BUFFERS, bufferVectors.data(), bufferVectors.size()) == 0;
+
+    return BuffersRegistered;
+}
+
+/**
+ * @brief Queue a write in the submission ring
+ *
+ * @param fileDescriptor File descriptor to write to
+ * @param data Data to write
+ * @param size Number of bytes to write
+ * @param offset Offset in the file to write to
+ * @param bufferIndex Index of the registered buffer holding the data, or -1 if not registered
+ * @param userData Value identifying the write in its completion
+ * @return True on success, false if the ring is full
+ */
+bool IoUring::PrepareWrite(int fileDescriptor, const std::byte *data, uint32_t size, uint64_t offset, int32_t bufferIndex, uint64_t userData)
+{
+    uint32_t tail = *SubmissionTail;
+
+    if (tail - __atomic_load_n(SubmissionHead, __ATOMIC_ACQUIRE) >= Entries)
+        return false;
+
+    uint32_t index = tail & *SubmissionMask;
+    io_uring_sqe *submissionEntry = &SubmissionEntries[index];
+    std::memset(submissionEntry, 0, sizeof(io_uring_sqe));
+
+    submissionEntry->opcode = bufferIndex != -1 && BuffersRegistered ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+    submissionEntry->fd = fileDescriptor;
+    submissionEntry->addr = (uint64_t)data;
+    submissionEntry->len = size;
+    submissionEntry->off = offset;
+    submissionEntry->user_data = userData;
+
+    if (submissionEntry->opcode == IORING_OP_WRITE_FIXED)
+        submissionEntry->buf_index = bufferIndex;
+
+    SubmissionArray[index] = index;
+    __atomic_store_n(SubmissionTail, tail + 1, __ATOMIC_RELEASE);
+    PendingSubmissions++;
+
+    return true;
+}
+
+/**
+ * @brief Submit all queued writes in a single system call, and wait for completions
+ *
+ * @param minComplete Number of completions to wait for
+ * @return True on success, false otherwise
+ */
+bool IoUring::Submit(uint32_t minComplete)
+{
+    while (true) {
+        int submitted = syscall(__NR_io_uring_enter, RingFileDescriptor, PendingSubmissions, minComplete, minComplete > 0 ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+
+        if (submitted < 0) {
+            if (errno == EINTR)
+                continue;
+
+            return false;
+        }
+
+        PendingSubmissions -= submitted;
+        return true;
+    }
+}
+
+/**
+ * @brief Get the next completed write, if any
+ *
+ * @param userData Value identifying the completed write
+ * @param result Number of bytes written, or a negated error code
+ * @return True if a completion was found, false otherwise
+ */
+bool IoUring::PopCompletion(uint64_t &userData, int32_t &result)
+{
+    uint32_t head = *CompletionHead;
+
+    if (head == __atomic_load_n(CompletionTail, __ATOMIC_ACQUIRE))
+        return false;
+
+    io_uring_cqe *completionEntry = &CompletionEntries[head & *CompletionMask];
+    userData = completionEntry->user_data;
+    result = completionEntry->res;
+
+    __atomic_store_n(CompletionHead, head + 1, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+/**
+ * @brief Check if io_uring can be used on this system
+ *
+ * @return True if available, false otherwise
+ */
+bool IoUring::IsAvailable()
+{
+    IoUring ring;
+    return ring.Init(1);
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,68 @@
+/*
+* This file is part of EternalModLoaderCpp (https://github.com/PowerBall253/EternalModLoaderCpp).
+* Copyright (C) 2021 PowerBall253
+*
+* EternalModLoaderCpp is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* EternalModLoaderCpp is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with EternalModLoaderCpp. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef IOURING_HPP
+#define IOURING_HPP
+
+#ifdef __linux__
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <linux/io_uring.h>
+
+/**
+ * @brief Minimal io_uring submission/completion ring, using the raw system calls
+ *
+ */
+class IoUring {
+public:
+    uint32_t Entries = 0;
+    bool BuffersRegistered = false;
+
+    ~IoUring();
+
+    bool Init(uint32_t entries);
+    bool RegisterBuffers(std::vector<std::byte*> &buffers, size_t bufferSize);
+    bool PrepareWrite(int fileDescriptor, const std::byte *data, uint32_t size, uint64_t offset, int32_t bufferIndex, uint64_t userData);
+    bool Submit(uint32_t minComplete);
+    bool PopCompletion(uint64_t &userData, int32_t &result);
+
+    static bool IsAvailable();
+private:
+    int RingFileDescriptor = -1;
+    uint32_t PendingSubmissions = 0;
+
+    void *SubmissionRing = NULL;
+    size_t SubmissionRingSize = 0;
+    void *CompletionRing = NULL;
+    size_t CompletionRingSize = 0;
+    io_uring_sqe *SubmissionEntries = NULL;
+    size_t SubmissionEntriesSize = 0;
+
+    uint32_t *SubmissionHead = NULL;
+    uint32_t *SubmissionTail = NULL;
+    uint32_t *SubmissionMask = NULL;
+    uint32_t *SubmissionArray = NULL;
+    uint32_t *CompletionHead = NULL;
+    uint32_t *CompletionTail = NULL;
+    uint32_t *CompletionMask = NULL;
+    io_uring_cqe *CompletionEntries = NULL;
+};
+#endif
+
+#endif
\ No newline at end of file
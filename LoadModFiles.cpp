@@ -1,10 +1,227 @@
 #include <iostream>
 #include <filesystem>
 #include <algorithm>
+#include <fstream>
+#include <cstring>
+#include <sstream>
+#include <map>
 
 #include "miniz/miniz.h"
 #include "EternalModLoader.hpp"
 
+extern const std::byte *DivinityMagic;
+
+// Mod files at least this big are left on disk and copied straight into the containers
+const int64_t DirectCopyThreshold = 64 * 1024;
+
+// Zip entries extracted in batch mode, keyed by their path, CRC-32 and size, shared by all the game directories
+std::map<std::string, std::vector<std::byte>> SharedZipEntries;
+std::map<std::string, int32_t> SharedZipEntryUses;
+uint64_t SharedZipEntriesSize = 0;
+std::atomic<int32_t> SharedZipEntryHits = 0;
+std::atomic<int32_t> SharedZipEntryMisses = 0;
+
+// Memory used to keep zip entries for the next game directories in batch mode, other entries are extracted again
+const uint64_t SharedZipEntriesMaxSize = 1024 * 1024 * 1024;
+
+/**
+ * @brief Leave the mod file's data on disk, to be copied straight into the container on commit
+ * 
+ * @param resourceModFile ResourceModFile object to set the data source of
+ * @param source Range of the file on disk holding the mod file's data
+ * @return True if the data was left on disk, false if it must be loaded in memory
+ */
+bool SetModFileSource(ResourceModFile &resourceModFile, FileRange source)
+{
+    if (SlowMode || source.Size < DirectCopyThreshold)
+        return false;
+
+    std::byte header[16];
+    std::ifstream sourceFile(source.Path, std::ios::binary);
+
+    if (!sourceFile.seekg(source.Offset) || !sourceFile.read((char*)header, 16))
+        return false;
+
+    if (!memcmp(header, DivinityMagic, 8)) {
+        uint64_t uncompressedSize;
+        std::copy(header + 8, header + 16, (std::byte*)&uncompressedSize);
+        resourceModFile.FileSourceUncompressedSize = uncompressedSize;
+    }
+    else if (CompressTextures && resourceModFile.Name.find(".tga") != std::string::npos) {
+        return false;
+    }
+
+    resourceModFile.FileSource = source;
+    return true;
+}
+
+/**
+ * @brief Get the offset of a stored zip entry's data
+ * 
+ * @param zippedMod Zipped mod path
+ * @param localHeaderOffset Offset of the entry's local header
+ * @return Offset of the entry's data, or -1 on error
+ */
+int64_t GetZipEntryDataOffset(std::string &zippedMod, int64_t localHeaderOffset)
+{
+    std::byte localHeader[30];
+    std::ifstream zipFile(zippedMod, std::ios::binary);
+
+    if (!zipFile.seekg(localHeaderOffset) || !zipFile.read((char*)localHeader, 30))
+        return -1;
+
+    uint32_t signature;
+    uint16_t fileNameLength, extraFieldLength;
+    std::copy(localHeader, localHeader + 4, (std::byte*)&signature);
+    std::copy(localHeader + 26, localHeader + 28, (std::byte*)&fileNameLength);
+    std::copy(localHeader + 28, localHeader + 30, (std::byte*)&extraFieldLength);
+
+    if (signature != 0x04034B50)
+        return -1;
+
+    return localHeaderOffset + 30 + fileNameLength + extraFieldLength;
+}
+
+/**
+ * @brief Find the zipped mods and loose mod files in the Mods folder
+ *
+ * Only zips at the root of the folder are zipped mods, other files are loose mod files.
+ * The folder is kept to route the loose mod files to their containers.
+ *
+ * @param modsPath Path to the Mods folder
+ * @param zippedMods Vector to push the zipped mod paths to
+ * @param unzippedMods Vector to push the loose mod file paths to
+ */
+void FindMods(const std::string &modsPath, std::vector<std::string> &zippedMods, std::vector<std::string> &unzippedMods)
+{
+    ModsPath = modsPath;
+
+    for (const auto &file : std::filesystem::recursive_directory_iterator(modsPath)) {
+        if (!std::filesystem::is_regular_file(file.path()))
+            continue;
+
+        if (file.path().extension() == ".zip" && file.path() == modsPath + Separator + file.path().filename().string()) {
+            zippedMods.push_back(file.path().string());
+        }
+        else if (file.path().extension() != ".zip") {
+            unzippedMods.push_back(file.path().string());
+        }
+    }
+}
+
+/**
+ * @brief Get the path of a loose mod file relative to the Mods folder it was found in
+ *
+ * @param unzippedMod Loose mod path
+ * @return Path relative to the Mods folder, with '/' separators
+ */
+std::string GetLooseModFileName(const std::string &unzippedMod)
+{
+    return std::filesystem::path(unzippedMod).lexically_relative(ModsPath).generic_string();
+}
+
+/**
+ * @brief Get the key identifying a zip entry's contents, shared by identical entries of different zips
+ *
+ * @param zipEntryStat Zip entry's central directory record
+ * @return Key of the zip entry
+ */
+static std::string GetSharedZipEntryKey(const mz_zip_archive_file_stat &zipEntryStat)
+{
+    std::stringstream keyStream;
+    keyStream << zipEntryStat.m_filename << '\t' << std::hex << zipEntryStat.m_crc32 << '\t' << std::dec << zipEntryStat.m_uncomp_size;
+
+    return keyStream.str();
+}
+
+/**
+ * @brief Get the keys of the zip entries of a zipped mod, from its central directory
+ *
+ * @param zippedMod Zipped mod path
+ * @param zipEntryKeys Set to insert the keys into
+ * @return True on success, false otherwise
+ */
+bool GetSharedZipEntryKeys(const std::string &zippedMod, std::set<std::string> &zipEntryKeys)
+{
+    mz_zip_archive modZip;
+    mz_zip_zero_struct(&modZip);
+
+    if (!mz_zip_reader_init_file(&modZip, zippedMod.c_str(), 0))
+        return false;
+
+    for (int32_t i = 0; i < modZip.m_total_files; i++) {
+        mz_zip_archive_file_stat zipEntryStat;
+
+        if (mz_zip_reader_file_stat(&modZip, i, &zipEntryStat) && !zipEntryStat.m_is_directory)
+            zipEntryKeys.insert(GetSharedZipEntryKey(zipEntryStat));
+    }
+
+    mz_zip_reader_end(&modZip);
+    return true;
+}
+
+/**
+ * @brief Extract a zip entry, or copy it from the entries extracted for another game directory in batch mode
+ *
+ * Extracted entries are only kept if a game directory loaded later uses them too, within a memory limit.
+ *
+ * @param modZip Zip archive containing the entry
+ * @param index Index of the entry in the zip
+ * @param entryBytes Vector to store the entry's data in
+ * @return True on success, false otherwise
+ */
+bool ExtractZipEntry(mz_zip_archive &modZip, int32_t index, std::vector<std::byte> &entryBytes)
+{
+    std::string key;
+
+    if (ShareZipEntries) {
+        mz_zip_archive_file_stat zipEntryStat;
+
+        if (mz_zip_reader_file_stat(&modZip, index, &zipEntryStat)) {
+            key = GetSharedZipEntryKey(zipEntryStat);
+
+            mtx.lock();
+            auto sharedEntry = SharedZipEntries.find(key);
+
+            if (sharedEntry != SharedZipEntries.end()) {
+                entryBytes = sharedEntry->second;
+                mtx.unlock();
+
+                SharedZipEntryHits++;
+                return true;
+            }
+
+            mtx.unlock();
+        }
+    }
+
+    std::byte *unzippedEntry;
+    size_t unzippedEntrySize;
+
+    if ((unzippedEntry = (std::byte*)mz_zip_reader_extract_to_heap(&modZip, index, &unzippedEntrySize, 0)) == NULL)
+        return false;
+
+    entryBytes = std::vector<std::byte>(unzippedEntry, unzippedEntry + unzippedEntrySize);
+    free(unzippedEntry);
+
+    if (!key.empty()) {
+        mtx.lock();
+        auto sharedEntryUses = SharedZipEntryUses.find(key);
+
+        if (sharedEntryUses != SharedZipEntryUses.end() && sharedEntryUses->second > 1
+            && SharedZipEntriesSize + entryBytes.size() <= SharedZipEntriesMaxSize) {
+                SharedZipEntries[key] = entryBytes;
+                SharedZipEntriesSize += entryBytes.size();
+        }
+
+        mtx.unlock();
+
+        SharedZipEntryMisses++;
+    }
+
+    return true;
+}
+
 /**
  * @brief Load mod files from zip
  * 
@@ -84,6 +301,10 @@ void LoadZippedMod(std::string zippedMod, bool listResources, std::vector<std::s
             modFileName = modFileName.substr(resourceName.size() + 1, modFileName.size() - resourceName.size() - 1);
         }
 
+        // The container's mods haven't changed since the last run
+        if (UpToDateContainers.count(resourceName) != 0)
+            continue;
+
         std::string resourcePath = PathToResourceContainer(resourceName + ".resources");
 
         if (resourcePath.empty()) {
@@ -117,6 +338,10 @@ void LoadZippedMod(std::string zippedMod, bool listResources, std::vector<std::s
 
             mtx.unlock();
 
+            // Another mod replaces the same sound and wins
+            if (!listResources && IsModFileOverridden(resourceName, std::filesystem::path(modFileName).filename().string(), zippedMod + '/' + zipEntryName))
+                continue;
+
             if (!listResources) {
                 std::string soundExtension = std::filesystem::path(modFileName).extension().string();
 
@@ -127,20 +352,15 @@ void LoadZippedMod(std::string zippedMod, bool listResources, std::vector<std::s
                     continue;
                 }
 
-                std::byte *unzippedEntry;
-                size_t unzippedEntrySize;
+                SoundModFile soundModFile(mod, std::filesystem::path(modFileName).filename().string());
 
-                if ((unzippedEntry = (std::byte*)mz_zip_reader_extract_to_heap(&modZip, i, &unzippedEntrySize, 0)) == NULL) {
+                if (!ExtractZipEntry(modZip, i, soundModFile.FileBytes)) {
                     mtx.lock();
                     std::cout << RED << "ERROR: " << "Failed to extract zip entry from " << zippedMod << '\n';
                     mtx.unlock();
                     continue;
                 }
 
-                SoundModFile soundModFile(mod, std::filesystem::path(modFileName).filename().string());
-                soundModFile.FileBytes = std::vector<std::byte>(unzippedEntry, unzippedEntry + unzippedEntrySize);
-                free(unzippedEntry);
-
                 mtx.lock();
                 SoundContainerList[soundContainerIndex].ModFileList.push_back(soundModFile);
                 mtx.unlock();
@@ -162,21 +382,31 @@ void LoadZippedMod(std::string zippedMod, bool listResources, std::vector<std::s
 
             mtx.unlock();
 
+            // Another mod replaces the same resource and wins
+            if (!listResources && IsModFileOverridden(resourceName, modFileName, zippedMod + '/' + zipEntryName))
+                continue;
+
             ResourceModFile resourceModFile(mod, modFileName);
+            bool isDataOnDisk = false;
 
-            if (!listResources) {
-                std::byte *unzippedEntry;
-                size_t unzippedEntrySize;
+            // Stored entries don't need to be extracted, they can be copied from the zip file as they are
+            if (!listResources && ToLower(modFilePathParts[1]) != "eternalmod") {
+                mz_zip_archive_file_stat zipEntryStat;
 
-                if ((unzippedEntry = (std::byte*)mz_zip_reader_extract_to_heap(&modZip, i, &unzippedEntrySize, 0)) == NULL) {
-                    mtx.lock();
-                    std::cout << RED << "ERROR: " << "Failed to extract zip entry from " << zippedMod << '\n';
-                    mtx.unlock();
-                    continue;
+                if (mz_zip_reader_file_stat(&modZip, i, &zipEntryStat) && zipEntryStat.m_method == 0
+                    && !zipEntryStat.m_is_encrypted && zipEntryStat.m_comp_size == zipEntryStat.m_uncomp_size) {
+                        int64_t dataOffset = GetZipEntryDataOffset(zippedMod, zipEntryStat.m_local_header_ofs);
+
+                        if (dataOffset != -1)
+                            isDataOnDisk = SetModFileSource(resourceModFile, FileRange(zippedMod, dataOffset, zipEntryStat.m_uncomp_size));
                 }
+            }
 
-                resourceModFile.FileBytes = std::vector<std::byte>(unzippedEntry, unzippedEntry + unzippedEntrySize);
-                free(unzippedEntry);
+            if (!listResources && !isDataOnDisk && !ExtractZipEntry(modZip, i, resourceModFile.FileBytes)) {
+                mtx.lock();
+                std::cout << RED << "ERROR: " << "Failed to extract zip entry from " << zippedMod << '\n';
+                mtx.unlock();
+                continue;
             }
 
             if (ToLower(modFilePathParts[1]) == "eternalmod") {
@@ -251,23 +481,26 @@ void LoadZippedMod(std::string zippedMod, bool listResources, std::vector<std::s
 void LoadUnzippedMod(std::string unzippedMod, bool listResources, Mod &globalLooseMod, std::atomic<int32_t> &unzippedModCount, std::vector<std::string> &notFoundContainers)
 {
     std::replace(unzippedMod.begin(), unzippedMod.end(), Separator, '/');
-    std::vector<std::string> modFilePathParts = SplitString(unzippedMod, '/');
+    std::string fileName = GetLooseModFileName(unzippedMod);
+    std::vector<std::string> modFilePathParts = SplitString(fileName, '/');
 
-    if (modFilePathParts.size() < 4)
+    if (modFilePathParts.size() < 2)
         return;
 
     bool isSoundMod = false;
-    std::string resourceName = modFilePathParts[2];
-    std::string fileName;
+    std::string resourceName = modFilePathParts[0];
 
     if (ToLower(resourceName) == "generated") {
         resourceName = "gameresources";
-        fileName = unzippedMod.substr(modFilePathParts[1].size() + 3, unzippedMod.size() - modFilePathParts[1].size() - 3);
     }
     else {
-        fileName = unzippedMod.substr(modFilePathParts[1].size() + resourceName.size() + 4, unzippedMod.size() - resourceName.size() - 4);
+        fileName = fileName.substr(resourceName.size() + 1);
     }
 
+    // The container's mods haven't changed since the last run
+    if (UpToDateContainers.count(resourceName) != 0)
+        return;
+
     std::string resourcePath = PathToResourceContainer(resourceName + ".resources");
 
     if (resourcePath.empty()) {
@@ -301,6 +534,10 @@ void LoadUnzippedMod(std::string unzippedMod, bool listResources, Mod &globalLoo
 
         mtx.unlock();
 
+        // Another mod replaces the same sound and wins
+        if (!listResources && IsModFileOverridden(resourceName, std::filesystem::path(fileName).filename().string(), unzippedMod))
+            return;
+
         if (!listResources) {
             std::string soundExtension = std::filesystem::path(fileName).extension().string();
 
@@ -348,7 +585,7 @@ void LoadUnzippedMod(std::string unzippedMod, bool listResources, Mod &globalLoo
         int32_t resourceContainerIndex = GetResourceContainer(resourceName);
 
         if (resourceContainerIndex == -1) {
-            ResourceContainer resourceContainer(resourceName, PathToResourceContainer(resourceName));
+            ResourceContainer resourceContainer(resourceName, resourcePath);
             ResourceContainerList.push_back(resourceContainer);
 
             resourceContainerIndex = ResourceContainerList.size() - 1;
@@ -356,36 +593,44 @@ void LoadUnzippedMod(std::string unzippedMod, bool listResources, Mod &globalLoo
 
         mtx.unlock();
 
+        // Another mod replaces the same resource and wins
+        if (!listResources && IsModFileOverridden(resourceName, fileName, unzippedMod))
+            return;
+
         ResourceModFile resourceModFile(globalLooseMod, fileName);
 
         if (!listResources) {
             int64_t unzippedModSize = std::filesystem::file_size(unzippedMod);
+            bool isDataOnDisk = ToLower(modFilePathParts[1]) != "eternalmod"
+                && SetModFileSource(resourceModFile, FileRange(unzippedMod, 0, unzippedModSize));
 
-            FILE *unzippedModFile = fopen(unzippedMod.c_str(), "rb");
+            if (!isDataOnDisk) {
+                FILE *unzippedModFile = fopen(unzippedMod.c_str(), "rb");
 
-            if (!unzippedModFile) {
-                mtx.lock();
-                std::cout << RED << "ERROR: " << RESET << "Failed to open " << unzippedMod << " for reading." << '\n';
-                mtx.unlock();
-                return;
-            }
+                if (!unzippedModFile) {
+                    mtx.lock();
+                    std::cout << RED << "ERROR: " << RESET << "Failed to open " << unzippedMod << " for reading." << '\n';
+                    mtx.unlock();
+                    return;
+                }
 
-            resourceModFile.FileBytes.resize(unzippedModSize);
+                resourceModFile.FileBytes.resize(unzippedModSize);
 
-            if (fread(resourceModFile.FileBytes.data(), 1, unzippedModSize, unzippedModFile) != unzippedModSize) {
-                mtx.lock();
-                std::cout << RESET << "ERROR: " << RESET << "Failed to read from " << unzippedMod << "." << '\n';
-                mtx.unlock();
-                return;
-            }
+                if (fread(resourceModFile.FileBytes.data(), 1, unzippedModSize, unzippedModFile) != unzippedModSize) {
+                    mtx.lock();
+                    std::cout << RESET << "ERROR: " << RESET << "Failed to read from " << unzippedMod << "." << '\n';
+                    mtx.unlock();
+                    return;
+                }
 
-            fclose(unzippedModFile);
+                fclose(unzippedModFile);
+            }
         }
 
-        if (ToLower(modFilePathParts[3]) == "eternalmod") {
-            if (modFilePathParts.size() == 6
-            && ToLower(modFilePathParts[4]) == "assetsinfo"
-            && std::filesystem::path(modFilePathParts[5]).extension() == ".json") {
+        if (ToLower(modFilePathParts[1]) == "eternalmod") {
+            if (modFilePathParts.size() == 4
+            && ToLower(modFilePathParts[2]) == "assetsinfo"
+            && std::filesystem::path(modFilePathParts[3]).extension() == ".json") {
                 try {
                     if (listResources) {
                         int64_t unzippedModSize = std::filesystem::file_size(unzippedMod);
@@ -424,9 +669,9 @@ void LoadUnzippedMod(std::string unzippedMod, bool listResources, Mod &globalLoo
                     return;
                 }
             }
-            else if (modFilePathParts.size() == 6
-            && ToLower(modFilePathParts[4]) == "strings"
-            && std::filesystem::path(modFilePathParts[5]).extension() == ".json") {
+            else if (modFilePathParts.size() == 4
+            && ToLower(modFilePathParts[2]) == "strings"
+            && std::filesystem::path(modFilePathParts[3]).extension() == ".json") {
                 resourceModFile.IsBlangJson = true;
             }
             else {
@@ -1,9 +1,63 @@
 #include <iostream>
 #include <filesystem>
 #include <sstream>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <functional>
+#include <atomic>
+#include <climits>
 
 #include "EternalModLoader.hpp"
 
+namespace chrono = std::chrono;
+
+extern std::atomic<int32_t> ActiveContainerCount;
+
+/**
+ * @brief Task loading the mods into a container
+ *
+ */
+class ContainerTask {
+public:
+    std::string Path;
+    ContainerWork *Work = NULL;
+    double EstimatedTime = 0;
+    double ActualTime = 0;
+    std::function<void()> Load;
+
+    /**
+     * @brief Construct a new ContainerTask object
+     *
+     * @param path Path to the container
+     * @param work ContainerWork object the container's work is recorded in
+     * @param estimatedTime Estimated time to load the mods into the container
+     * @param load Function loading the mods into the container
+     */
+    ContainerTask(std::string path, ContainerWork *work, double estimatedTime, std::function<void()> load)
+    {
+        Path = path;
+        Work = work;
+        EstimatedTime = estimatedTime;
+        Load = load;
+    }
+};
+
+/**
+ * @brief Build the journal of the staged metadata changes, once the payloads are committed
+ *
+ * @param stagedStorage StagedStorage object containing the changes
+ * @return ContainerJournal object containing the changes
+ */
+ContainerJournal GetContainerJournal(StagedStorage &stagedStorage)
+{
+    ContainerJournal journal;
+    journal.ContainerPath = stagedStorage.FilePath;
+    journal.Metadata = std::move(stagedStorage.Metadata);
+
+    return journal;
+}
+
 /**
  * @brief Load mods to the given resource file
  * 
@@ -18,21 +72,90 @@ void LoadResourceMods(ResourceContainer &resourceContainer)
     if (!MultiThreading)
         ((std::ostream&)os).rdbuf(std::cout.rdbuf());
 
-    MemoryMappedFile *memoryMappedFile;
+    ContainerStorage *storage;
 
     try {
-        memoryMappedFile = new MemoryMappedFile(resourceContainer.Path);
+        if (MemoryOnly)
+            storage = new InMemoryStorage(resourceContainer.Path);
+        else
+            storage = new MemoryMappedFile(resourceContainer.Path);
     }
     catch (...) {
         os << RED << "ERROR: " << RESET << "Failed to open " << YELLOW << resourceContainer.Path << RESET << " for writing!" << std::endl;
         return;
     }
 
-    ReadResource(*memoryMappedFile, resourceContainer);
-    ReplaceChunks(*memoryMappedFile, resourceContainer, os);
-    AddChunks(*memoryMappedFile, resourceContainer, os);
+    ReadResource(*storage, resourceContainer);
+    resourceContainer.WriteQueue.Reset(storage->Size);
+
+    // The container's original state is kept restorable, so its original data must be left untouched
+    if (!MemoryOnly && !PrepareContainerSnapshot(*storage, resourceContainer.DataOffset, resourceContainer.OriginalDataEnd, os)) {
+        delete storage;
+        return;
+    }
+
+    // Metadata changes are staged, and written through a journal once the payloads are on disk
+    StagedStorage *stagedStorage = NULL;
+
+    if (UseContainerJournals())
+        stagedStorage = new StagedStorage(*storage, resourceContainer.DataOffset);
+
+    ContainerStorage &containerStorage = stagedStorage != NULL ? *stagedStorage : *storage;
+
+    // Unused regions of the data section, left behind by previous runs, are reused before growing the file
+    if (!SlowMode) {
+        std::vector<DataExtent> holes = GetHoles(resourceContainer.LiveExtents,
+            std::max(resourceContainer.DataOffset, resourceContainer.OriginalDataEnd), storage->Size);
+        resourceContainer.DataSectionAllocator.Reset(holes, resourceContainer.DataOffset);
+    }
+
+    ReplaceChunks(containerStorage, resourceContainer, os);
+    AddChunks(containerStorage, resourceContainer, os);
+
+    bool wasCommitted = resourceContainer.WriteQueue.Commit(containerStorage);
+
+    if (!wasCommitted)
+        os << RED << "ERROR: " << RESET << "Failed to write mod files to " << YELLOW << resourceContainer.Path << RESET << '\n';
+
+    if (Durability == DurabilityMode::Container && !SyncContainer(*storage)) {
+        os << RED << "ERROR: " << RESET << "Failed to flush " << YELLOW << resourceContainer.Path << RESET << " to disk" << '\n';
+        wasCommitted = false;
+    }
+
+    if (Verbose && resourceContainer.UnchangedFileCount > 0) {
+        os << "Skipped " << GREEN << resourceContainer.UnchangedFileCount << " unchanged file(s) " << RESET
+            << "in " << YELLOW << resourceContainer.Path << RESET << "." << '\n';
+    }
+
+    int64_t reclaimedBytes = resourceContainer.DataSectionAllocator.ReclaimedBytes;
+    int64_t appendedBytes = resourceContainer.DataSectionAllocator.AppendedBytes;
+
+    resourceContainer.Work.UnchangedFiles = resourceContainer.UnchangedFileCount;
+    resourceContainer.Work.WrittenBytes = resourceContainer.WriteQueue.CommittedBytes;
+    resourceContainer.Work.AppendedBytes = appendedBytes;
+    resourceContainer.Work.ReclaimedBytes = reclaimedBytes;
+
+    if (reclaimedBytes > 0 || (Verbose && appendedBytes > 0)) {
+        os << "Reused " << GREEN << reclaimedBytes << " byte(s) " << RESET << "of unused space and appended " << GREEN << appendedBytes << " byte(s) "
+            << RESET << "in " << YELLOW << resourceContainer.Path << RESET << "." << '\n';
+    }
+
+    // The container has to be closed before the journal is applied
+    bool isJournaled = stagedStorage != NULL && stagedStorage->Modified;
+    ContainerJournal journal;
+
+    if (isJournaled)
+        journal = GetContainerJournal(*stagedStorage);
+
+    delete stagedStorage;
+    delete storage;
 
-    delete memoryMappedFile;
+    if (isJournaled && !CommitContainerJournal(journal)) {
+        os << RED << "ERROR: " << RESET << "Failed to commit the changes to " << YELLOW << resourceContainer.Path << RESET << '\n';
+        wasCommitted = false;
+    }
+
+    resourceContainer.WasCommitted = wasCommitted;
 }
 
 /**
@@ -49,18 +172,315 @@ void LoadSoundMods(SoundContainer &soundContainer)
     if (!MultiThreading)
         ((std::ostream&)os).rdbuf(std::cout.rdbuf());
 
-    MemoryMappedFile *memoryMappedFile;
+    ContainerStorage *storage;
 
     try {
-        memoryMappedFile = new MemoryMappedFile(soundContainer.Path);
+        if (MemoryOnly)
+            storage = new InMemoryStorage(soundContainer.Path);
+        else
+            storage = new MemoryMappedFile(soundContainer.Path);
     }
     catch (...) {
         os << RED << "ERROR: " << RESET << "Failed to open " << YELLOW << soundContainer.Path << RESET << " for writing!" << std::endl;
         return;
     }
 
-    ReadSoundEntries(*memoryMappedFile, soundContainer);
-    ReplaceSounds(*memoryMappedFile, soundContainer, os);
+    ReadSoundEntries(*storage, soundContainer);
+    soundContainer.WriteQueue.Reset(storage->Size);
+
+    // Sound mods are always appended, so the container's original data is left untouched
+    int64_t originalDataEnd;
+
+    if (!MemoryOnly && !PrepareContainerSnapshot(*storage, soundContainer.MetadataSize, originalDataEnd, os)) {
+        delete storage;
+        return;
+    }
+
+    // Metadata changes are staged, and written through a journal once the payloads are on disk
+    StagedStorage *stagedStorage = NULL;
+
+    if (UseContainerJournals())
+        stagedStorage = new StagedStorage(*storage, soundContainer.MetadataSize);
+
+    ContainerStorage &containerStorage = stagedStorage != NULL ? *stagedStorage : *storage;
+
+    ReplaceSounds(containerStorage, soundContainer, os);
+
+    bool wasCommitted = soundContainer.WriteQueue.Commit(containerStorage);
+    soundContainer.Work.WrittenBytes = soundContainer.WriteQueue.CommittedBytes;
+    soundContainer.Work.AppendedBytes = soundContainer.Work.WrittenBytes;
+
+    if (!wasCommitted)
+        os << RED << "ERROR: " << RESET << "Failed to write sound files to " << YELLOW << soundContainer.Path << RESET << '\n';
+
+    if (Durability == DurabilityMode::Container && !SyncContainer(*storage)) {
+        os << RED << "ERROR: " << RESET << "Failed to flush " << YELLOW << soundContainer.Path << RESET << " to disk" << '\n';
+        wasCommitted = false;
+    }
+
+    // The container has to be closed before the journal is applied
+    bool isJournaled = stagedStorage != NULL && stagedStorage->Modified;
+    ContainerJournal journal;
+
+    if (isJournaled)
+        journal = GetContainerJournal(*stagedStorage);
+
+    delete stagedStorage;
+    delete storage;
+
+    if (isJournaled && !CommitContainerJournal(journal)) {
+        os << RED << "ERROR: " << RESET << "Failed to commit the changes to " << YELLOW << soundContainer.Path << RESET << '\n';
+        wasCommitted = false;
+    }
+
+    soundContainer.WasCommitted = wasCommitted;
+}
+
+/**
+ * @brief Load the mods into all containers, on a pool of worker threads
+ *
+ * Containers are started from the longest to the shortest estimated time (longest processing time first),
+ * so a big container doesn't hold up the end of the run by starting last.
+ * Containers and their mod files are sorted first, so the same mods always give the same containers,
+ * whatever order they were found in.
+ *
+ * @param loadResourceMods Function loading the mods into a resource container
+ * @param loadSoundMods Function loading the mods into a sound container
+ */
+void LoadContainerMods(void (*loadResourceMods)(ResourceContainer&), void (*loadSoundMods)(SoundContainer&))
+{
+    std::sort(ResourceContainerList.begin(), ResourceContainerList.end(),
+        [](const ResourceContainer &container1, const ResourceContainer &container2) { return container1.Name < container2.Name; });
+    std::sort(SoundContainerList.begin(), SoundContainerList.end(),
+        [](const SoundContainer &container1, const SoundContainer &container2) { return container1.Name < container2.Name; });
+
+    for (auto &resourceContainer : ResourceContainerList)
+        std::stable_sort(resourceContainer.ModFileList.begin(), resourceContainer.ModFileList.end(), IsAppliedBefore<ResourceModFile>);
+
+    for (auto &soundContainer : SoundContainerList)
+        std::stable_sort(soundContainer.ModFileList.begin(), soundContainer.ModFileList.end(), IsAppliedBefore<SoundModFile>);
+
+    // Modified by all resource containers, so it's done beforehand in container order
+    AddAllExtraResources();
+
+    std::vector<ContainerTask> tasks;
+    tasks.reserve(ResourceContainerList.size() + SoundContainerList.size());
+
+    for (auto &resourceContainer : ResourceContainerList) {
+        ResourceContainer *container = &resourceContainer;
+        tasks.push_back(ContainerTask(resourceContainer.Path, &resourceContainer.Work, EstimateWorkTime(EstimateResourceWork(resourceContainer)),
+            [container, loadResourceMods]() { loadResourceMods(*container); }));
+    }
+
+    for (auto &soundContainer : SoundContainerList) {
+        SoundContainer *container = &soundContainer;
+        tasks.push_back(ContainerTask(soundContainer.Path, &soundContainer.Work, EstimateWorkTime(EstimateSoundWork(soundContainer)),
+            [container, loadSoundMods]() { loadSoundMods(*container); }));
+    }
+
+    std::stable_sort(tasks.begin(), tasks.end(),
+        [](const ContainerTask &task1, const ContainerTask &task2) { return task1.EstimatedTime > task2.EstimatedTime; });
+
+    std::atomic<size_t> nextTask = 0;
+
+    auto runTasks = [&]() {
+        for (size_t i = nextTask++; i < tasks.size(); i = nextTask++) {
+            chrono::steady_clock::time_point taskBegin = chrono::steady_clock::now();
+
+            // Payload copies split the hardware threads between the containers being loaded
+            ActiveContainerCount++;
+            tasks[i].Load();
+            ActiveContainerCount--;
+
+            chrono::steady_clock::time_point taskEnd = chrono::steady_clock::now();
+            tasks[i].ActualTime = chrono::duration_cast<chrono::microseconds>(taskEnd - taskBegin).count() / 1000000.0;
+        }
+    };
+
+    if (MultiThreading) {
+        size_t workerCount = std::min<size_t>(std::max(std::thread::hardware_concurrency(), 1u), tasks.size());
+        std::vector<std::thread> workers;
+        workers.reserve(workerCount);
+
+        for (size_t i = 0; i < workerCount; i++)
+            workers.push_back(std::thread(runTasks));
+
+        for (auto &worker : workers)
+            worker.join();
+
+        for (int32_t i = 0; i < streamIndex; i++)
+            std::cout << stringStreams[i].rdbuf();
+    }
+    else {
+        runTasks();
+    }
+
+    if (Verbose && !tasks.empty()) {
+        std::cout << "Containers, in the order they were started:" << '\n';
+
+        for (auto &task : tasks) {
+            std::cout << "\t" << YELLOW << task.Path << RESET << ": estimated " << task.EstimatedTime << " seconds, "
+                << EstimateWorkTime(*task.Work) << " from the work done, took " << task.ActualTime << " seconds" << '\n';
+        }
+    }
+}
+
+/**
+ * @brief Parse rs_data, or load its index kept from the last run
+ *
+ */
+void LoadResourceData()
+{
+    std::string resourceDataFilePath = BasePath + ResourceDataFileName;
+
+    if (std::filesystem::exists(resourceDataFilePath)) {
+        try {
+            // Keep the parsed index between runs
+            std::string resourceDataIndexPath = MemoryOnly ? "" : BasePath + "EternalModLoader.rs_data.index";
+
+            if (!ResourceDataMap.Load(resourceDataFilePath, resourceDataIndexPath))
+                throw std::exception();
+        }
+        catch (...) {
+            std::cout << RED << "ERROR: " << RESET << "Failed to parse " << ResourceDataFileName << '\n';
+        }
+    }
+    else {
+        if (Verbose) {
+            std::cout << RED << "WARNING: " << RESET << ResourceDataFileName << " was not found! There will be issues when adding existing new assets to containers..." << '\n';
+        }
+    }
+}
+
+/**
+ * @brief Forget the mods loaded by the last run, before loading them again
+ *
+ */
+void ResetLoadedMods()
+{
+    ContainerManifests.clear();
+    UpToDateContainers.clear();
+    ResourceContainerList.clear();
+    SoundContainerList.clear();
+    stringStreams.clear();
+    streamIndex = 0;
+    PackageMapSpecInfo.WasPackageMapSpecModified = false;
+    ContainerSyncTime = 0;
+}
+
+/**
+ * @brief Load the mod files of the given zipped mods
+ *
+ * @param zippedMods Zipped mod paths
+ * @param listResources Bool indicating whether to load the mod files or to only get the resources to modify
+ * @param notFoundContainers Vector to push not found resources to
+ */
+void LoadZippedMods(std::vector<std::string> &zippedMods, bool listResources, std::vector<std::string> &notFoundContainers)
+{
+    if (MultiThreading) {
+        std::vector<std::thread> zippedModLoadingThreads;
+        zippedModLoadingThreads.reserve(zippedMods.size());
+
+        for (const auto &zippedMod : zippedMods)
+            zippedModLoadingThreads.push_back(std::thread(LoadZippedMod, zippedMod, listResources, std::ref(notFoundContainers)));
+
+        for (auto &thread : zippedModLoadingThreads)
+            thread.join();
+    }
+    else {
+        for (const auto &zippedMod : zippedMods)
+            LoadZippedMod(zippedMod, listResources, notFoundContainers);
+    }
+}
+
+/**
+ * @brief Load the given loose mod files
+ *
+ * @param unzippedMods Loose mod file paths
+ * @param listResources Bool indicating whether to load the mod files or to only get the resources to modify
+ * @param notFoundContainers Vector to push not found resources to
+ */
+void LoadUnzippedMods(std::vector<std::string> &unzippedMods, bool listResources, std::vector<std::string> &notFoundContainers)
+{
+    std::atomic<int32_t> unzippedModCount = 0;
+    Mod globalLooseMod;
+    globalLooseMod.LoadPriority = INT_MIN;
+
+    if (MultiThreading) {
+        std::vector<std::thread> unzippedModLoadingThreads;
+        unzippedModLoadingThreads.reserve(unzippedMods.size());
+
+        for (const auto &unzippedMod : unzippedMods)
+            unzippedModLoadingThreads.push_back(std::thread(LoadUnzippedMod, unzippedMod, listResources, std::ref(globalLooseMod), std::ref(unzippedModCount), std::ref(notFoundContainers)));
+
+        for (auto &thread : unzippedModLoadingThreads)
+            thread.join();
+    }
+    else {
+        for (const auto &unzippedMod : unzippedMods)
+            LoadUnzippedMod(unzippedMod, listResources, globalLooseMod, unzippedModCount, notFoundContainers);
+    }
+
+    if (unzippedModCount > 0 && !listResources)
+        std::cout << "Found " << BLUE << unzippedModCount << " file(s) " << RESET << "in " << YELLOW << "'Mods' " << RESET << "folder..." << '\n';
+}
+
+/**
+ * @brief Write the modified PackageMapSpec file, flush the changes in group mode, and record the mods loaded into each container
+ *
+ * @return Time taken to flush the changes in group mode, in seconds
+ */
+double CommitLoadedMods()
+{
+    if (MemoryOnly)
+        return 0;
+
+    // Modify PackageMapSpec JSON file in disk
+    PackageMapSpecInfo.ModifyPackageMapSpec();
+
+    if (Durability == DurabilityMode::Container && PackageMapSpecInfo.WasPackageMapSpecModified
+        && !SyncFile(PackageMapSpecInfo.PackageMapSpecPath)) {
+            std::cout << RED << "ERROR: " << RESET << "Failed to flush " << PackageMapSpecInfo.PackageMapSpecPath << " to disk" << std::endl;
+    }
+
+    // Flush all changes to disk at once
+    double groupSyncTime = 0;
+
+    if (Durability == DurabilityMode::Group) {
+        chrono::steady_clock::time_point groupSyncBegin = chrono::steady_clock::now();
+
+        GroupCommit();
+
+        chrono::steady_clock::time_point groupSyncEnd = chrono::steady_clock::now();
+        groupSyncTime = chrono::duration_cast<chrono::microseconds>(groupSyncEnd - groupSyncBegin).count() / 1000000.0;
+    }
+
+    // Record the mods loaded into each container, to skip it next time if they don't change
+    WriteContainerManifests();
+
+    return groupSyncTime;
+}
+
+/**
+ * @brief Load the given mods into the containers whose mods aren't up to date, and record them in the containers' manifests
+ *
+ * @param zippedMods Zipped mod paths
+ * @param unzippedMods Loose mod file paths
+ */
+void LoadAllMods(std::vector<std::string> &zippedMods, std::vector<std::string> &unzippedMods)
+{
+    std::vector<std::string> notFoundContainers;
+
+    ResolveModConflicts(zippedMods, unzippedMods);
+    LoadZippedMods(zippedMods, false, notFoundContainers);
+    LoadUnzippedMods(unzippedMods, false, notFoundContainers);
+
+    for (auto &container : notFoundContainers)
+        std::cout << RED << "WARNING: " << YELLOW << container << RESET << " was not found! Skipping..." << std::endl;
+
+    std::cout.flush();
 
-    delete memoryMappedFile;
+    stringStreams.resize(ResourceContainerList.size() + SoundContainerList.size());
+    LoadContainerMods(LoadResourceMods, LoadSoundMods);
+    CommitLoadedMods();
 }
\ No newline at end of file
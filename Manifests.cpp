@@ -0,0 +1,454 @@
+/*
+* This file is part of EternalModLoaderCpp (https://github.com/PowerBall253/EternalModLoaderCpp).
+* Copyright (C) 2021 PowerBall253
+*
+* EternalModLoaderCpp is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* EternalModLoaderCpp is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with EternalModLoaderCpp. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <iostream>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <iomanip>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+#include "miniz/miniz.h"
+#include "EternalModLoader.hpp"
+
+// Name of the file caching the zipped mods' fingerprints between runs, in the base directory
+const std::string FingerprintCacheFileName = "EternalModLoader.fingerprints";
+
+/**
+ * @brief Fingerprint of a mod file, and the container it goes into
+ *
+ */
+class ModFileFingerprint {
+public:
+    std::string ContainerName;
+    std::string Entry;
+
+    /**
+     * @brief Construct a new ModFileFingerprint object
+     *
+     * @param containerName Name of the container the mod file goes into
+     * @param entry Manifest line identifying the mod file
+     */
+    ModFileFingerprint(std::string containerName, std::string entry)
+    {
+        ContainerName = containerName;
+        Entry = entry;
+    }
+};
+
+/**
+ * @brief Get the size, inode and modification time of a file, identifying its current state
+ *
+ * @param path Path to the file
+ * @return File's state, or an empty string on error
+ */
+std::string GetFileState(const std::string &path)
+{
+    std::stringstream state;
+
+#ifdef _WIN32
+    try {
+        state << std::filesystem::file_size(path) << "\t0\t" << std::filesystem::last_write_time(path).time_since_epoch().count();
+    }
+    catch (...) {
+        return "";
+    }
+#else
+    struct stat fileInfo;
+
+    if (stat(path.c_str(), &fileInfo) == -1)
+        return "";
+
+    state << fileInfo.st_size << '\t' << fileInfo.st_ino << '\t'
+        << fileInfo.st_mtim.tv_sec << '.' << std::setfill('0') << std::setw(9) << fileInfo.st_mtim.tv_nsec;
+#endif
+
+    return state.str();
+}
+
+/**
+ * @brief Get the name of the container a mod file goes into, the same way the mod loading functions do
+ *
+ * @param modFilePath Path of the mod file, relative to the zip or the Mods folder, with '/' separators
+ * @return Name of the container, or an empty string if the file isn't a mod file
+ */
+std::string GetModFileContainerName(const std::string &modFilePath)
+{
+    if (modFilePath.empty() || modFilePath.back() == '/')
+        return "";
+
+    std::vector<std::string> modFilePathParts = SplitString(modFilePath, '/');
+
+    if (modFilePathParts.size() < 2)
+        return "";
+
+    std::string resourceName = modFilePathParts[0];
+
+    if (ToLower(resourceName) == "generated")
+        resourceName = "gameresources";
+
+    return resourceName;
+}
+
+/**
+ * @brief Fingerprint the files of a zipped mod from its central directory, without extracting them
+ *
+ * Each file is identified by the zip, its path, CRC-32 and sizes, plus the CRC-32 of the mod's EternalMod.json,
+ * which holds its load priority.
+ *
+ * @param zippedMod Zipped mod path
+ * @param fingerprints Vector to push the fingerprints to
+ * @return True on success, false otherwise
+ */
+bool FingerprintZippedMod(const std::string &zippedMod, std::vector<ModFileFingerprint> &fingerprints)
+{
+    mz_zip_archive modZip;
+    mz_zip_zero_struct(&modZip);
+
+    if (!mz_zip_reader_init_file(&modZip, zippedMod.c_str(), 0))
+        return false;
+
+    std::vector<mz_zip_archive_file_stat> zipEntryStats(mz_zip_reader_get_num_files(&modZip));
+    mz_uint32 modJsonCrc = 0;
+
+    for (mz_uint i = 0; i < zipEntryStats.size(); i++) {
+        if (!mz_zip_reader_file_stat(&modZip, i, &zipEntryStats[i])) {
+            mz_zip_reader_end(&modZip);
+            return false;
+        }
+
+        std::string zipEntryName = zipEntryStats[i].m_filename;
+
+        if (ToLower(zipEntryName) == "eternalmod.json")
+            modJsonCrc = zipEntryStats[i].m_crc32;
+    }
+
+    mz_zip_reader_end(&modZip);
+
+    std::string modName = std::filesystem::path(zippedMod).filename().string();
+
+    for (auto &zipEntryStat : zipEntryStats) {
+        std::string containerName = GetModFileContainerName(zipEntryStat.m_filename);
+
+        if (containerName.empty())
+            continue;
+
+        std::stringstream entry;
+        entry << "zip\t" << modName << '\t' << std::hex << modJsonCrc << '\t' << zipEntryStat.m_filename << '\t'
+            << zipEntryStat.m_crc32 << '\t' << std::dec << zipEntryStat.m_comp_size << '\t' << zipEntryStat.m_uncomp_size;
+
+        fingerprints.push_back(ModFileFingerprint(containerName, entry.str()));
+    }
+
+    return true;
+}
+
+/**
+ * @brief Load the zipped mods' fingerprints cached by the last run
+ *
+ * @return Map of the cached fingerprints, keyed by the zip's path and state
+ */
+std::map<std::string, std::vector<ModFileFingerprint>> LoadFingerprintCache()
+{
+    std::map<std::string, std::vector<ModFileFingerprint>> fingerprintCache;
+    std::ifstream cacheFile(BasePath + FingerprintCacheFileName, std::ios::binary);
+    std::string line;
+
+    while (std::getline(cacheFile, line)) {
+        if (!StartsWith(line, "mod\t"))
+            continue;
+
+        std::string key = line.substr(4);
+        size_t count = 0;
+
+        if (!std::getline(cacheFile, line))
+            break;
+
+        try {
+            count = std::stoull(line);
+        }
+        catch (...) {
+            break;
+        }
+
+        std::vector<ModFileFingerprint> &fingerprints = fingerprintCache[key];
+
+        for (size_t i = 0; i < count && std::getline(cacheFile, line); i++) {
+            size_t tab = line.find('\t');
+
+            if (tab != std::string::npos)
+                fingerprints.push_back(ModFileFingerprint(line.substr(0, tab), line.substr(tab + 1)));
+        }
+    }
+
+    return fingerprintCache;
+}
+
+/**
+ * @brief Cache the zipped mods' fingerprints for the next run
+ *
+ * @param fingerprintCache Map of the fingerprints, keyed by the zip's path and state
+ */
+void SaveFingerprintCache(std::map<std::string, std::vector<ModFileFingerprint>> &fingerprintCache)
+{
+    std::ofstream cacheFile(BasePath + FingerprintCacheFileName, std::ios::binary);
+
+    for (auto &[key, fingerprints] : fingerprintCache) {
+        cacheFile << "mod\t" << key << '\n' << fingerprints.size() << '\n';
+
+        for (auto &fingerprint : fingerprints)
+            cacheFile << fingerprint.ContainerName << '\t' << fingerprint.Entry << '\n';
+    }
+}
+
+/**
+ * @brief Build the manifest of the mods to load into each container, from the mod files' fingerprints
+ *
+ * Zipped mods are fingerprinted from their central directory, reusing the last run's fingerprints if the zip is unchanged,
+ * and loose mod files from their size, inode and modification time, so nothing is extracted or read.
+ * Each manifest holds the loader version and the options affecting the container's contents,
+ * then one line per mod file, sorted so it doesn't depend on the order mods are found in.
+ *
+ * @param zippedMods Zipped mod paths
+ * @param unzippedMods Loose mod file paths
+ */
+void BuildContainerManifests(std::vector<std::string> &zippedMods, std::vector<std::string> &unzippedMods)
+{
+    std::map<std::string, std::vector<ModFileFingerprint>> fingerprintCache = LoadFingerprintCache();
+    std::map<std::string, std::vector<ModFileFingerprint>> newFingerprintCache;
+    std::map<std::string, std::vector<std::string>> containerEntries;
+
+    for (auto &zippedMod : zippedMods) {
+        std::string key = zippedMod + '\t' + GetFileState(zippedMod);
+        auto cachedFingerprints = fingerprintCache.find(key);
+        std::vector<ModFileFingerprint> fingerprints;
+
+        if (cachedFingerprints != fingerprintCache.end())
+            fingerprints = std::move(cachedFingerprints->second);
+        else if (!FingerprintZippedMod(zippedMod, fingerprints))
+            continue;
+
+        for (auto &fingerprint : fingerprints)
+            containerEntries[fingerprint.ContainerName].push_back(fingerprint.Entry);
+
+        newFingerprintCache[key] = std::move(fingerprints);
+    }
+
+    for (auto &unzippedMod : unzippedMods) {
+        // Relative to the Mods folder, so the manifest doesn't depend on how the game directory was given
+        std::string modFilePath = GetLooseModFileName(unzippedMod);
+        std::string containerName = GetModFileContainerName(modFilePath);
+
+        if (!containerName.empty())
+            containerEntries[containerName].push_back("loose\t" + modFilePath + '\t' + GetFileState(unzippedMod));
+    }
+
+    SaveFingerprintCache(newFingerprintCache);
+
+    for (auto &[containerName, entries] : containerEntries) {
+        std::sort(entries.begin(), entries.end());
+
+        std::stringstream manifest;
+        manifest << "version\t" << Version << '\n';
+        manifest << "options\t" << SlowMode << InPlaceOverwrite << CompressTextures << '\n';
+
+        for (auto &entry : entries)
+            manifest << entry << '\n';
+
+        ContainerManifests[containerName] = manifest.str();
+    }
+}
+
+/**
+ * @brief Get the mod files listed in a container's manifest, with their fingerprints
+ *
+ * @param manifest Manifest of the mods loaded into the container
+ * @return Map of the mod files' manifest lines, keyed by the mod file's zip and path, or its path for loose files
+ */
+std::map<std::string, std::string> GetManifestModFiles(const std::string &manifest)
+{
+    std::map<std::string, std::string> modFiles;
+    std::stringstream manifestStream(manifest);
+    std::string line;
+
+    while (std::getline(manifestStream, line)) {
+        std::vector<std::string> fields = SplitString(line, '\t');
+
+        if (fields[0] == "zip" && fields.size() > 3)
+            modFiles[fields[1] + '\t' + fields[3]] = line;
+        else if (fields[0] == "loose" && fields.size() > 1)
+            modFiles[fields[1]] = line;
+    }
+
+    return modFiles;
+}
+
+/**
+ * @brief Check if a container must be restored before loading its new mods on top of the mods loaded into it
+ *
+ * Removed mod files leave their data behind, and EternalMod strings and assets info files are merged
+ * into the container's data, so a changed one would be merged again on top of its old version.
+ *
+ * @param oldManifest Manifest of the mods loaded into the container
+ * @param newManifest Manifest of the mods to load into the container
+ * @return True if mod files were removed, or EternalMod files changed, false otherwise
+ */
+bool IsRestoreNeeded(const std::string &oldManifest, const std::string &newManifest)
+{
+    std::map<std::string, std::string> newModFiles = GetManifestModFiles(newManifest);
+
+    for (auto &[modFile, line] : GetManifestModFiles(oldManifest)) {
+        auto newModFile = newModFiles.find(modFile);
+
+        if (newModFile == newModFiles.end())
+            return true;
+
+        std::vector<std::string> modFilePathParts = SplitString(modFile.substr(modFile.find('\t') + 1), '/');
+
+        if (modFilePathParts.size() > 1 && ToLower(modFilePathParts[1]) == "eternalmod" && newModFile->second != line)
+            return true;
+    }
+
+    return false;
+}
+
+/**
+ * @brief Get the path to the container with the given name
+ *
+ * @param containerName Name of the resource or sound container
+ * @return Path to the container, or an empty string if not found
+ */
+std::string PathToContainer(const std::string &containerName)
+{
+    std::string containerPath = PathToResourceContainer(containerName + ".resources");
+
+    if (containerPath.empty())
+        containerPath = PathToSoundContainer(containerName);
+
+    return containerPath;
+}
+
+/**
+ * @brief Restore the containers the new mods can't be loaded on top of from their snapshot
+ *
+ * @param previousManifests Manifests of the mods loaded by the last run, keyed by the container's name
+ * @return Number of containers restored
+ */
+int32_t RestoreChangedContainers(const std::map<std::string, std::string> &previousManifests)
+{
+    int32_t restoredCount = 0;
+
+    for (auto &[containerName, previousManifest] : previousManifests) {
+        auto modManifest = ContainerManifests.find(containerName);
+
+        if (modManifest != ContainerManifests.end() && !IsRestoreNeeded(previousManifest, modManifest->second))
+            continue;
+
+        std::string containerPath = PathToContainer(containerName);
+
+        if (containerPath.empty() || !RestoreContainer(containerPath))
+            continue;
+
+        if (Verbose)
+            std::cout << "Restored " << YELLOW << containerPath << RESET << "." << '\n';
+
+        restoredCount++;
+    }
+
+    return restoredCount;
+}
+
+/**
+ * @brief Find the containers left as the last run wrote them, with the same mods, so their mod files aren't even extracted
+ *
+ * @return Number of containers that can be skipped
+ */
+int32_t FindUpToDateContainers()
+{
+    for (auto &[containerName, modManifest] : ContainerManifests) {
+        std::string containerPath = PathToContainer(containerName);
+
+        if (containerPath.empty())
+            continue;
+
+        std::ifstream manifestFile(containerPath + ".manifest", std::ios::binary);
+
+        if (!manifestFile)
+            continue;
+
+        std::stringstream manifest;
+        manifest << manifestFile.rdbuf();
+
+        std::string containerState = GetFileState(containerPath);
+
+        if (!containerState.empty() && manifest.str() == modManifest + "container\t" + containerState + '\n')
+            UpToDateContainers.insert(containerName);
+    }
+
+    return UpToDateContainers.size();
+}
+
+/**
+ * @brief Write the manifest of the mods loaded into the container next to it, or delete it if loading them failed
+ *
+ * Must be called once the container's changes are complete, since it records the container's state.
+ *
+ * @param containerName Name of the container
+ * @param containerPath Path to the container
+ * @param wasCommitted Whether the mods were loaded successfully
+ */
+void WriteContainerManifest(const std::string &containerName, const std::string &containerPath, bool wasCommitted)
+{
+    std::string manifestPath = containerPath + ".manifest";
+    std::string containerState = GetFileState(containerPath);
+    auto modManifest = ContainerManifests.find(containerName);
+
+    try {
+        if (!wasCommitted || containerState.empty() || modManifest == ContainerManifests.end()) {
+            std::filesystem::remove(manifestPath);
+            return;
+        }
+
+        std::ofstream manifestFile(manifestPath, std::ios::binary);
+        manifestFile << modManifest->second << "container\t" << containerState << '\n';
+    }
+    catch (...) {
+        std::cout << RED << "WARNING: " << RESET << "Failed to write " << manifestPath << std::endl;
+    }
+}
+
+/**
+ * @brief Write the manifests of all the containers mods were loaded into
+ *
+ */
+void WriteContainerManifests()
+{
+    for (auto &resourceContainer : ResourceContainerList) {
+        if (!resourceContainer.Path.empty())
+            WriteContainerManifest(resourceContainer.Name, resourceContainer.Path, resourceContainer.WasCommitted);
+    }
+
+    for (auto &soundContainer : SoundContainerList) {
+        if (!soundContainer.Path.empty())
+            WriteContainerManifest(soundContainer.Name, soundContainer.Path, soundContainer.WasCommitted);
+    }
+}
\ No newline at end of file
@@ -18,6 +18,7 @@
 
 #include <iostream>
 #include <filesystem>
+#include <algorithm>
 
 #include "MemoryMappedFile/MemoryMappedFile.hpp"
 
@@ -25,29 +26,31 @@
  * @brief Construct a new MemoryMappedFile object
  * 
  * @param filePath Path to the file to map in memory
+ * @param readOnly Whether to map the file for reading only, in which case it can't be changed
  */
-MemoryMappedFile::MemoryMappedFile(std::string filePath)
+MemoryMappedFile::MemoryMappedFile(std::string filePath, bool readOnly)
 {
     FilePath = filePath;
+    ReadOnly = readOnly;
     Size = std::filesystem::file_size(FilePath);
 
     if (Size <= 0)
         throw std::exception();
 
 #ifdef _WIN32
-    FileHandle = CreateFileA(FilePath.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    FileHandle = CreateFileA(FilePath.c_str(), ReadOnly ? GENERIC_READ : GENERIC_READ | GENERIC_WRITE, ReadOnly ? FILE_SHARE_READ : 0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
 
     if (GetLastError() != ERROR_SUCCESS || FileHandle == INVALID_HANDLE_VALUE)
         throw std::exception();
 
-    FileMapping = CreateFileMappingA(FileHandle, NULL, PAGE_READWRITE, *((DWORD*)&Size + 1), *(DWORD*)&Size, NULL);
+    FileMapping = CreateFileMappingA(FileHandle, NULL, ReadOnly ? PAGE_READONLY : PAGE_READWRITE, *((DWORD*)&Size + 1), *(DWORD*)&Size, NULL);
 
     if (GetLastError() != ERROR_SUCCESS || FileMapping == NULL) {
         CloseHandle(FileHandle);
         throw std::exception();
     }
 
-    Mem = (std::byte*)MapViewOfFile(FileMapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+    Mem = (std::byte*)MapViewOfFile(FileMapping, ReadOnly ? FILE_MAP_READ : FILE_MAP_ALL_ACCESS, 0, 0, 0);
 
     if (GetLastError() != ERROR_SUCCESS || Mem == NULL) {
         CloseHandle(FileHandle);
@@ -55,19 +58,17 @@ MemoryMappedFile::MemoryMappedFile(std::string filePath)
         throw std::exception();
     }
 #else
-    FileDescriptor = open(FilePath.c_str(), O_RDWR);
+    FileDescriptor = open(FilePath.c_str(), ReadOnly ? O_RDONLY : O_RDWR);
 
     if (FileDescriptor == -1)
         throw std::exception();
 
-    Mem = (std::byte*)mmap(0, Size, PROT_READ | PROT_WRITE, MAP_SHARED, FileDescriptor, 0);
+    Mem = (std::byte*)mmap(0, Size, ReadOnly ? PROT_READ : PROT_READ | PROT_WRITE, MAP_SHARED, FileDescriptor, 0);
 
     if (Mem == NULL) {
         close(FileDescriptor);
         throw std::exception();
     }
-
-    madvise(Mem, Size, MADV_WILLNEED);
 #endif
 }
 
@@ -99,6 +100,22 @@ void MemoryMappedFile::UnmapFile()
     Mem = NULL;
 }
 
+/**
+ * @brief Write a range of the memory mapped file
+ *
+ * @param offset Offset of the range to write
+ * @param src Bytes to write
+ * @param size Size of the range to write
+ * @return True on success, false if the range is out of bounds or the file is read-only
+ */
+bool MemoryMappedFile::Write(uint64_t offset, const std::byte *src, uint64_t size)
+{
+    if (ReadOnly)
+        return false;
+
+    return ContainerStorage::Write(offset, src, size);
+}
+
 /**
  * @brief Resize the memory mapped file
  * 
@@ -107,6 +124,9 @@ void MemoryMappedFile::UnmapFile()
  */
 bool MemoryMappedFile::ResizeFile(uint64_t newSize)
 {
+    if (ReadOnly)
+        return false;
+
     try {
 #ifdef _WIN32
         UnmapViewOfFile(Mem);
@@ -128,8 +148,6 @@ bool MemoryMappedFile::ResizeFile(uint64_t newSize)
 
         if (Mem == NULL)
             return false;
-
-        madvise(Mem, newSize, MADV_WILLNEED);
 #endif
     }
     catch (...) {
@@ -139,4 +157,90 @@ bool MemoryMappedFile::ResizeFile(uint64_t newSize)
     Size = newSize;
 
     return true;
+}
+
+/**
+ * @brief Grow the memory mapped file
+ * 
+ * @param newSize New size for file
+ * @return True on success, false otherwise
+ */
+bool MemoryMappedFile::Grow(uint64_t newSize)
+{
+    if (newSize < Size)
+        return false;
+
+    return ResizeFile(newSize);
+}
+
+/**
+ * @brief Truncate the memory mapped file
+ * 
+ * @param newSize New size for file
+ * @return True on success, false otherwise
+ */
+bool MemoryMappedFile::Truncate(uint64_t newSize)
+{
+    if (newSize > Size || ReadOnly)
+        return false;
+
+#ifdef _WIN32
+    // The mapping must be closed for the file to shrink
+    UnmapViewOfFile(Mem);
+    CloseHandle(FileMapping);
+
+    LARGE_INTEGER distance;
+    distance.QuadPart = newSize;
+
+    if (!SetFilePointerEx(FileHandle, distance, NULL, FILE_BEGIN) || !SetEndOfFile(FileHandle))
+        return false;
+
+    FileMapping = CreateFileMappingA(FileHandle, NULL, PAGE_READWRITE, *((DWORD*)&newSize + 1), *(DWORD*)&newSize, NULL);
+
+    if (GetLastError() != ERROR_SUCCESS || FileMapping == NULL)
+        return false;
+
+    Mem = (std::byte*)MapViewOfFile(FileMapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+
+    if (GetLastError() != ERROR_SUCCESS || Mem == NULL)
+        return false;
+
+    Size = newSize;
+    return true;
+#else
+    return ResizeFile(newSize);
+#endif
+}
+
+/**
+ * @brief Flush the changes to the file to disk
+ * 
+ * @return True on success, false otherwise
+ */
+bool MemoryMappedFile::Sync()
+{
+#ifdef _WIN32
+    return FlushViewOfFile(Mem, 0) && FlushFileBuffers(FileHandle);
+#else
+    return msync(Mem, Size, MS_SYNC) == 0 && fsync(FileDescriptor) == 0;
+#endif
+}
+
+/**
+ * @brief Start reading the given range of the file in the background
+ * 
+ * @param offset Offset of the range to read
+ * @param size Size of the range to read
+ */
+void MemoryMappedFile::Prefetch(uint64_t offset, uint64_t size)
+{
+#ifndef _WIN32
+    if (offset >= Size)
+        return;
+
+    size = std::min(size, Size - offset);
+    uint64_t pageOffset = offset % sysconf(_SC_PAGESIZE);
+
+    madvise(Mem + offset - pageOffset, size + pageOffset, MADV_WILLNEED);
+#endif
 }
\ No newline at end of file
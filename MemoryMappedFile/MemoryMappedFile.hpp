@@ -28,21 +28,26 @@
 #include <sys/mman.h>
 #endif
 
+#include "ContainerStorage/ContainerStorage.hpp"
+
 /**
  * @brief Cross platform memory mapped file class
  * 
  */
-class MemoryMappedFile {
+class MemoryMappedFile : public ContainerStorage {
 public:
-    std::string FilePath;
-    std::byte *Mem;
-    uint64_t Size = 0;
+    bool ReadOnly = false;
 
-    MemoryMappedFile(std::string filePath);
+    MemoryMappedFile(std::string filePath, bool readOnly = false);
     ~MemoryMappedFile();
 
     void UnmapFile();
+    bool Write(uint64_t offset, const std::byte *src, uint64_t size);
     bool ResizeFile(uint64_t newSize);
+    bool Grow(uint64_t newSize);
+    bool Truncate(uint64_t newSize);
+    bool Sync();
+    void Prefetch(uint64_t offset, uint64_t size);
 private:
 #ifdef _WIN32
     HANDLE FileHandle;
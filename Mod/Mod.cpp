@@ -39,6 +39,8 @@ Mod::Mod(std::string name)
  */
 Mod::Mod(std::string name, std::string &json)
 {
+    Name = name;
+
     jsonxx::Object modJson;
     modJson.parse(json);
 
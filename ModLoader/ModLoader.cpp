@@ -0,0 +1,581 @@
+/*
+* This file is part of EternalModLoaderCpp (https://github.com/PowerBall253/EternalModLoaderCpp).
+* Copyright (C) 2021 PowerBall253
+*
+* EternalModLoaderCpp is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* EternalModLoaderCpp is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with EternalModLoaderCpp. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <iostream>
+#include <filesystem>
+#include <chrono>
+#include <future>
+#include <sstream>
+
+#include "ModLoader/ModLoader.hpp"
+
+namespace chrono = std::chrono;
+
+const int32_t Version = 9;
+const std::string ResourceDataFileName = "rs_data";
+
+char Separator = std::filesystem::path::preferred_separator;
+std::string BasePath;
+std::string ModsPath;
+bool Verbose = false;
+bool SlowMode = false;
+bool CompressTextures = false;
+bool MultiThreading = true;
+bool StreamingStores = false;
+bool InPlaceOverwrite = false;
+WriteBackend PayloadWriteBackend = WriteBackend::Mmap;
+bool DirectIo = false;
+bool MemoryOnly = false;
+DurabilityMode Durability = DurabilityMode::None;
+bool Incremental = true;
+bool PlanOnly = false;
+bool ShareZipEntries = false;
+std::atomic<int64_t> ContainerSyncTime = 0;
+std::vector<ContainerJournal> PendingJournals;
+
+std::vector<ResourceContainer> ResourceContainerList;
+std::vector<SoundContainer> SoundContainerList;
+ResourceDataIndex ResourceDataMap;
+std::map<std::string, std::string> ContainerManifests;
+std::set<std::string> UpToDateContainers;
+class CompressionCache TextureCompressionCache;
+
+std::vector<std::stringstream> stringStreams;
+int32_t streamIndex = 0;
+
+std::byte *Buffer = NULL;
+int64_t BufferSize = -1;
+
+std::mutex mtx;
+
+extern std::vector<std::string> ResourceContainerPathList;
+
+/**
+ * @brief Get the mod loader
+ *
+ * @return The process' single ModLoader object
+ */
+ModLoader &ModLoader::Get()
+{
+    static ModLoader modLoader;
+    return modLoader;
+}
+
+/**
+ * @brief Destroy the ModLoader object, and free the buffer used for file i/o
+ *
+ */
+ModLoader::~ModLoader()
+{
+    if (Buffer != NULL) {
+        delete[] Buffer;
+        Buffer = NULL;
+    }
+}
+
+/**
+ * @brief Set the game directory to work on and the options to use
+ *
+ * The mods discovered in the previous game directory are forgotten.
+ *
+ * @param gamePath Path to the game directory
+ * @param options Options affecting how mods are loaded
+ */
+void ModLoader::Open(std::string gamePath, ModLoaderOptions options)
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+
+    GamePath = gamePath;
+    Options = options;
+    IsDiscovered = false;
+    IsApplied = false;
+}
+
+/**
+ * @brief Set the options used by the mod loading functions
+ *
+ */
+void ModLoader::UseOptions() const
+{
+    ::Verbose = Options.Verbose;
+    ::SlowMode = Options.SlowMode;
+    ::CompressTextures = Options.CompressTextures;
+    ::MultiThreading = Options.MultiThreading;
+    ::StreamingStores = Options.StreamingStores;
+    ::InPlaceOverwrite = Options.InPlaceOverwrite;
+    ::PayloadWriteBackend = Options.PayloadWriteBackend;
+    ::DirectIo = Options.DirectIo;
+    ::MemoryOnly = Options.MemoryOnly;
+    ::Durability = Options.Durability;
+    ::Incremental = Options.Incremental;
+}
+
+/**
+ * @brief Set the options and base path used by the mod loading functions
+ *
+ * The indexes loaded for another game directory are discarded.
+ *
+ * @return True on success, false if the game directory doesn't exist
+ */
+bool ModLoader::Activate()
+{
+    UseOptions();
+    BasePath = GamePath + Separator + "base" + Separator;
+
+    if (!std::filesystem::exists(BasePath)) {
+        std::cout << RED << "ERROR: " << RESET << "Game directory does not exist!" << std::endl;
+        return false;
+    }
+
+    if (IndexedBasePath != BasePath) {
+        ResourceContainerPathList.clear();
+        ResourceDataMap.Clear();
+
+        if (PackageMapSpecInfo.PackageMapSpec != NULL) {
+            delete PackageMapSpecInfo.PackageMapSpec;
+            PackageMapSpecInfo.PackageMapSpec = NULL;
+        }
+
+        PackageMapSpecInfo.invalidPackageMapSpec = false;
+        IndexedBasePath.clear();
+    }
+
+    // Keep compressed textures between runs
+    TextureCompressionCache.Directory = CompressTextures && !MemoryOnly ? BasePath + "EternalModLoader.texturecache" : "";
+
+    return true;
+}
+
+/**
+ * @brief Find the mods in the game directory's Mods folder, and load the mod files of the containers whose mods changed
+ *
+ * rs_data is parsed, the game directory indexed and the mods found at the same time, unless they already were.
+ * When only listing the containers to modify, the mod files aren't loaded and rs_data isn't parsed.
+ * Before loading mods, the changes left behind by an interrupted run are finished or discarded.
+ *
+ * @param mode What the mods are discovered for
+ * @return True on success, false otherwise
+ */
+bool ModLoader::Discover(DiscoveryMode mode)
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+
+    return DiscoverMods(mode, GamePath + Separator + "Mods");
+}
+
+/**
+ * @brief Find the mods in the given Mods folder, and load the mod files of the containers whose mods changed
+ *
+ * @param mode What the mods are discovered for
+ * @param modsPath Path to the Mods folder
+ * @param restoreChangedContainers Whether to restore the containers the mods loaded by the last run can't be loaded on top of
+ * @return True on success, false otherwise
+ */
+bool ModLoader::DiscoverMods(DiscoveryMode mode, const std::string &modsPath, bool restoreChangedContainers)
+{
+    if (!Activate())
+        return false;
+
+    IsDiscovered = false;
+    IsApplied = false;
+    LastDiscoveryMode = mode;
+    bool listResources = mode == DiscoveryMode::List;
+
+    // Finish or discard the changes left behind by an interrupted run
+    if (!MemoryOnly && mode != DiscoveryMode::Plan)
+        RecoverContainerJournals();
+
+    // Manifests of the mods loaded by the last run, compared to the new ones once they are built
+    std::map<std::string, std::string> previousManifests;
+
+    if (restoreChangedContainers)
+        previousManifests = std::move(ContainerManifests);
+
+    ResetLoadedMods();
+    NotFoundContainers.clear();
+    Timings = ModLoaderTimings();
+
+    // Reserve enough space for all resource/sound containers
+    ResourceContainerList.reserve(80);
+    SoundContainerList.reserve(40);
+
+    // Parse rs_data, index the game directory and find mods at the same time
+    chrono::steady_clock::time_point startupBegin = chrono::steady_clock::now();
+    std::launch startupPolicy = MultiThreading ? std::launch::async : std::launch::deferred;
+    bool isIndexed = IndexedBasePath == BasePath;
+
+    // Parse rs_data, only needed once mods are loaded into the containers
+    std::future<void> resourceDataTask = std::async(startupPolicy, [&]() {
+        if (listResources || (isIndexed && !ResourceDataMap.Empty()))
+            return;
+
+        chrono::steady_clock::time_point resourceDataBegin = chrono::steady_clock::now();
+
+        LoadResourceData();
+
+        chrono::steady_clock::time_point resourceDataEnd = chrono::steady_clock::now();
+        Timings.ResourceData = chrono::duration_cast<chrono::microseconds>(resourceDataEnd - resourceDataBegin).count() / 1000000.0;
+    });
+
+    // Get the resource container paths
+    std::future<void> containerPathsTask = std::async(startupPolicy, [&]() {
+        if (isIndexed)
+            return;
+
+        chrono::steady_clock::time_point containerPathsBegin = chrono::steady_clock::now();
+
+        GetResourceContainerPathList();
+
+        chrono::steady_clock::time_point containerPathsEnd = chrono::steady_clock::now();
+        Timings.ContainerPaths = chrono::duration_cast<chrono::microseconds>(containerPathsEnd - containerPathsBegin).count() / 1000000.0;
+    });
+
+    // Find mods
+    chrono::steady_clock::time_point modDiscoveryBegin = chrono::steady_clock::now();
+
+    std::vector<std::string> zippedMods;
+    std::vector<std::string> unzippedMods;
+
+    try {
+        FindMods(modsPath, zippedMods, unzippedMods);
+    }
+    catch (...) {
+        std::cout << RED << "ERROR: " << RESET << "Failed to look for mods in the 'Mods' folder" << std::endl;
+        ContainerManifests = std::move(previousManifests);
+        return false;
+    }
+
+    chrono::steady_clock::time_point modDiscoveryEnd = chrono::steady_clock::now();
+    Timings.ModDiscovery = chrono::duration_cast<chrono::microseconds>(modDiscoveryEnd - modDiscoveryBegin).count() / 1000000.0;
+
+    // Mods are routed to containers through the path index
+    containerPathsTask.get();
+
+    // Fingerprint the mods without extracting them, and skip the containers whose mods haven't changed since the last run
+    if (!listResources && !MemoryOnly) {
+        BuildContainerManifests(zippedMods, unzippedMods);
+
+        // Restored containers lose their manifest, so they aren't skipped below
+        if (restoreChangedContainers)
+            RestoreChangedContainers(previousManifests);
+
+        if (Incremental && FindUpToDateContainers() > 0) {
+            std::cout << "Skipping " << GREEN << UpToDateContainers.size() << " container(s) " << RESET << "whose mods haven't changed since the last run..." << '\n';
+
+            if (Verbose) {
+                for (auto &containerName : UpToDateContainers)
+                    std::cout << "\tSkipped " << YELLOW << containerName << RESET << '\n';
+            }
+        }
+    }
+
+    // Resolve the conflicts between mods, so the overridden mod files are never extracted
+    if (!listResources)
+        ResolveModConflicts(zippedMods, unzippedMods);
+
+    chrono::steady_clock::time_point startupEnd = chrono::steady_clock::now();
+    Timings.Startup = chrono::duration_cast<chrono::microseconds>(startupEnd - startupBegin).count() / 1000000.0;
+
+    // Load zipped mods
+    chrono::steady_clock::time_point zippedModsBegin = chrono::steady_clock::now();
+
+    LoadZippedMods(zippedMods, listResources, NotFoundContainers);
+
+    chrono::steady_clock::time_point zippedModsEnd = chrono::steady_clock::now();
+    Timings.ZippedMods = chrono::duration_cast<chrono::microseconds>(zippedModsEnd - zippedModsBegin).count() / 1000000.0;
+
+    // Load unzipped mods
+    chrono::steady_clock::time_point unzippedModsBegin = chrono::steady_clock::now();
+
+    LoadUnzippedMods(unzippedMods, listResources, NotFoundContainers);
+
+    chrono::steady_clock::time_point unzippedModsEnd = chrono::steady_clock::now();
+    Timings.UnzippedMods = chrono::duration_cast<chrono::microseconds>(unzippedModsEnd - unzippedModsBegin).count() / 1000000.0;
+
+    // Wait for rs_data to be parsed, if it isn't yet
+    chrono::steady_clock::time_point resourceDataWaitBegin = chrono::steady_clock::now();
+
+    resourceDataTask.get();
+    IndexedBasePath = BasePath;
+
+    chrono::steady_clock::time_point resourceDataWaitEnd = chrono::steady_clock::now();
+    Timings.Startup += chrono::duration_cast<chrono::microseconds>(resourceDataWaitEnd - resourceDataWaitBegin).count() / 1000000.0;
+
+    // Display not found containers
+    if (!listResources) {
+        for (auto &container : NotFoundContainers)
+            std::cout << RED << "WARNING: " << YELLOW << container << RESET << " was not found! Skipping..." << std::endl;
+    }
+
+    std::cout.flush();
+    IsDiscovered = true;
+
+    return true;
+}
+
+/**
+ * @brief Get the containers the discovered mods would modify
+ *
+ * @return Paths to the containers
+ */
+std::vector<std::string> ModLoader::GetContainersToModify()
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    std::vector<std::string> containerPaths;
+
+    if (!IsDiscovered)
+        return containerPaths;
+
+    for (auto &resourceContainer : ResourceContainerList) {
+        if (resourceContainer.Path.empty())
+            continue;
+
+        bool shouldListResource = false;
+
+        for (auto &modFile : resourceContainer.ModFileList) {
+            if (!modFile.IsAssetsInfoJson) {
+                shouldListResource = true;
+                break;
+            }
+
+            if (!modFile.AssetsInfo.has_value())
+                continue;
+
+            if (modFile.AssetsInfo.value().Assets.empty()
+                && modFile.AssetsInfo.value().Layers.empty()
+                && modFile.AssetsInfo.value().Maps.empty())
+                    continue;
+
+            shouldListResource = true;
+            break;
+        }
+
+        if (shouldListResource)
+            containerPaths.push_back(resourceContainer.Path);
+    }
+
+    for (auto &soundContainer : SoundContainerList) {
+        if (!soundContainer.Path.empty())
+            containerPaths.push_back(soundContainer.Path);
+    }
+
+    return containerPaths;
+}
+
+/**
+ * @brief Report the work the discovered mods would do in each container and its predicted time, without modifying any
+ *
+ * The mods must be discovered again afterwards.
+ *
+ * @return True on success, false otherwise
+ */
+bool ModLoader::Plan()
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+
+    if (!IsDiscovered || LastDiscoveryMode == DiscoveryMode::List) {
+        std::cout << RED << "ERROR: " << RESET << "The mods must be discovered before planning." << std::endl;
+        return false;
+    }
+
+    if (SlowMode) {
+        std::cout << RED << "ERROR: " << RESET << "Plan mode can't be used with slow mode." << std::endl;
+        return false;
+    }
+
+    SetBuffer();
+
+    chrono::steady_clock::time_point planBegin = chrono::steady_clock::now();
+
+    // The containers are only read, and the work to do in them is reported instead
+    PlanOnly = true;
+    stringStreams.resize(ResourceContainerList.size() + SoundContainerList.size());
+
+    LoadContainerMods(PlanResourceMods, PlanSoundMods);
+    PrintPlanSummary();
+
+    PlanOnly = false;
+    IsDiscovered = false;
+
+    chrono::steady_clock::time_point planEnd = chrono::steady_clock::now();
+    Timings.ModLoading = chrono::duration_cast<chrono::microseconds>(planEnd - planBegin).count() / 1000000.0;
+
+    return true;
+}
+
+/**
+ * @brief Load the discovered mods into the containers, and record them in the containers' manifests
+ *
+ * The mods must be discovered again afterwards.
+ *
+ * @return True on success, false otherwise
+ */
+bool ModLoader::Apply()
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+
+    if (!IsDiscovered || LastDiscoveryMode != DiscoveryMode::Load) {
+        std::cout << RED << "ERROR: " << RESET << "The mods must be discovered before loading them." << std::endl;
+        return false;
+    }
+
+    ApplyMods();
+
+    TextureCompressionCache.Clear();
+    TextureCompressionCache.Prune();
+
+    return true;
+}
+
+/**
+ * @brief Load the discovered mods into the containers, and commit them
+ *
+ */
+void ModLoader::ApplyMods()
+{
+    SetBuffer();
+
+    chrono::steady_clock::time_point modLoadingBegin = chrono::steady_clock::now();
+
+    stringStreams.resize(ResourceContainerList.size() + SoundContainerList.size());
+    LoadContainerMods(LoadResourceMods, LoadSoundMods);
+
+    Timings.GroupSync = CommitLoadedMods();
+    IsDiscovered = false;
+    IsApplied = true;
+
+    chrono::steady_clock::time_point modLoadingEnd = chrono::steady_clock::now();
+    Timings.ModLoading = chrono::duration_cast<chrono::microseconds>(modLoadingEnd - modLoadingBegin).count() / 1000000.0 - Timings.GroupSync;
+}
+
+/**
+ * @brief Restore all containers to their state before mods were first loaded into them
+ *
+ */
+void ModLoader::Restore()
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+
+    if (!Activate())
+        return;
+
+    IsDiscovered = false;
+    IsApplied = false;
+
+    if (!MemoryOnly)
+        RecoverContainerJournals();
+
+    RestoreContainers();
+}
+
+/**
+ * @brief Remove the data no longer referenced by the game from all containers, or release its disk space
+ *
+ * @param memoryBudget Memory to use for the copy buffers, in bytes
+ * @param punchHoles Whether to punch holes instead of rewriting the containers
+ */
+void ModLoader::Compact(int64_t memoryBudget, bool punchHoles)
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+
+    if (!Activate())
+        return;
+
+    IsDiscovered = false;
+    IsApplied = false;
+
+    if (!MemoryOnly)
+        RecoverContainerJournals();
+
+    if (IndexedBasePath != BasePath) {
+        GetResourceContainerPathList();
+        IndexedBasePath = BasePath;
+    }
+
+    CompactContainers(memoryBudget, punchHoles);
+}
+
+/**
+ * @brief Keep running, and load the mods again into the containers they changed in whenever the Mods folder changes
+ *
+ * The mods must have been applied first. The loader is only held while loading the mods again,
+ * so it can be used from other threads in between.
+ *
+ * @return Exit code indicating failure if watching failed, or 0 if it was stopped with StopWatching()
+ */
+int32_t ModLoader::Watch()
+{
+    std::unique_lock<std::mutex> lock(Mutex);
+
+    if (!IsApplied) {
+        std::cout << RED << "ERROR: " << RESET << "The mods must be loaded before watching them." << std::endl;
+        return 1;
+    }
+
+    if (IsWatching.exchange(true)) {
+        std::cout << RED << "ERROR: " << RESET << "The mods are already being watched." << std::endl;
+        return 1;
+    }
+
+    IsWatchStopRequested = false;
+    std::string modsPath = GamePath + Separator + "Mods";
+    lock.unlock();
+
+    int32_t exitCode = WatchMods(modsPath);
+    IsWatching = false;
+
+    return exitCode;
+}
+
+/**
+ * @brief Make the running Watch() call return, once the mods being loaded again, if any, are loaded
+ *
+ */
+void ModLoader::StopWatching()
+{
+    IsWatchStopRequested = true;
+}
+
+/**
+ * @brief Display the time taken by each stage of the last apply
+ *
+ */
+void ModLoader::PrintTimings() const
+{
+    if (Options.Verbose) {
+        std::cout << GREEN << "rs_data parsed in " << Timings.ResourceData << " seconds.\n";
+        std::cout << "Resource containers indexed in " << Timings.ContainerPaths << " seconds.\n";
+        std::cout << "Mods found in " << Timings.ModDiscovery << " seconds.\n";
+        std::cout << "Startup finished in " << Timings.Startup << " seconds (stages run concurrently).\n";
+        std::cout << "Zipped mods loaded in " << Timings.ZippedMods << " seconds.\n";
+        std::cout << "Unzipped mods loaded in " << Timings.UnzippedMods << " seconds.\n";
+        std::cout << "Injection finished in " << Timings.ModLoading << " seconds.\n";
+
+        if (Options.CompressTextures) {
+            std::cout << "Textures compressed: " << TextureCompressionCache.Misses << ", reused from the cache: "
+                << TextureCompressionCache.Hits << ".\n";
+        }
+    }
+
+    if (Options.Durability == DurabilityMode::Container)
+        std::cout << GREEN << "Containers flushed in " << ContainerSyncTime / 1000000.0 << " seconds (summed over all containers, part of the injection time)." << RESET << '\n';
+    else if (Options.Durability == DurabilityMode::Group)
+        std::cout << GREEN << "Group commit finished in " << Timings.GroupSync << " seconds." << RESET << '\n';
+
+    std::cout << GREEN << "Total time taken: " << Timings.Startup + Timings.ZippedMods + Timings.UnzippedMods + Timings.ModLoading + Timings.GroupSync << " seconds." << RESET << std::endl;
+}
\ No newline at end of file
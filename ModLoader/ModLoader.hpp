@@ -0,0 +1,130 @@
+/*
+* This file is part of EternalModLoaderCpp (https://github.com/PowerBall253/EternalModLoaderCpp).
+* Copyright (C) 2021 PowerBall253
+*
+* EternalModLoaderCpp is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* EternalModLoaderCpp is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with EternalModLoaderCpp. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef MODLOADER_HPP
+#define MODLOADER_HPP
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <mutex>
+#include <atomic>
+
+#include "EternalModLoader.hpp"
+
+/**
+ * @brief Options affecting how mods are loaded
+ *
+ */
+class ModLoaderOptions {
+public:
+    bool Verbose = false;
+    bool SlowMode = false;
+    bool CompressTextures = false;
+    bool MultiThreading = true;
+    bool StreamingStores = false;
+    bool InPlaceOverwrite = false;
+    WriteBackend PayloadWriteBackend = WriteBackend::Mmap;
+    bool DirectIo = false;
+    bool MemoryOnly = false;
+    DurabilityMode Durability = DurabilityMode::None;
+    bool Incremental = true;
+};
+
+/**
+ * @brief Ways to discover the mods to load
+ *
+ */
+enum class DiscoveryMode {
+    Load,
+    Plan,
+    List
+};
+
+/**
+ * @brief Time taken by each stage of the last discovery and apply, in seconds
+ *
+ */
+class ModLoaderTimings {
+public:
+    double ResourceData = 0;
+    double ContainerPaths = 0;
+    double ModDiscovery = 0;
+    double Startup = 0;
+    double ZippedMods = 0;
+    double UnzippedMods = 0;
+    double ModLoading = 0;
+    double GroupSync = 0;
+};
+
+/**
+ * @brief Loads mods into a game directory, in process
+ *
+ * The mod loading functions keep their state in globals shared by the whole process, so there is a single
+ * mod loader, obtained with ModLoader::Get(), and Open() points it at the game directory to work on next.
+ * Mods are discovered first, then either planned or applied. Containers can also be restored or compacted.
+ * The container path index, parsed rs_data and PackageMapSpec file, and texture compression cache are kept
+ * between calls, so mods are loaded again without starting from scratch until another game directory is opened.
+ * Calls from several threads are serialized, except Watch(), which only holds the loader while loading the mods again,
+ * and can be stopped from another thread with StopWatching().
+ */
+class ModLoader {
+public:
+    ModLoaderTimings Timings;
+    std::vector<std::string> NotFoundContainers;
+
+    ModLoader(const ModLoader&) = delete;
+    ModLoader &operator=(const ModLoader&) = delete;
+    ~ModLoader();
+
+    static ModLoader &Get();
+
+    void Open(std::string gamePath, ModLoaderOptions options);
+    bool Discover(DiscoveryMode mode = DiscoveryMode::Load);
+    std::vector<std::string> GetContainersToModify();
+    bool Plan();
+    bool Apply();
+    void Restore();
+    void Compact(int64_t memoryBudget, bool punchHoles);
+    int32_t Watch();
+    void StopWatching();
+    void PrintTimings() const;
+    int32_t RunBatch(const std::string &jobFilePath, ModLoaderOptions options);
+private:
+    std::string GamePath;
+    ModLoaderOptions Options;
+    DiscoveryMode LastDiscoveryMode = DiscoveryMode::Load;
+    bool IsDiscovered = false;
+    bool IsApplied = false;
+    std::mutex Mutex;
+    std::string IndexedBasePath;
+    std::atomic<bool> IsWatching = false;
+    std::atomic<bool> IsWatchStopRequested = false;
+
+    ModLoader() = default;
+
+    void UseOptions() const;
+    bool Activate();
+    bool DiscoverMods(DiscoveryMode mode, const std::string &modsPath, bool restoreChangedContainers = false);
+    void ApplyMods();
+    void ReloadMods();
+    int32_t WatchMods(const std::string &modsPath);
+    bool RunBatchJob(class BatchJob &job);
+};
+
+#endif
\ No newline at end of file
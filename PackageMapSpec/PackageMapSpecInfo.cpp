@@ -28,6 +28,7 @@
 /**
  * @brief Modify the PackageMapSpecInfo file in disk
  * 
+ * The parsed file is kept in memory, for when mods are loaded again in watch mode.
  */
 void PackageMapSpecInfo::ModifyPackageMapSpec()
 {
@@ -51,7 +52,5 @@ void PackageMapSpecInfo::ModifyPackageMapSpec()
             std::cout << "Modified "<< YELLOW << PackageMapSpecPath << RESET << '\n';
             fclose(packageMapSpecFile);
         }
-
-        delete PackageMapSpec;
     }
 }
\ No newline at end of file
@@ -0,0 +1,292 @@
+/*
+* This file is part of EternalModLoaderCpp (https://github.com/PowerBall253/EternalModLoaderCpp).
+* Copyright (C) 2021 PowerBall253
+*
+* EternalModLoaderCpp is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* EternalModLoaderCpp is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with EternalModLoaderCpp. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <iostream>
+#include <algorithm>
+#include <sstream>
+#include <filesystem>
+#include <cstring>
+
+#include "EternalModLoader.hpp"
+
+// Rough throughputs and overheads of the work done while loading mods, used for predictions
+const double WriteBytesPerSecond = 500.0 * 1024 * 1024;
+const double MoveBytesPerSecond = 250.0 * 1024 * 1024;
+const double CompressBytesPerSecond = 50.0 * 1024 * 1024;
+const double FileSeconds = 0.0001;
+const double ContainerSeconds = 0.002;
+
+/**
+ * @brief Predict the time needed to do the given work
+ *
+ * @param work ContainerWork object containing the work to do in a container
+ * @return Predicted time in seconds
+ */
+double EstimateWorkTime(const ContainerWork &work)
+{
+    return ContainerSeconds
+        + (work.ReplacedFiles + work.AddedFiles + work.UnchangedFiles) * FileSeconds
+        + work.WrittenBytes / WriteBytesPerSecond
+        + work.MovedBytes / MoveBytesPerSecond
+        + work.CompressedBytes / CompressBytesPerSecond;
+}
+
+/**
+ * @brief Estimate the work to load the mods into the given resource container, from its mod files only
+ *
+ * The container isn't read, so new files are only expected when an assets info file declares assets,
+ * in which case the chunks overwritten by the new metadata are assumed to take about as much room as it grows by.
+ *
+ * @param resourceContainer ResourceContainer containing the mods to load
+ * @return ContainerWork object containing the estimated work
+ */
+ContainerWork EstimateResourceWork(ResourceContainer &resourceContainer)
+{
+    ContainerWork work;
+    bool addsFiles = false;
+
+    for (auto &modFile : resourceContainer.ModFileList) {
+        if (modFile.IsAssetsInfoJson) {
+            addsFiles = addsFiles || (modFile.AssetsInfo.has_value() && !modFile.AssetsInfo.value().Assets.empty());
+            continue;
+        }
+
+        work.ReplacedFiles++;
+        work.WrittenBytes += modFile.GetSize();
+
+        if (CompressTextures && EndsWith(modFile.Name, ".tga") && !modFile.FileSource.has_value()
+            && (modFile.FileBytes.size() < 8 || std::memcmp(modFile.FileBytes.data(), "DIVINITY", 8) != 0)) {
+                work.CompressedBytes += modFile.FileBytes.size();
+        }
+    }
+
+    // Each new file takes an info entry, a name and its name ids in the metadata
+    if (addsFiles) {
+        for (auto &modFile : resourceContainer.ModFileList) {
+            if (modFile.IsAssetsInfoJson && modFile.AssetsInfo.has_value()) {
+                for (auto &assetsInfoAssets : modFile.AssetsInfo.value().Assets)
+                    work.MovedBytes += 0x90 + 8 + assetsInfoAssets.Name.size() + 1 + 16;
+            }
+        }
+    }
+
+    return work;
+}
+
+/**
+ * @brief Estimate the work to load the mods into the given sound container, from its mod files only
+ *
+ * @param soundContainer SoundContainer containing the mods to load
+ * @return ContainerWork object containing the estimated work
+ */
+ContainerWork EstimateSoundWork(SoundContainer &soundContainer)
+{
+    ContainerWork work;
+
+    for (auto &soundModFile : soundContainer.ModFileList) {
+        std::string soundExtension = std::filesystem::path(soundModFile.Name).extension().string();
+
+        work.ReplacedFiles++;
+        work.WrittenBytes += soundModFile.FileBytes.size();
+
+        if (soundExtension != ".wem" && soundExtension != ".ogg" && soundExtension != ".opus")
+            work.CompressedBytes += soundModFile.FileBytes.size();
+    }
+
+    work.AppendedBytes = work.WrittenBytes;
+
+    return work;
+}
+
+/**
+ * @brief Print the work to do in the given container
+ *
+ * @param path Path to the container
+ * @param work ContainerWork object containing the work to do in the container
+ * @param os StringStream to output to
+ */
+void PrintContainerPlan(const std::string &path, const ContainerWork &work, std::stringstream &os)
+{
+    os << "Plan for " << YELLOW << path << RESET << ":" << '\n';
+    os << "\tFiles: " << GREEN << work.ReplacedFiles << RESET << " replaced, " << GREEN << work.AddedFiles << RESET << " added, "
+        << GREEN << work.UnchangedFiles << RESET << " unchanged" << '\n';
+    os << "\tBytes to write: " << GREEN << work.WrittenBytes << RESET << " (" << work.AppendedBytes << " appended, "
+        << work.ReclaimedBytes << " in reused space)" << '\n';
+
+    if (work.MovedBytes > 0)
+        os << "\tBytes to move to make room for the new metadata: " << GREEN << work.MovedBytes << RESET << '\n';
+
+    if (work.CompressedBytes > 0)
+        os << "\tBytes to compress or encode: " << GREEN << work.CompressedBytes << RESET << '\n';
+
+    if (work.BlangEdits > 0 || work.MapResourcesEdits > 0) {
+        os << "\tEdits: " << GREEN << work.BlangEdits << RESET << " blang string(s), "
+            << GREEN << work.MapResourcesEdits << RESET << " mapresources entry(ies)" << '\n';
+    }
+
+    os << "\tPredicted time: " << GREEN << EstimateWorkTime(work) << " seconds" << RESET << '\n';
+}
+
+/**
+ * @brief Work out what loading the mods would do to the given resource container, without modifying it
+ *
+ * The container is mapped for reading only, metadata changes are staged and dropped,
+ * and payload writes are only counted.
+ *
+ * @param resourceContainer ResourceContainer containing the resource to plan the mods for
+ */
+void PlanResourceMods(ResourceContainer &resourceContainer)
+{
+    mtx.lock();
+    std::stringstream &os = stringStreams[streamIndex++];
+    mtx.unlock();
+
+    if (!MultiThreading)
+        ((std::ostream&)os).rdbuf(std::cout.rdbuf());
+
+    ContainerStorage *storage;
+
+    try {
+        storage = new MemoryMappedFile(resourceContainer.Path, true);
+    }
+    catch (...) {
+        os << RED << "ERROR: " << RESET << "Failed to open " << YELLOW << resourceContainer.Path << RESET << " for reading!" << std::endl;
+        return;
+    }
+
+    ReadResource(*storage, resourceContainer);
+    resourceContainer.WriteQueue.Reset(storage->Size);
+    resourceContainer.WriteQueue.DryRun = true;
+
+    if (!PrepareContainerSnapshot(*storage, resourceContainer.DataOffset, resourceContainer.OriginalDataEnd, os)) {
+        delete storage;
+        return;
+    }
+
+    StagedStorage stagedStorage(*storage, resourceContainer.DataOffset);
+
+    std::vector<DataExtent> holes = GetHoles(resourceContainer.LiveExtents,
+        std::max(resourceContainer.DataOffset, resourceContainer.OriginalDataEnd), storage->Size);
+    resourceContainer.DataSectionAllocator.Reset(holes, resourceContainer.DataOffset);
+
+    ReplaceChunks(stagedStorage, resourceContainer, os);
+    AddChunks(stagedStorage, resourceContainer, os);
+    resourceContainer.WriteQueue.Commit(stagedStorage);
+
+    ContainerWork &work = resourceContainer.Work;
+    work.UnchangedFiles = resourceContainer.UnchangedFileCount;
+    work.WrittenBytes = resourceContainer.WriteQueue.CommittedBytes;
+    work.AppendedBytes = resourceContainer.DataSectionAllocator.AppendedBytes;
+    work.ReclaimedBytes = resourceContainer.DataSectionAllocator.ReclaimedBytes;
+
+    PrintContainerPlan(resourceContainer.Path, work, os);
+
+    delete storage;
+}
+
+/**
+ * @brief Work out what loading the mods would do to the given sound container, without modifying it
+ *
+ * @param soundContainer SoundContainer containing the sound container to plan the mods for
+ */
+void PlanSoundMods(SoundContainer &soundContainer)
+{
+    mtx.lock();
+    std::stringstream &os = stringStreams[streamIndex++];
+    mtx.unlock();
+
+    if (!MultiThreading)
+        ((std::ostream&)os).rdbuf(std::cout.rdbuf());
+
+    ContainerStorage *storage;
+
+    try {
+        storage = new MemoryMappedFile(soundContainer.Path, true);
+    }
+    catch (...) {
+        os << RED << "ERROR: " << RESET << "Failed to open " << YELLOW << soundContainer.Path << RESET << " for reading!" << std::endl;
+        return;
+    }
+
+    ReadSoundEntries(*storage, soundContainer);
+    soundContainer.WriteQueue.Reset(storage->Size);
+    soundContainer.WriteQueue.DryRun = true;
+
+    StagedStorage stagedStorage(*storage, soundContainer.MetadataSize);
+
+    ReplaceSounds(stagedStorage, soundContainer, os);
+    soundContainer.WriteQueue.Commit(stagedStorage);
+
+    // Sound mods are always appended
+    ContainerWork &work = soundContainer.Work;
+    work.WrittenBytes = soundContainer.WriteQueue.CommittedBytes;
+    work.AppendedBytes = work.WrittenBytes;
+
+    PrintContainerPlan(soundContainer.Path, work, os);
+
+    delete storage;
+}
+
+/**
+ * @brief Print the totals of the plan, and the containers to modify from the longest to the shortest predicted time
+ *
+ */
+void PrintPlanSummary()
+{
+    std::vector<std::pair<double, std::string>> containerTimes;
+    ContainerWork total;
+
+    auto addWork = [&](const std::string &path, const ContainerWork &work) {
+        if (work.ReplacedFiles == 0 && work.AddedFiles == 0)
+            return;
+
+        containerTimes.push_back(std::make_pair(EstimateWorkTime(work), path));
+        total.ReplacedFiles += work.ReplacedFiles;
+        total.AddedFiles += work.AddedFiles;
+        total.WrittenBytes += work.WrittenBytes;
+        total.MovedBytes += work.MovedBytes;
+        total.CompressedBytes += work.CompressedBytes;
+    };
+
+    for (auto &resourceContainer : ResourceContainerList)
+        addWork(resourceContainer.Path, resourceContainer.Work);
+
+    for (auto &soundContainer : SoundContainerList)
+        addWork(soundContainer.Path, soundContainer.Work);
+
+    std::stable_sort(containerTimes.begin(), containerTimes.end(),
+        [](const std::pair<double, std::string> &time1, const std::pair<double, std::string> &time2) { return time1.first > time2.first; });
+
+    double totalTime = 0;
+
+    for (auto &containerTime : containerTimes)
+        totalTime += containerTime.first;
+
+    std::cout << "Plan: " << GREEN << containerTimes.size() << " container(s) " << RESET << "to modify, "
+        << GREEN << total.ReplacedFiles << RESET << " file(s) to replace, " << GREEN << total.AddedFiles << RESET << " to add, "
+        << GREEN << total.WrittenBytes << " byte(s) " << RESET << "to write, " << GREEN << total.MovedBytes << RESET << " to move and "
+        << GREEN << total.CompressedBytes << RESET << " to compress or encode." << '\n';
+
+    if (PackageMapSpecInfo.WasPackageMapSpecModified)
+        std::cout << "\t" << PackageMapSpecInfo.PackageMapSpecPath << " would be modified." << '\n';
+
+    std::cout << "Predicted time: " << GREEN << totalTime << " seconds " << RESET << "(summed over all containers), largest containers first:" << '\n';
+
+    for (auto &containerTime : containerTimes)
+        std::cout << "\t" << containerTime.first << "s\t" << YELLOW << containerTime.second << RESET << '\n';
+}
\ No newline at end of file
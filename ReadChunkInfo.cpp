@@ -21,34 +21,35 @@
 #include "EternalModLoader.hpp"
 
 /**
- * @brief Read info from the resources file's chunks
+ * @brief Read info from the resources file's chunks, the data extents they reference and how many chunks reference each offset
  * 
- * @param memoryMappedFile MemoryMappedFile object containing the resource to modify
+ * @param storage ContainerStorage object containing the resource to modify
  * @param resourceContainer ResourceContainer object to read data into
  */
-void ReadChunkInfo(MemoryMappedFile &memoryMappedFile, ResourceContainer &resourceContainer)
+void ReadChunkInfo(ContainerStorage &storage, ResourceContainer &resourceContainer)
 {
     int64_t dummy7Off = resourceContainer.Dummy7Offset + (resourceContainer.TypeCount * 4);
 
     int64_t nameId, fileOffset, sizeOffset, sizeZ, size;
     std::byte compressionMode;
     ResourceName name;
+    std::vector<DataExtent> liveExtents;
 
     for (int32_t i = 0; i < resourceContainer.FileCount; i++) {
-        std::copy(memoryMappedFile.Mem + 0x20 + resourceContainer.InfoOffset + (0x90 * i), memoryMappedFile.Mem + 0x20 + resourceContainer.InfoOffset + (0x90 * i) + 8, (std::byte*)&nameId);
+        storage.Read(0x20 + resourceContainer.InfoOffset + (0x90 * i), (std::byte*)&nameId, 8);
 
-        std::copy(memoryMappedFile.Mem + 0x38 + resourceContainer.InfoOffset + (0x90 * i), memoryMappedFile.Mem + 0x38 + resourceContainer.InfoOffset + (0x90 * i) + 8, (std::byte*)&fileOffset);
+        storage.Read(0x38 + resourceContainer.InfoOffset + (0x90 * i), (std::byte*)&fileOffset, 8);
 
         sizeOffset = 0x38 + resourceContainer.InfoOffset + (0x90 * i) + 8;
 
-        std::copy(memoryMappedFile.Mem + 0x38 + resourceContainer.InfoOffset + (0x90 * i) + 8, memoryMappedFile.Mem + 0x38 + resourceContainer.InfoOffset + (0x90 * i) + 16, (std::byte*)&sizeZ);
+        storage.Read(0x38 + resourceContainer.InfoOffset + (0x90 * i) + 8, (std::byte*)&sizeZ, 8);
 
-        std::copy(memoryMappedFile.Mem + 0x38 + resourceContainer.InfoOffset + (0x90 * i) + 16, memoryMappedFile.Mem + 0x38 + resourceContainer.InfoOffset + (0x90 * i) + 24, (std::byte*)&size);
+        storage.Read(0x38 + resourceContainer.InfoOffset + (0x90 * i) + 16, (std::byte*)&size, 8);
 
-        compressionMode = memoryMappedFile.Mem[0x70 + resourceContainer.InfoOffset + 0x90 * i];
+        storage.Read(0x70 + resourceContainer.InfoOffset + 0x90 * i, &compressionMode, 1);
 
         nameId = ((nameId + 1) * 8) + dummy7Off;
-        std::copy(memoryMappedFile.Mem + nameId, memoryMappedFile.Mem + nameId + 8, (std::byte*)&nameId);
+        storage.Read(nameId, (std::byte*)&nameId, 8);
         
         name = resourceContainer.NamesList[nameId];
 
@@ -59,5 +60,10 @@ void ReadChunkInfo(MemoryMappedFile &memoryMappedFile, ResourceContainer &resour
         chunk.Size = size;
         chunk.CompressionMode = compressionMode;
         resourceContainer.ChunkList.push_back(chunk);
+
+        liveExtents.push_back(DataExtent(fileOffset, sizeZ));
+        resourceContainer.ChunkDataReferences[fileOffset]++;
     }
+
+    resourceContainer.LiveExtents = MergeExtents(liveExtents);
 }
\ No newline at end of file
@@ -23,43 +23,43 @@
 /**
  * @brief Read resource data
  * 
- * @param memoryMappedFile MemoryMappedFile object containing the resource to modify
+ * @param storage ContainerStorage object containing the resource to modify
  * @param resourceContainer ResourceContainer object to read data into
  */
-void ReadResource(MemoryMappedFile &memoryMappedFile, ResourceContainer &resourceContainer)
+void ReadResource(ContainerStorage &storage, ResourceContainer &resourceContainer)
 {
     int32_t fileCount;
-    std::copy(memoryMappedFile.Mem + 0x20, memoryMappedFile.Mem + 0x24, (std::byte*)&fileCount);
+    storage.Read(0x20, (std::byte*)&fileCount, 4);
 
     int32_t unknownCount;
-    std::copy(memoryMappedFile.Mem + 0x24, memoryMappedFile.Mem + 0x28, (std::byte*)&unknownCount);
+    storage.Read(0x24, (std::byte*)&unknownCount, 4);
 
     int32_t dummy2Num;
-    std::copy(memoryMappedFile.Mem + 0x28, memoryMappedFile.Mem + 0x2C, (std::byte*)&dummy2Num);
+    storage.Read(0x28, (std::byte*)&dummy2Num, 4);
 
     int32_t stringsSize;
-    std::copy(memoryMappedFile.Mem + 0x38, memoryMappedFile.Mem + 0x3C, (std::byte*)&stringsSize);
+    storage.Read(0x38, (std::byte*)&stringsSize, 4);
 
     int64_t namesOffset;
-    std::copy(memoryMappedFile.Mem + 0x40, memoryMappedFile.Mem + 0x48, (std::byte*)&namesOffset);
+    storage.Read(0x40, (std::byte*)&namesOffset, 8);
 
     int64_t namesEnd;
-    std::copy(memoryMappedFile.Mem + 0x48, memoryMappedFile.Mem + 0x50, (std::byte*)&namesEnd);
+    storage.Read(0x48, (std::byte*)&namesEnd, 8);
 
     int64_t infoOffset;
-    std::copy(memoryMappedFile.Mem + 0x50, memoryMappedFile.Mem + 0x58, (std::byte*)&infoOffset);
+    storage.Read(0x50, (std::byte*)&infoOffset, 8);
 
     int64_t dummy7OffOrg;
-    std::copy(memoryMappedFile.Mem + 0x60, memoryMappedFile.Mem + 0x68, (std::byte*)&dummy7OffOrg);
+    storage.Read(0x60, (std::byte*)&dummy7OffOrg, 8);
 
     int64_t dataOff;
-    std::copy(memoryMappedFile.Mem + 0x68, memoryMappedFile.Mem + 0x70, (std::byte*)&dataOff);
+    storage.Read(0x68, (std::byte*)&dataOff, 8);
 
     int64_t idclOff;
-    std::copy(memoryMappedFile.Mem + 0x74, memoryMappedFile.Mem + 0x7C, (std::byte*)&idclOff);
+    storage.Read(0x74, (std::byte*)&idclOff, 8);
 
     int64_t namesNum;
-    std::copy(memoryMappedFile.Mem + namesOffset, memoryMappedFile.Mem + namesOffset + 8, (std::byte*)&namesNum);
+    storage.Read(namesOffset, (std::byte*)&namesNum, 8);
 
     int64_t namesOffsetEnd = namesOffset + (namesNum + 1) * 8;
     int64_t namesSize = namesEnd - namesOffsetEnd;
@@ -69,7 +69,7 @@ void ReadResource(MemoryMappedFile &memoryMappedFile, ResourceContainer &resourc
     char currentByte;
     
     for (int32_t i = 0; i < namesSize; i++) {
-        currentByte = (char)memoryMappedFile.Mem[namesOffsetEnd+ i];
+        currentByte = (char)storage.Mem[namesOffsetEnd+ i];
 
         if (currentByte == 0 || i == namesSize - 1) {
             if (currentNameBytes.empty())
@@ -103,5 +103,5 @@ void ReadResource(MemoryMappedFile &memoryMappedFile, ResourceContainer &resourc
     resourceContainer.UnknownOffset2 = namesEnd;
     resourceContainer.NamesList = namesList;
 
-    ReadChunkInfo(memoryMappedFile, resourceContainer);
+    ReadChunkInfo(storage, resourceContainer);
 }
\ No newline at end of file
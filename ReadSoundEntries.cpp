@@ -3,29 +3,39 @@
 #include "EternalModLoader.hpp"
 
 /**
- * @brief Read all sound entries in the given sound container
+ * @brief Read all sound entries in the given sound container, and the data extents they reference
  * 
- * @param memoryMappedFile MemoryMappedFile object containing the resource to read from
+ * @param storage ContainerStorage object containing the resource to read from
  * @param soundContainer SoundContainer object to read data from
  */
-void ReadSoundEntries(MemoryMappedFile &memoryMappedFile, SoundContainer &soundContainer)
+void ReadSoundEntries(ContainerStorage &storage, SoundContainer &soundContainer)
 {
     uint32_t infoSize, headerSize;
-    std::copy(memoryMappedFile.Mem + 4, memoryMappedFile.Mem + 8, (std::byte*)&infoSize);
-    std::copy(memoryMappedFile.Mem + 8, memoryMappedFile.Mem + 12, (std::byte*)&headerSize);
+    storage.Read(4, (std::byte*)&infoSize, 4);
+    storage.Read(8, (std::byte*)&headerSize, 4);
+    soundContainer.MetadataSize = (int64_t)infoSize + 12;
 
     int64_t pos = headerSize + 12;
+    std::vector<DataExtent> liveExtents;
 
     for (uint32_t i = 0, j = (infoSize - headerSize) / 32; i < j; i++) {
         pos += 8;
 
         uint32_t soundId;
-        std::copy(memoryMappedFile.Mem + pos, memoryMappedFile.Mem + pos + 4, (std::byte*)&soundId);
+        storage.Read(pos, (std::byte*)&soundId, 4);
         pos += 4;
 
         soundContainer.SoundEntries.push_back(SoundEntry(soundId, pos));
+
+        uint32_t encodedSize, soundOffset;
+        storage.Read(pos, (std::byte*)&encodedSize, 4);
+        storage.Read(pos + 4, (std::byte*)&soundOffset, 4);
+        liveExtents.push_back(DataExtent(soundOffset, encodedSize));
+
         pos += 20;
     }
+
+    soundContainer.LiveExtents = MergeExtents(liveExtents);
 }
 
 std::vector<SoundEntry> GetSoundEntriesToModify(SoundContainer &soundContainer, uint32_t soundModId)
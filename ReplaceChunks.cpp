@@ -20,6 +20,7 @@
 #include <filesystem>
 #include <algorithm>
 #include <cstring>
+#include <set>
 
 #include "jsonxx/jsonxx.h"
 #include "EternalModLoader.hpp"
@@ -29,217 +30,288 @@ const std::string PackageMapSpecJsonFileName = "packagemapspec.json";
 class PackageMapSpecInfo PackageMapSpecInfo;
 
 /**
- * @brief Replace chunks in the given resource file
+ * @brief Start reading the current data of the chunks the mod files replace, in container order
  * 
- * @param memoryMappedFile MemoryMappedFile object containing the resource to modify
+ * @param storage ContainerStorage object containing the resource to modify
  * @param resourceContainer ResourceContainer object containing the resources's data
+ */
+void PrefetchChunkData(ContainerStorage &storage, ResourceContainer &resourceContainer)
+{
+    std::set<std::string> modFileNames;
+
+    for (auto &modFile : resourceContainer.ModFileList) {
+        if (modFile.IsAssetsInfoJson)
+            continue;
+
+        if (modFile.IsBlangJson) {
+            std::string blangFileName = modFile.Name.substr(modFile.Name.find('/') + 1);
+            modFileNames.insert(std::filesystem::path(blangFileName).replace_extension(".blang").string());
+            continue;
+        }
+
+        modFileNames.insert(modFile.Name);
+    }
+
+    std::vector<DataExtent> chunkExtents;
+
+    for (auto &chunk : resourceContainer.ChunkList) {
+        if (modFileNames.find(chunk.ResourceName.FullFileName) == modFileNames.end()
+            && modFileNames.find(chunk.ResourceName.NormalizedFileName) == modFileNames.end())
+                continue;
+
+        int64_t fileOffset, size;
+        storage.Read(chunk.FileOffset, (std::byte*)&fileOffset, 8);
+        storage.Read(chunk.FileOffset + 8, (std::byte*)&size, 8);
+        chunkExtents.push_back(DataExtent(fileOffset, size));
+    }
+
+    for (auto &extent : MergeExtents(chunkExtents))
+        storage.Prefetch(extent.Offset, extent.Size);
+}
+
+/**
+ * @brief Add the extra resources of a mod file's assets info to the maps in the PackageMapSpec file, or remove them
+ * 
+ * @param resourceContainer ResourceContainer object the mod file belongs to
+ * @param modFile ResourceModFile object containing the assets info
  * @param os StringStream to output to
  */
-void ReplaceChunks(MemoryMappedFile &memoryMappedFile, ResourceContainer &resourceContainer, std::stringstream &os)
+void AddExtraResources(ResourceContainer &resourceContainer, ResourceModFile &modFile, std::stringstream &os)
 {
-    ResourceChunk *mapResourcesChunk = NULL;
-    MapResourcesFile *mapResourcesFile = NULL;
-    std::vector<std::byte> originalDecompressedMapResources;
-    bool invalidMapResources = false;
-    int32_t fileCount = 0;
-    std::map<std::string, BlangFileEntry> blangFileEntries;
+    if (PackageMapSpecInfo.PackageMapSpec == NULL && !PackageMapSpecInfo.invalidPackageMapSpec) {
+        PackageMapSpecInfo.PackageMapSpecPath = BasePath + PackageMapSpecJsonFileName;
+        FILE *packageMapSpecFile = fopen(PackageMapSpecInfo.PackageMapSpecPath.c_str(), "rb");
+
+        if (!packageMapSpecFile) {
+            os << RED << "ERROR: " << RESET << PackageMapSpecInfo.PackageMapSpecPath << " not found while trying to add extra resources for level "
+                << resourceContainer.Name << '\n';
+            PackageMapSpecInfo.invalidPackageMapSpec = true;
+        }
+        else {
+            int64_t filesize = std::filesystem::file_size(PackageMapSpecInfo.PackageMapSpecPath);
+            std::vector<std::byte> packageMapSpecBytes(filesize);
 
-    std::stable_sort(resourceContainer.ModFileList.begin(), resourceContainer.ModFileList.end(),
-        [](const ResourceModFile &resource1, const ResourceModFile &resource2) { return resource1.Parent.LoadPriority > resource2.Parent.LoadPriority; });
+            if (fread(packageMapSpecBytes.data(), 1, filesize, packageMapSpecFile) != filesize) {
+                os << RED << "ERROR: " << RESET << "Failed to read data from " << PackageMapSpecInfo.PackageMapSpecPath
+                    << " while trying to add extra resources for level " << resourceContainer.Name << '\n';
+                PackageMapSpecInfo.invalidPackageMapSpec = true;
+            }
 
-    for (auto &modFile : resourceContainer.ModFileList) {
-        ResourceChunk *chunk = NULL;
+            fclose(packageMapSpecFile);
 
-        if (modFile.IsAssetsInfoJson && modFile.AssetsInfo.has_value()) {
+            try {
+                std::string packageMapSpecJson((char*)packageMapSpecBytes.data(), packageMapSpecBytes.size());
+                PackageMapSpecInfo.PackageMapSpec = new PackageMapSpec(packageMapSpecJson);
+            }
+            catch (...) {
+                os << RED << "ERROR: " << RESET << "Failed to parse " << PackageMapSpecInfo.PackageMapSpecPath << '\n';
+                PackageMapSpecInfo.invalidPackageMapSpec = true;
+            }
+        }
+    }
 
-            if (!modFile.AssetsInfo->Resources.empty()) {
-                mtx.lock();
+    if (PackageMapSpecInfo.PackageMapSpec != NULL && !PackageMapSpecInfo.invalidPackageMapSpec) {
+        for (auto &extraResource : modFile.AssetsInfo->Resources) {
+            std::string extraResourcePath = PathToResourceContainer(extraResource.Name);
 
-                if (PackageMapSpecInfo.PackageMapSpec == NULL && !PackageMapSpecInfo.invalidPackageMapSpec) {
-                    PackageMapSpecInfo.PackageMapSpecPath = BasePath + PackageMapSpecJsonFileName;
-                    FILE *packageMapSpecFile = fopen(PackageMapSpecInfo.PackageMapSpecPath.c_str(), "rb");
+            if (extraResourcePath.empty()) {
+                os << RED << "WARNING: " << RESET << "Trying to add non-existing extra resource " << extraResource.Name
+                    << " to " << resourceContainer.Name << ", skipping" << '\n';
+                continue;
+            }
 
-                    if (!packageMapSpecFile) {
-                        os << RED << "ERROR: " << RESET << PackageMapSpecInfo.PackageMapSpecPath << " not found while trying to add extra resources for level "
-                            << resourceContainer.Name << '\n';
-                        PackageMapSpecInfo.invalidPackageMapSpec = true;
-                    }
-                    else {
-                        int64_t filesize = std::filesystem::file_size(PackageMapSpecInfo.PackageMapSpecPath);
-                        std::vector<std::byte> packageMapSpecBytes(filesize);
+            int32_t fileIndex = -1;
+            int32_t mapIndex = -1;
 
-                        if (fread(packageMapSpecBytes.data(), 1, filesize, packageMapSpecFile) != filesize) {
-                            os << RED << "ERROR: " << RESET << "Failed to read data from " << PackageMapSpecInfo.PackageMapSpecPath
-                                << " while trying to add extra resources for level " << resourceContainer.Name << '\n';
-                            PackageMapSpecInfo.invalidPackageMapSpec = true;
-                        }
+            for (int32_t i = 0; i < PackageMapSpecInfo.PackageMapSpec->Files.size(); i++) {
+                if (PackageMapSpecInfo.PackageMapSpec->Files[i].Name.find(extraResource.Name) != std::string::npos) {
+                    fileIndex = i;
+                    break;
+                }
+            }
 
-                        fclose(packageMapSpecFile);
+            std::string modFileMapName = std::filesystem::path(modFile.Name).stem().string();
 
-                        try {
-                            std::string packageMapSpecJson((char*)packageMapSpecBytes.data(), packageMapSpecBytes.size());
-                            PackageMapSpecInfo.PackageMapSpec = new PackageMapSpec(packageMapSpecJson);
-                        }
-                        catch (...) {
-                            os << RED << "ERROR: " << RESET << "Failed to parse " << PackageMapSpecInfo.PackageMapSpecPath << '\n';
-                            PackageMapSpecInfo.invalidPackageMapSpec = true;
-                        }
-                    }
+            if (StartsWith(resourceContainer.Name, "dlc_hub")) {
+                modFileMapName = "game/dlc/hub/hub";
+            }
+            else if (StartsWith(resourceContainer.Name, "hub")) {
+                modFileMapName = "game/hub/hub";
+            }
+
+            for (int32_t i = 0; i < PackageMapSpecInfo.PackageMapSpec->Maps.size(); i++) {
+                if (EndsWith(PackageMapSpecInfo.PackageMapSpec->Maps[i].Name, modFileMapName)) {
+                    mapIndex = i;
+                    break;
                 }
+            }
 
-                if (PackageMapSpecInfo.PackageMapSpec != NULL && !PackageMapSpecInfo.invalidPackageMapSpec) {
-                    for (auto &extraResource : modFile.AssetsInfo->Resources) {
-                        std::string extraResourcePath = PathToResourceContainer(extraResource.Name);
+            if (fileIndex == -1) {
+                os << RED << "ERROR: " << RESET << "Invalid extra resource " << extraResource.Name << ", skipping" << '\n';
+                continue;
+            }
 
-                        if (extraResourcePath.empty()) {
-                            os << RED << "WARNING: " << RESET << "Trying to add non-existing extra resource " << extraResource.Name
-                                << " to " << resourceContainer.Name << ", skipping" << '\n';
-                            continue;
-                        }
+            if (mapIndex == -1) {
+                os << RED << "ERROR: " << RESET << "Map reference not found for " << modFile.Name << ", skipping" << '\n';
+                continue;
+            }
 
-                        int32_t fileIndex = -1;
-                        int32_t mapIndex = -1;
+            if (extraResource.Remove) {
+                bool mapFileRefRemoved = false;
 
-                        for (int32_t i = 0; i < PackageMapSpecInfo.PackageMapSpec->Files.size(); i++) {
-                            if (PackageMapSpecInfo.PackageMapSpec->Files[i].Name.find(extraResource.Name) != std::string::npos) {
-                                fileIndex = i;
-                                break;
-                            }
-                        }
+                for (int32_t i = PackageMapSpecInfo.PackageMapSpec->MapFileRefs.size() - 1; i >= 0; i--) {
+                    if (PackageMapSpecInfo.PackageMapSpec->MapFileRefs[i].File == fileIndex && PackageMapSpecInfo.PackageMapSpec->MapFileRefs[i].Map == mapIndex) {
+                        PackageMapSpecInfo.PackageMapSpec->MapFileRefs.erase(PackageMapSpecInfo.PackageMapSpec->MapFileRefs.begin() + i);
+                        mapFileRefRemoved = true;
+                        break;
+                    }
+                }
 
-                        std::string modFileMapName = std::filesystem::path(modFile.Name).stem().string();
+                if (mapFileRefRemoved) {
+                    os << "\tRemoved resource " << PackageMapSpecInfo.PackageMapSpec->Files[fileIndex].Name << " to be loaded in map "
+                        << PackageMapSpecInfo.PackageMapSpec->Maps[mapIndex].Name << '\n';
+                }
+                else {
+                    if (Verbose) {
+                        os << RED << "WARNING: " << "Resource " << extraResource.Name << " for map "
+                            << PackageMapSpecInfo.PackageMapSpec->Maps[mapIndex].Name << " set to be removed was not found" << '\n';
+                    }
+                }
 
-                        if (StartsWith(resourceContainer.Name, "dlc_hub")) {
-                            modFileMapName = "game/dlc/hub/hub";
-                        }
-                        else if (StartsWith(resourceContainer.Name, "hub")) {
-                            modFileMapName = "game/hub/hub";
-                        }
+                continue;
+            }
 
-                        for (int32_t i = 0; i < PackageMapSpecInfo.PackageMapSpec->Maps.size(); i++) {
-                            if (EndsWith(PackageMapSpecInfo.PackageMapSpec->Maps[i].Name, modFileMapName)) {
-                                mapIndex = i;
-                                break;
-                            }
-                        }
+            for (int32_t i = PackageMapSpecInfo.PackageMapSpec->MapFileRefs.size() - 1; i >= 0; i--) {
+                if (PackageMapSpecInfo.PackageMapSpec->MapFileRefs[i].File == fileIndex
+                    && PackageMapSpecInfo.PackageMapSpec->MapFileRefs[i].Map == mapIndex) {
+                        PackageMapSpecInfo.PackageMapSpec->MapFileRefs.erase(PackageMapSpecInfo.PackageMapSpec->MapFileRefs.begin() + i);
 
-                        if (fileIndex == -1) {
-                            os << RED << "ERROR: " << RESET << "Invalid extra resource " << extraResource.Name << ", skipping" << '\n';
-                            continue;
+                        if (Verbose) {
+                            os << "\tResource " << PackageMapSpecInfo.PackageMapSpec->Files[fileIndex].Name << " being added to map "
+                                << PackageMapSpecInfo.PackageMapSpec->Maps[mapIndex].Name << " already exists. The load order will be modified as specified." << '\n';
                         }
 
-                        if (mapIndex == -1) {
-                            os << RED << "ERROR: " << RESET << "Map reference not found for " << modFile.Name << ", skipping" << '\n';
-                            continue;
-                        }
+                        break;
+                }
+            }
 
-                        if (extraResource.Remove) {
-                            bool mapFileRefRemoved = false;
+            int32_t insertIndex = -1;
 
-                            for (int32_t i = PackageMapSpecInfo.PackageMapSpec->MapFileRefs.size() - 1; i >= 0; i--) {
-                                if (PackageMapSpecInfo.PackageMapSpec->MapFileRefs[i].File == fileIndex && PackageMapSpecInfo.PackageMapSpec->MapFileRefs[i].Map == mapIndex) {
-                                    PackageMapSpecInfo.PackageMapSpec->MapFileRefs.erase(PackageMapSpecInfo.PackageMapSpec->MapFileRefs.begin() + i);
-                                    mapFileRefRemoved = true;
-                                    break;
-                                }
-                            }
+            for (int32_t i = 0; i < PackageMapSpecInfo.PackageMapSpec->MapFileRefs.size(); i++) {
+                if (PackageMapSpecInfo.PackageMapSpec->MapFileRefs[i].Map == mapIndex) {
+                    if (extraResource.PlaceFirst) {
+                        insertIndex = i;
+                        break;
+                    }
 
-                            if (mapFileRefRemoved) {
-                                os << "\tRemoved resource " << PackageMapSpecInfo.PackageMapSpec->Files[fileIndex].Name << " to be loaded in map "
-                                    << PackageMapSpecInfo.PackageMapSpec->Maps[mapIndex].Name << '\n';
-                            }
-                            else {
-                                if (Verbose) {
-                                    os << RED << "WARNING: " << "Resource " << extraResource.Name << " for map "
-                                        << PackageMapSpecInfo.PackageMapSpec->Maps[mapIndex].Name << " set to be removed was not found" << '\n';
-                                }
-                            }
+                    insertIndex = i + 1;
+                }
+            }
 
-                            continue;
-                        }
+            if (!extraResource.PlaceByName.empty() && !extraResource.PlaceFirst) {
+                std::string placeBeforeResourcePath = PathToResourceContainer(extraResource.PlaceByName);
 
-                        for (int32_t i = PackageMapSpecInfo.PackageMapSpec->MapFileRefs.size() - 1; i >= 0; i--) {
-                            if (PackageMapSpecInfo.PackageMapSpec->MapFileRefs[i].File == fileIndex
-                                && PackageMapSpecInfo.PackageMapSpec->MapFileRefs[i].Map == mapIndex) {
-                                    PackageMapSpecInfo.PackageMapSpec->MapFileRefs.erase(PackageMapSpecInfo.PackageMapSpec->MapFileRefs.begin() + i);
+                if (placeBeforeResourcePath.empty()) {
+                    os << RED << "WARNING: " << RESET << "placeByName resource " << extraResource.PlaceByName
+                        << " not found for extra resource entry " << extraResource.Name << ", using normal placement" << '\n';
+                }
+                else {
+                    int32_t placeBeforeFileIndex = -1;
 
-                                    if (Verbose) {
-                                        os << "\tResource " << PackageMapSpecInfo.PackageMapSpec->Files[fileIndex].Name << " being added to map "
-                                            << PackageMapSpecInfo.PackageMapSpec->Maps[mapIndex].Name << " already exists. The load order will be modified as specified." << '\n';
-                                    }
+                    for (int32_t i = 0; i < PackageMapSpecInfo.PackageMapSpec->Files.size(); i++) {
+                        if (PackageMapSpecInfo.PackageMapSpec->Files[i].Name.find(extraResource.PlaceByName) != std::string::npos) {
+                            placeBeforeFileIndex = i;
+                            break;
+                        }
+                    }
 
-                                    break;
-                            }
+                    for (int32_t i = 0; i < PackageMapSpecInfo.PackageMapSpec->MapFileRefs.size(); i++) {
+                        if (PackageMapSpecInfo.PackageMapSpec->MapFileRefs[i].Map == mapIndex && PackageMapSpecInfo.PackageMapSpec->MapFileRefs[i].File == placeBeforeFileIndex) {
+                            insertIndex = i + (!extraResource.PlaceBefore ? 1 : 0);
+                            break;
                         }
+                    }
+                }
+            }
 
-                        int32_t insertIndex = -1;
+            PackageMapSpecMapFileRef mapFileRef(fileIndex, mapIndex);
 
-                        for (int32_t i = 0; i < PackageMapSpecInfo.PackageMapSpec->MapFileRefs.size(); i++) {
-                            if (PackageMapSpecInfo.PackageMapSpec->MapFileRefs[i].Map == mapIndex) {
-                                if (extraResource.PlaceFirst) {
-                                    insertIndex = i;
-                                    break;
-                                }
+            if (insertIndex == -1 || insertIndex >= PackageMapSpecInfo.PackageMapSpec->MapFileRefs.size()) {
+                PackageMapSpecInfo.PackageMapSpec->MapFileRefs.push_back(mapFileRef);
+            }
+            else {
+                PackageMapSpecInfo.PackageMapSpec->MapFileRefs.insert(PackageMapSpecInfo.PackageMapSpec->MapFileRefs.begin() + insertIndex, mapFileRef);
+            }
 
-                                insertIndex = i + 1;
-                            }
-                        }
+            os << "\tAdded extra resource " << PackageMapSpecInfo.PackageMapSpec->Files[fileIndex].Name << " to be loaded in map "
+                << PackageMapSpecInfo.PackageMapSpec->Maps[mapIndex].Name;
 
-                        if (!extraResource.PlaceByName.empty() && !extraResource.PlaceFirst) {
-                            std::string placeBeforeResourcePath = PathToResourceContainer(extraResource.PlaceByName);
+            if (extraResource.PlaceFirst) {
+                os << " with the highest priority" << '\n';
+            }
+            else if (!extraResource.PlaceByName.empty() && insertIndex != -1) {
+                os << " " << (extraResource.PlaceBefore ? "before" : "after") << " " << extraResource.PlaceByName << '\n';
+            }
+            else {
+                os << " with the lowest priority" << '\n';
+            }
 
-                            if (placeBeforeResourcePath.empty()) {
-                                os << RED << "WARNING: " << RESET << "placeByName resource " << extraResource.PlaceByName
-                                    << " not found for extra resource entry " << extraResource.Name << ", using normal placement" << '\n';
-                            }
-                            else {
-                                int32_t placeBeforeFileIndex = -1;
+            PackageMapSpecInfo.WasPackageMapSpecModified = true;
+        }
+    }
+}
 
-                                for (int32_t i = 0; i < PackageMapSpecInfo.PackageMapSpec->Files.size(); i++) {
-                                    if (PackageMapSpecInfo.PackageMapSpec->Files[i].Name.find(extraResource.PlaceByName) != std::string::npos) {
-                                        placeBeforeFileIndex = i;
-                                        break;
-                                    }
-                                }
+/**
+ * @brief Add the extra resources of all the loaded mods to the PackageMapSpec file
+ *
+ * Containers are loaded concurrently, so this is done beforehand, one container after another in the order
+ * they are sorted in, for the PackageMapSpec file to come out the same every time.
+ */
+void AddAllExtraResources()
+{
+    std::stringstream os;
 
-                                for (int32_t i = 0; i < PackageMapSpecInfo.PackageMapSpec->MapFileRefs.size(); i++) {
-                                    if (PackageMapSpecInfo.PackageMapSpec->MapFileRefs[i].Map == mapIndex && PackageMapSpecInfo.PackageMapSpec->MapFileRefs[i].File == placeBeforeFileIndex) {
-                                        insertIndex = i + (!extraResource.PlaceBefore ? 1 : 0);
-                                        break;
-                                    }
-                                }
-                            }
-                        }
+    for (auto &resourceContainer : ResourceContainerList) {
+        for (auto &modFile : resourceContainer.ModFileList) {
+            if (modFile.IsAssetsInfoJson && modFile.AssetsInfo.has_value() && !modFile.AssetsInfo->Resources.empty())
+                AddExtraResources(resourceContainer, modFile, os);
+        }
+    }
 
-                        PackageMapSpecMapFileRef mapFileRef(fileIndex, mapIndex);
+    std::cout << os.str();
+}
 
-                        if (insertIndex == -1 || insertIndex >= PackageMapSpecInfo.PackageMapSpec->MapFileRefs.size()) {
-                            PackageMapSpecInfo.PackageMapSpec->MapFileRefs.push_back(mapFileRef);
-                        }
-                        else {
-                            PackageMapSpecInfo.PackageMapSpec->MapFileRefs.insert(PackageMapSpecInfo.PackageMapSpec->MapFileRefs.begin() + insertIndex, mapFileRef);
-                        }
+/**
+ * @brief Replace chunks in the given resource file
+ * 
+ * @param storage ContainerStorage object containing the resource to modify
+ * @param resourceContainer ResourceContainer object containing the resources's data
+ * @param os StringStream to output to
+ */
+void ReplaceChunks(ContainerStorage &storage, ResourceContainer &resourceContainer, std::stringstream &os)
+{
+    ResourceChunk *mapResourcesChunk = NULL;
+    MapResourcesFile *mapResourcesFile = NULL;
+    std::vector<std::byte> originalDecompressedMapResources;
+    bool invalidMapResources = false;
+    int32_t fileCount = 0;
+    std::map<std::string, BlangFileEntry> blangFileEntries;
 
-                        os << "\tAdded extra resource " << PackageMapSpecInfo.PackageMapSpec->Files[fileIndex].Name << " to be loaded in map "
-                            << PackageMapSpecInfo.PackageMapSpec->Maps[mapIndex].Name;
+    std::stable_sort(resourceContainer.ModFileList.begin(), resourceContainer.ModFileList.end(), IsAppliedBefore<ResourceModFile>);
 
-                        if (extraResource.PlaceFirst) {
-                            os << " with the highest priority" << '\n';
-                        }
-                        else if (!extraResource.PlaceByName.empty() && insertIndex != -1) {
-                            os << " " << (extraResource.PlaceBefore ? "before" : "after") << " " << extraResource.PlaceByName << '\n';
-                        }
-                        else {
-                            os << " with the lowest priority" << '\n';
-                        }
+    std::map<std::string, int32_t> modFileCounts;
 
-                        PackageMapSpecInfo.WasPackageMapSpecModified = true;
-                    }
-                }
+    for (auto &modFile : resourceContainer.ModFileList) {
+        if (!modFile.IsAssetsInfoJson && !modFile.IsBlangJson)
+            modFileCounts[modFile.Name]++;
+    }
 
-                mtx.unlock();
-            }
+    PrefetchChunkData(storage, resourceContainer);
 
+    for (auto &modFile : resourceContainer.ModFileList) {
+        ResourceChunk *chunk = NULL;
+
+        if (modFile.IsAssetsInfoJson && modFile.AssetsInfo.has_value()) {
             if (modFile.AssetsInfo->Assets.empty() && modFile.AssetsInfo->Maps.empty() && modFile.AssetsInfo->Layers.empty())
                 continue;
 
@@ -254,8 +326,15 @@ void ReplaceChunks(MemoryMappedFile &memoryMappedFile, ResourceContainer &resour
                         std::vector<std::byte> mapResourcesBytes(mapResourcesChunk->SizeZ);
                         uint64_t mapResourcesFileOffset;
 
-                        std::copy(memoryMappedFile.Mem + mapResourcesChunk->FileOffset, memoryMappedFile.Mem + mapResourcesChunk->FileOffset + 8, (std::byte*)&mapResourcesFileOffset);
-                        std::copy(memoryMappedFile.Mem + mapResourcesFileOffset, memoryMappedFile.Mem + mapResourcesFileOffset + mapResourcesBytes.size(), mapResourcesBytes.begin());
+                        storage.Read(mapResourcesChunk->FileOffset, (std::byte*)&mapResourcesFileOffset, 8);
+
+                        if (!resourceContainer.WriteQueue.CommitIfPending(storage, mapResourcesFileOffset, mapResourcesBytes.size())) {
+                            os << RED << "ERROR: " << RESET << "Failed to write mod files to " << resourceContainer.Path << '\n';
+                            invalidMapResources = true;
+                            break;
+                        }
+
+                        storage.Read(mapResourcesFileOffset, mapResourcesBytes.data(), mapResourcesBytes.size());
 
                         try {
                             originalDecompressedMapResources = OodleDecompress(mapResourcesBytes, mapResourcesChunk->Size);
@@ -294,6 +373,7 @@ void ReplaceChunks(MemoryMappedFile &memoryMappedFile, ResourceContainer &resour
                     mapResourcesFile->Layers.push_back(newLayers.Name);
                     os << "\tAdded layer " << newLayers.Name << " to " << mapResourcesChunk->ResourceName.NormalizedFileName
                         << " in " << resourceContainer.Name << "" << '\n';
+                    resourceContainer.Work.MapResourcesEdits++;
                 }
             }
 
@@ -310,6 +390,7 @@ void ReplaceChunks(MemoryMappedFile &memoryMappedFile, ResourceContainer &resour
 
                     mapResourcesFile->Maps.push_back(newMaps.Name);
                     os << "Added map " << newMaps.Name << " to " << mapResourcesChunk->ResourceName.NormalizedFileName << " in " << resourceContainer.Name << '\n';
+                    resourceContainer.Work.MapResourcesEdits++;
                 }
             }
 
@@ -348,6 +429,7 @@ void ReplaceChunks(MemoryMappedFile &memoryMappedFile, ResourceContainer &resour
                         if (assetFound) {
                             os << "\tRemoved asset " << newAsset.Name << " with type " << newAsset.MapResourceType <<
                                 " from " << mapResourcesChunk->ResourceName.NormalizedFileName << " in " << resourceContainer.Name << '\n';
+                            resourceContainer.Work.MapResourcesEdits++;
                         }
                         else {
                             os << RED << "WARNING: " << RESET << "Can't remove asset " << newAsset.Name << " with type " << newAsset.MapResourceType <<
@@ -391,6 +473,7 @@ void ReplaceChunks(MemoryMappedFile &memoryMappedFile, ResourceContainer &resour
 
                         os << "Added asset type " << newAsset.MapResourceType << " to " <<
                             mapResourcesChunk->ResourceName.NormalizedFileName << " in " << resourceContainer.Name << '\n';
+                        resourceContainer.Work.MapResourcesEdits++;
                     }
 
                     MapAsset placeByExistingAsset;
@@ -448,6 +531,7 @@ void ReplaceChunks(MemoryMappedFile &memoryMappedFile, ResourceContainer &resour
                     mapResourcesFile->Assets.insert(mapResourcesFile->Assets.begin() + assetPosition, newMapAsset);
 
                     os << "\tAdded asset " << newAsset.Name << " with type " << newAsset.MapResourceType << " to " << mapResourcesChunk->ResourceName.NormalizedFileName << " in " << resourceContainer.Name << '\n';
+                    resourceContainer.Work.MapResourcesEdits++;
                 }
             }
 
@@ -468,16 +552,20 @@ void ReplaceChunks(MemoryMappedFile &memoryMappedFile, ResourceContainer &resour
         else {
             chunk = GetChunk(modFile.Name, resourceContainer);
 
+            // Only the last mod file replacing a resource is written, the others could only win by adding it
+            if (chunk != NULL && --modFileCounts[modFile.Name] > 0) {
+                modFile.FileBytes.resize(0);
+                continue;
+            }
+
             if (chunk == NULL) {
                 resourceContainer.NewModFileList.push_back(modFile);
 
-                std::map<uint64_t, ResourceDataEntry>::iterator x = ResourceDataMap.find(CalculateResourceFileNameHash(modFile.Name));
+                ResourceDataEntry resourceData;
 
-                if (x == ResourceDataMap.end())
+                if (!ResourceDataMap.Find(CalculateResourceFileNameHash(modFile.Name), resourceData))
                     continue;
 
-                ResourceDataEntry resourceData = x->second;
-
                 if (resourceData.MapResourceName.empty()) {
                     if (RemoveWhitespace(resourceData.MapResourceType).empty()) {
                         if (Verbose)
@@ -501,8 +589,15 @@ void ReplaceChunks(MemoryMappedFile &memoryMappedFile, ResourceContainer &resour
                             std::vector<std::byte> mapResourcesBytes(mapResourcesChunk->SizeZ);
                             uint64_t mapResourcesFileOffset;
 
-                            std::copy(memoryMappedFile.Mem + mapResourcesChunk->FileOffset, memoryMappedFile.Mem + mapResourcesChunk->FileOffset + 8, (std::byte*)&mapResourcesFileOffset);
-                            std::copy(memoryMappedFile.Mem + mapResourcesFileOffset, memoryMappedFile.Mem + mapResourcesFileOffset + mapResourcesBytes.size(), mapResourcesBytes.begin());
+                            storage.Read(mapResourcesChunk->FileOffset, (std::byte*)&mapResourcesFileOffset, 8);
+
+                            if (!resourceContainer.WriteQueue.CommitIfPending(storage, mapResourcesFileOffset, mapResourcesBytes.size())) {
+                                os << RED << "ERROR: " << RESET << "Failed to write mod files to " << resourceContainer.Path << '\n';
+                                invalidMapResources = true;
+                                break;
+                            }
+
+                            storage.Read(mapResourcesFileOffset, mapResourcesBytes.data(), mapResourcesBytes.size());
 
                             try {
                                 originalDecompressedMapResources = OodleDecompress(mapResourcesBytes, mapResourcesChunk->Size);
@@ -558,6 +653,7 @@ void ReplaceChunks(MemoryMappedFile &memoryMappedFile, ResourceContainer &resour
 
                     os << "\tAdded asset type " << resourceData.MapResourceType << " to "
                         << mapResourcesChunk->ResourceName.NormalizedFileName << " in " << resourceContainer.Name << '\n';
+                    resourceContainer.Work.MapResourcesEdits++;
                 }
 
                 MapAsset newMapAsset;
@@ -568,6 +664,7 @@ void ReplaceChunks(MemoryMappedFile &memoryMappedFile, ResourceContainer &resour
 
                 os << "\tAdded asset " << resourceData.MapResourceName << " with type " << resourceData.MapResourceType
                     << " to " << mapResourcesChunk->ResourceName.NormalizedFileName << " in " << resourceContainer.Name << '\n';
+                resourceContainer.Work.MapResourcesEdits++;
                 continue;
             }
         }
@@ -580,10 +677,16 @@ void ReplaceChunks(MemoryMappedFile &memoryMappedFile, ResourceContainer &resour
 
             if (!exists) {
                 int64_t fileOffset, size;
-                std::copy(memoryMappedFile.Mem + chunk->FileOffset, memoryMappedFile.Mem + chunk->FileOffset + 8, (std::byte*)&fileOffset);
-                std::copy(memoryMappedFile.Mem + chunk->FileOffset + 8, memoryMappedFile.Mem + chunk->FileOffset + 16, (std::byte*)&size);
+                storage.Read(chunk->FileOffset, (std::byte*)&fileOffset, 8);
+                storage.Read(chunk->FileOffset + 8, (std::byte*)&size, 8);
+
+                if (!resourceContainer.WriteQueue.CommitIfPending(storage, fileOffset, size)) {
+                    os << RED << "ERROR: " << RESET << "Failed to write mod files to " << resourceContainer.Path << '\n';
+                    continue;
+                }
 
-                std::vector<std::byte> blangFileBytes(memoryMappedFile.Mem + fileOffset, memoryMappedFile.Mem + fileOffset + size);
+                std::vector<std::byte> blangFileBytes(size);
+                storage.Read(fileOffset, blangFileBytes.data(), size);
                 std::vector<std::byte> decryptedBlangFileBytes = IdCrypt(blangFileBytes, modFile.Name, true);
 
                 if (decryptedBlangFileBytes.empty()) {
@@ -625,6 +728,7 @@ void ReplaceChunks(MemoryMappedFile &memoryMappedFile, ResourceContainer &resour
 
                         os << "\tReplaced " << blangString.Identifier << " in " << modFile.Name << '\n';
                         blangFileEntries[blangFilePath].WasModified = true;
+                        resourceContainer.Work.BlangEdits++;
                         break;
                     }
                 }
@@ -639,17 +743,30 @@ void ReplaceChunks(MemoryMappedFile &memoryMappedFile, ResourceContainer &resour
 
                 os << "\tAdded " << blangJsonString.get<jsonxx::String>("name") << " in " << modFile.Name << '\n';
                 blangFileEntries[blangFilePath].WasModified = true;
+                resourceContainer.Work.BlangEdits++;
             }
 
             continue;
         }
 
-        uint64_t compressedSize = modFile.FileBytes.size();
+        uint64_t compressedSize = modFile.GetSize();
         uint64_t uncompressedSize = compressedSize;
         std::byte compressionMode = (std::byte)0;
 
         if (EndsWith(chunk->ResourceName.NormalizedFileName, ".tga")) {
-            if (!memcmp(modFile.FileBytes.data(), DivinityMagic, 8)) {
+            if (modFile.FileSource.has_value()) {
+                if (modFile.FileSourceUncompressedSize.has_value()) {
+                    uncompressedSize = modFile.FileSourceUncompressedSize.value();
+                    modFile.FileSource.value().Offset += 16;
+                    modFile.FileSource.value().Size -= 16;
+                    compressedSize = modFile.FileSource.value().Size;
+                    compressionMode = (std::byte)2;
+
+                    if (Verbose)
+                        os << "\tSuccessfully set compressed texture data for file " << modFile.Name << '\n';
+                }
+            }
+            else if (!memcmp(modFile.FileBytes.data(), DivinityMagic, 8)) {
                 std::copy(modFile.FileBytes.begin() + 8, modFile.FileBytes.begin() + 16, (std::byte*)&uncompressedSize);
 
                 modFile.FileBytes = std::vector<std::byte>(modFile.FileBytes.begin() + 16, modFile.FileBytes.end());
@@ -659,11 +776,16 @@ void ReplaceChunks(MemoryMappedFile &memoryMappedFile, ResourceContainer &resour
                 if (Verbose)
                     os << "\tSuccessfully set compressed texture data for file " << modFile.Name << '\n';
             }
+            else if (CompressTextures && PlanOnly) {
+                // Textures are only compressed when the mods are loaded, the plan keeps their uncompressed size
+                resourceContainer.Work.CompressedBytes += modFile.FileBytes.size();
+            }
             else if (CompressTextures) {
                 std::vector<std::byte> compressedData;
+                resourceContainer.Work.CompressedBytes += modFile.FileBytes.size();
 
                 try {
-                    compressedData = OodleCompress(modFile.FileBytes, OodleFormat::Kraken, OodleCompressionLevel::Normal);
+                    compressedData = TextureCompressionCache.Compress(modFile.FileBytes, OodleFormat::Kraken, OodleCompressionLevel::Normal);
 
                     if (compressedData.empty())
                         throw std::exception();
@@ -682,7 +804,7 @@ void ReplaceChunks(MemoryMappedFile &memoryMappedFile, ResourceContainer &resour
             }
         }
 
-        if (!SetModDataForChunk(memoryMappedFile, resourceContainer, *chunk, modFile, compressedSize, uncompressedSize, &compressionMode)) {
+        if (!SetModDataForChunk(storage, resourceContainer, *chunk, modFile, compressedSize, uncompressedSize, &compressionMode)) {
             os << RED << "ERROR: " << RESET << "Failed to set new mod data for " << modFile.Name << " in resource chunk." << '\n';
             continue;
         }
@@ -713,7 +835,7 @@ void ReplaceChunks(MemoryMappedFile &memoryMappedFile, ResourceContainer &resour
         blangModFile.FileBytes = cryptData;
         std::byte compressionMode = (std::byte)0;
 
-        if (!SetModDataForChunk(memoryMappedFile, resourceContainer, blangFileEntry.second.Chunk, blangModFile, blangModFile.FileBytes.size(), blangModFile.FileBytes.size(), &compressionMode)) {
+        if (!SetModDataForChunk(storage, resourceContainer, blangFileEntry.second.Chunk, blangModFile, blangModFile.FileBytes.size(), blangModFile.FileBytes.size(), &compressionMode)) {
             os << RED << "ERROR: " << RESET << "Failed to set new mod data for " << blangFileEntry.first << "in resource chunk." << '\n';
             continue;
         }
@@ -726,7 +848,11 @@ void ReplaceChunks(MemoryMappedFile &memoryMappedFile, ResourceContainer &resour
         std::vector<std::byte> decompressedMapResourcesData = mapResourcesFile->ToByteVector();
 
         if (decompressedMapResourcesData != originalDecompressedMapResources) {
-            std::vector<std::byte> compressedMapResourcesData = OodleCompress(decompressedMapResourcesData, OodleFormat::Kraken, OodleCompressionLevel::Normal);
+            resourceContainer.Work.CompressedBytes += decompressedMapResourcesData.size();
+
+            // The plan keeps the uncompressed size, like for textures
+            std::vector<std::byte> compressedMapResourcesData = PlanOnly ? decompressedMapResourcesData
+                : OodleCompress(decompressedMapResourcesData, OodleFormat::Kraken, OodleCompressionLevel::Normal);
 
             if (compressedMapResourcesData.empty()) {
                 os << "ERROR: " << RESET << "Failed to compress " << mapResourcesChunk->ResourceName.NormalizedFileName << '\n';
@@ -735,7 +861,7 @@ void ReplaceChunks(MemoryMappedFile &memoryMappedFile, ResourceContainer &resour
                 ResourceModFile mapResourcesModFile(Mod(), mapResourcesChunk->ResourceName.NormalizedFileName);
                 mapResourcesModFile.FileBytes = compressedMapResourcesData;
 
-                if (!SetModDataForChunk(memoryMappedFile, resourceContainer, *mapResourcesChunk,  mapResourcesModFile, compressedMapResourcesData.size(), decompressedMapResourcesData.size(), NULL)) {
+                if (!SetModDataForChunk(storage, resourceContainer, *mapResourcesChunk,  mapResourcesModFile, compressedMapResourcesData.size(), decompressedMapResourcesData.size(), NULL)) {
                     os << RED << "ERROR: " << RESET << "Failed to set new mod data for " << mapResourcesChunk->ResourceName.NormalizedFileName << "in resource chunk." << '\n';
                     delete mapResourcesFile;
                     return;
@@ -748,6 +874,8 @@ void ReplaceChunks(MemoryMappedFile &memoryMappedFile, ResourceContainer &resour
         }
     }
     
+    resourceContainer.Work.ReplacedFiles += fileCount;
+
     if (fileCount > 0)
         os << "Number of files replaced: " << GREEN << fileCount << " file(s) " << RESET << "in " << YELLOW << resourceContainer.Path << RESET << "." << '\n';
 
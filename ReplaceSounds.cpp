@@ -126,14 +126,13 @@ bool EncodeSoundMod(SoundModFile &soundModFile)
 /**
  * @brief Replace sounds in the given sound container file
  * 
- * @param memoryMappedFile MemoryMappedFile object containing the resource to modify
+ * @param storage ContainerStorage object containing the resource to modify
  * @param soundContainer SoundContainer object containing the sound container's data
  * @param os StringStream to output to
  */
-void ReplaceSounds(MemoryMappedFile &memoryMappedFile, SoundContainer &soundContainer, std::stringstream &os)
+void ReplaceSounds(ContainerStorage &storage, SoundContainer &soundContainer, std::stringstream &os)
 {
-    std::stable_sort(soundContainer.ModFileList.begin(), soundContainer.ModFileList.end(),
-                     [](const SoundModFile &sound1, const SoundModFile &sound2) { return sound1.Parent.LoadPriority > sound2.Parent.LoadPriority; });
+    std::stable_sort(soundContainer.ModFileList.begin(), soundContainer.ModFileList.end(), IsAppliedBefore<SoundModFile>);
 
     int32_t fileCount = 0;
 
@@ -188,7 +187,14 @@ void ReplaceSounds(MemoryMappedFile &memoryMappedFile, SoundContainer &soundCont
             needsEncoding = true;
         }
 
-        if (needsEncoding) {
+        if (needsEncoding)
+            soundContainer.Work.CompressedBytes += soundModFile.FileBytes.size();
+
+        // Sounds are only encoded when the mods are loaded, the plan keeps their original size
+        if (needsEncoding && PlanOnly) {
+            format = 2;
+        }
+        else if (needsEncoding) {
             try {
                 mtx.lock();
 
@@ -215,7 +221,7 @@ void ReplaceSounds(MemoryMappedFile &memoryMappedFile, SoundContainer &soundCont
             os << RED << "ERROR: " << RESET << "Couldn't determine the sound file format for " << soundModFile.Name << ", skipping" << '\n';
             continue;
         }
-        else if (format == 2 && needsDecoding) {
+        else if (format == 2 && needsDecoding && !PlanOnly) {
             try {
                 mtx.lock();
                 decodedSize = GetDecodedOpusFileSize(soundModFile);
@@ -231,15 +237,8 @@ void ReplaceSounds(MemoryMappedFile &memoryMappedFile, SoundContainer &soundCont
         }
 
         bool soundFound = false;
-        uint32_t soundModOffset = memoryMappedFile.Size;
-        int64_t newContainerSize = soundModOffset + soundModFile.FileBytes.size();
-
-        if (!memoryMappedFile.ResizeFile(newContainerSize)) {
-            os << RED << "ERROR: " << RESET << "Failed to resize " << soundContainer.Path << '\n';
-            return;
-        }
-        
-        std::copy(soundModFile.FileBytes.begin(), soundModFile.FileBytes.end(), memoryMappedFile.Mem + soundModOffset);
+        uint32_t soundModOffset = soundContainer.WriteQueue.FileSize;
+        soundContainer.WriteQueue.Push(soundModOffset, std::move(soundModFile.FileBytes));
 
         std::vector<SoundEntry> soundEntriesToModify = GetSoundEntriesToModify(soundContainer, soundModId);
 
@@ -250,12 +249,12 @@ void ReplaceSounds(MemoryMappedFile &memoryMappedFile, SoundContainer &soundCont
         }
 
         for (auto &soundEntry : soundEntriesToModify) {
-            std::copy((std::byte*)&encodedSize, (std::byte*)&encodedSize + 4, memoryMappedFile.Mem + soundEntry.InfoOffset);
-            std::copy((std::byte*)&soundModOffset, (std::byte*)&soundModOffset + 4, memoryMappedFile.Mem + soundEntry.InfoOffset + 4);
-            std::copy((std::byte*)&decodedSize, (std::byte*)&decodedSize + 4, memoryMappedFile.Mem + soundEntry.InfoOffset + 8);
+            storage.Write(soundEntry.InfoOffset, (std::byte*)&encodedSize, 4);
+            storage.Write(soundEntry.InfoOffset + 4, (std::byte*)&soundModOffset, 4);
+            storage.Write(soundEntry.InfoOffset + 8, (std::byte*)&decodedSize, 4);
 
             uint16_t currentFormat;
-            std::copy(memoryMappedFile.Mem + soundEntry.InfoOffset + 12, memoryMappedFile.Mem + soundEntry.InfoOffset + 14, (std::byte*)&currentFormat);
+            storage.Read(soundEntry.InfoOffset + 12, (std::byte*)&currentFormat, 2);
 
             if (currentFormat != format) {
                 os << RED << "WARNING: " << RESET << "Format mismatch: sound file " << soundModFile.Name << " needs to be " << (currentFormat == 3 ? "WEM" : "OPUS") << " format." << '\n';
@@ -269,6 +268,8 @@ void ReplaceSounds(MemoryMappedFile &memoryMappedFile, SoundContainer &soundCont
         fileCount++;
     }
 
+    soundContainer.Work.ReplacedFiles += fileCount;
+
     if (fileCount > 0) {
         os << "Number of sounds replaced: " << GREEN << fileCount << " sound(s) "
             << RESET << "in " << YELLOW << soundContainer.Path << RESET << "." << '\n';
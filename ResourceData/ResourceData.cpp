@@ -19,38 +19,78 @@
 #include <iostream>
 #include <filesystem>
 #include <algorithm>
+#include <vector>
 #include <map>
+#include <unordered_map>
+#include <fstream>
+#include <cstring>
 
 #include "Colors/Colors.hpp"
 #include "Oodle/Oodle.hpp"
 #include "ResourceData/ResourceData.hpp"
+#include "Utils/Utils.hpp"
+
+// Resource data index signature
+const char ResourceDataIndexMagic[8] = { 'E', 'M', 'L', 'R', 'S', 'D', 'X', '1' };
+
+// Size of the resource data index header
+const uint64_t ResourceDataIndexHeaderSize = 64;
 
 /**
- * @brief Parse the resource data file from disk
- * 
- * @param fileName Resource data filename
- * @return Map containing the parsed resource data
+ * @brief Get the hash table slot to start probing at for the given filename hash
+ *
+ * @param fileNameHash Filename hash to look up
+ * @param slotCount Number of slots in the table, a power of two
+ * @return Index of the slot
  */
-std::map<uint64_t, ResourceDataEntry> ParseResourceData(std::string &fileName)
+static uint64_t GetResourceDataSlotIndex(uint64_t fileNameHash, uint64_t slotCount)
 {
-    std::map<uint64_t, ResourceDataEntry> resourceDataMap;
-    int64_t filesize = std::filesystem::file_size(fileName);
-    int64_t decompressedSize;
-    std::vector<std::byte> compressedData(filesize - 8);
+    uint64_t hash = fileNameHash ^ (fileNameHash >> 29);
+    hash *= 0xBF58476D1CE4E5B9;
+    hash ^= hash >> 32;
 
-    FILE *resourceDataFile = fopen(fileName.c_str(), "rb");
+    return hash & (slotCount - 1);
+}
 
-    if (!resourceDataFile)
-        return resourceDataMap;
-    
-    if (fread(&decompressedSize, 8, 1, resourceDataFile) != 1)
-        return resourceDataMap;
+/**
+ * @brief Add a string to the index's string pool, reusing an identical one if it's already there
+ *
+ * @param stringPool String pool to add the string to
+ * @param pooledStrings Map of the strings in the pool to their offsets
+ * @param string String to add
+ * @return Offset of the string in the pool
+ */
+static uint32_t PoolString(std::string &stringPool, std::unordered_map<std::string, uint32_t> &pooledStrings, const std::string &string)
+{
+    auto x = pooledStrings.find(string);
 
-    if (fread(compressedData.data(), 1, compressedData.size(), resourceDataFile) != compressedData.size())
-        return resourceDataMap;
+    if (x != pooledStrings.end())
+        return x->second;
 
-    fclose(resourceDataFile);
+    uint32_t offset = stringPool.size();
+    stringPool += string;
+    pooledStrings[string] = offset;
+
+    return offset;
+}
+
+/**
+ * @brief Parse the resource data file into an index image
+ *
+ * @param fileName Resource data filename
+ * @param fileBytes Resource data file's contents
+ * @param sourceTime Resource data file's last write time, to key the index with
+ * @param sourceHash Hash of the resource data file's contents, to key the index with
+ * @return Byte vector containing the index image, or an empty byte vector on failure
+ */
+std::vector<std::byte> ParseResourceData(std::string &fileName, std::vector<std::byte> &fileBytes, int64_t sourceTime, uint64_t sourceHash)
+{
+    if (fileBytes.size() <= 8)
+        return std::vector<std::byte>();
 
+    int64_t decompressedSize;
+    std::copy(fileBytes.begin(), fileBytes.begin() + 8, (std::byte*)&decompressedSize);
+    std::vector<std::byte> compressedData(fileBytes.begin() + 8, fileBytes.end());
     std::vector<std::byte> decompressedData;
 
     try {
@@ -61,7 +101,7 @@ std::map<uint64_t, ResourceDataEntry> ParseResourceData(std::string &fileName)
     }
     catch (...) {
         std::cout << RED << "ERROR: " << RESET << "Failed to decompress " << fileName << std::endl;
-        return resourceDataMap;
+        return std::vector<std::byte>();
     }
 
     int64_t pos = 0;
@@ -70,57 +110,368 @@ std::map<uint64_t, ResourceDataEntry> ParseResourceData(std::string &fileName)
     std::copy(decompressedData.begin() + pos, decompressedData.begin() + pos + 8, (std::byte*)&amount);
     pos += 8;
 
+    uint64_t slotCount = 16;
+
+    while (slotCount < amount * 2)
+        slotCount *= 2;
+
+    std::vector<ResourceDataSlot> slots(slotCount);
+    std::memset(slots.data(), 0, slots.size() * sizeof(ResourceDataSlot));
+
+    std::string stringPool;
+    std::unordered_map<std::string, uint32_t> pooledStrings;
+    uint64_t entryCount = 0;
+
     for (uint64_t i = 0; i < amount; i++) {
-        ResourceDataEntry resourceDataEntry;
-        
-        uint64_t fileNameHash;
-        std::copy(decompressedData.begin() + pos, decompressedData.begin() + pos + 8, (std::byte*)&fileNameHash);
+        ResourceDataSlot slot;
+        std::memset(&slot, 0, sizeof(ResourceDataSlot));
+        slot.Used = 1;
+
+        std::copy(decompressedData.begin() + pos, decompressedData.begin() + pos + 8, (std::byte*)&slot.FileNameHash);
         pos += 8;
 
-        std::copy(decompressedData.begin() + pos, decompressedData.begin() + pos + 8, (std::byte*)&resourceDataEntry.StreamDbHash);
+        std::copy(decompressedData.begin() + pos, decompressedData.begin() + pos + 8, (std::byte*)&slot.StreamDbHash);
         pos += 8;
 
-        resourceDataEntry.Version = decompressedData[pos];
+        slot.Version = decompressedData[pos];
         pos += 1;
 
-        resourceDataEntry.SpecialByte1 = decompressedData[pos];
+        slot.SpecialByte1 = decompressedData[pos];
         pos += 1;
 
-        resourceDataEntry.SpecialByte2 = decompressedData[pos];
+        slot.SpecialByte2 = decompressedData[pos];
         pos += 1;
 
-        resourceDataEntry.SpecialByte3 = decompressedData[pos];
+        slot.SpecialByte3 = decompressedData[pos];
         pos += 1;
 
-        uint16_t resourceTypeSize;
-        std::copy(decompressedData.begin() + pos, decompressedData.begin() + pos + 2, (std::byte*)&resourceTypeSize);
+        std::copy(decompressedData.begin() + pos, decompressedData.begin() + pos + 2, (std::byte*)&slot.ResourceTypeSize);
         pos += 2;
 
-        resourceDataEntry.ResourceType = std::string((char*)decompressedData.data() + pos, resourceTypeSize);
-        pos += resourceTypeSize;
+        slot.ResourceTypeOffset = PoolString(stringPool, pooledStrings, std::string((char*)decompressedData.data() + pos, slot.ResourceTypeSize));
+        pos += slot.ResourceTypeSize;
 
         uint16_t mapResourceTypeSize;
         std::copy(decompressedData.begin() + pos, decompressedData.begin() + pos + 2, (std::byte*)&mapResourceTypeSize);
         pos += 2;
 
-        resourceDataEntry.MapResourceType = resourceDataEntry.ResourceType;
+        slot.MapResourceTypeOffset = slot.ResourceTypeOffset;
+        slot.MapResourceTypeSize = slot.ResourceTypeSize;
 
         if (mapResourceTypeSize > 0) {
-            resourceDataEntry.MapResourceType = std::string((char*)decompressedData.data() + pos, mapResourceTypeSize);
+            slot.MapResourceTypeOffset = PoolString(stringPool, pooledStrings, std::string((char*)decompressedData.data() + pos, mapResourceTypeSize));
+            slot.MapResourceTypeSize = mapResourceTypeSize;
             pos += mapResourceTypeSize;
 
-            uint16_t mapResourceNameSize;
-            std::copy(decompressedData.begin() + pos, decompressedData.begin() + pos + 2, (std::byte*)&mapResourceNameSize);
+            std::copy(decompressedData.begin() + pos, decompressedData.begin() + pos + 2, (std::byte*)&slot.MapResourceNameSize);
             pos += 2;
 
-            resourceDataEntry.MapResourceName = std::string((char*)decompressedData.data() + pos, mapResourceNameSize);
-            pos += mapResourceNameSize;
+            slot.MapResourceNameOffset = PoolString(stringPool, pooledStrings, std::string((char*)decompressedData.data() + pos, slot.MapResourceNameSize));
+            pos += slot.MapResourceNameSize;
+        }
+
+        // Later entries replace earlier ones with the same hash
+        uint64_t index = GetResourceDataSlotIndex(slot.FileNameHash, slotCount);
+
+        while (slots[index].Used != 0 && slots[index].FileNameHash != slot.FileNameHash)
+            index = (index + 1) & (slotCount - 1);
+
+        if (slots[index].Used == 0)
+            entryCount++;
+
+        slots[index] = slot;
+    }
+
+    uint64_t stringPoolSize = stringPool.size();
+    uint64_t slotsSize = slotCount * sizeof(ResourceDataSlot);
+    std::vector<std::byte> image(ResourceDataIndexHeaderSize + slotsSize + stringPoolSize);
+    uint64_t sourceSize = fileBytes.size();
+
+    std::copy((std::byte*)ResourceDataIndexMagic, (std::byte*)ResourceDataIndexMagic + 8, image.begin());
+    std::copy((std::byte*)&sourceSize, (std::byte*)&sourceSize + 8, image.begin() + 8);
+    std::copy((std::byte*)&sourceTime, (std::byte*)&sourceTime + 8, image.begin() + 16);
+    std::copy((std::byte*)&sourceHash, (std::byte*)&sourceHash + 8, image.begin() + 24);
+    std::copy((std::byte*)&entryCount, (std::byte*)&entryCount + 8, image.begin() + 32);
+    std::copy((std::byte*)&slotCount, (std::byte*)&slotCount + 8, image.begin() + 40);
+    std::copy((std::byte*)&stringPoolSize, (std::byte*)&stringPoolSize + 8, image.begin() + 48);
+    std::copy((std::byte*)slots.data(), (std::byte*)slots.data() + slotsSize, image.begin() + ResourceDataIndexHeaderSize);
+    std::copy((std::byte*)stringPool.data(), (std::byte*)stringPool.data() + stringPoolSize, image.begin() + ResourceDataIndexHeaderSize + slotsSize);
+
+    return image;
+}
+
+/**
+ * @brief Destroy the ResourceDataIndex object
+ *
+ */
+ResourceDataIndex::~ResourceDataIndex()
+{
+    Clear();
+}
+
+/**
+ * @brief Read the resource data file the index was built from
+ *
+ * @param fileName Resource data filename
+ * @param fileBytes Vector to read the file into
+ * @return True on success, false otherwise
+ */
+static bool ReadResourceDataFile(const std::string &fileName, std::vector<std::byte> &fileBytes)
+{
+    try {
+        fileBytes.resize(std::filesystem::file_size(fileName));
+    }
+    catch (...) {
+        return false;
+    }
+
+    FILE *resourceDataFile = fopen(fileName.c_str(), "rb");
+
+    if (!resourceDataFile) {
+        fileBytes.clear();
+        return false;
+    }
+
+    if (fread(fileBytes.data(), 1, fileBytes.size(), resourceDataFile) != fileBytes.size()) {
+        fclose(resourceDataFile);
+        fileBytes.clear();
+        return false;
+    }
+
+    fclose(resourceDataFile);
+    return true;
+}
+
+/**
+ * @brief Read the size, last write time and hash of the resource data file an index image was built from
+ *
+ * @param mem Pointer to the index image
+ * @param size Size of the index image
+ * @param sourceSize Variable to store the resource data file's size in
+ * @param sourceTime Variable to store the resource data file's last write time in
+ * @param sourceHash Variable to store the hash of the resource data file's contents in
+ * @return True if the image has a valid header, false otherwise
+ */
+static bool ReadResourceDataIndexSource(const std::byte *mem, uint64_t size, uint64_t &sourceSize, int64_t &sourceTime, uint64_t &sourceHash)
+{
+    if (size < ResourceDataIndexHeaderSize || std::memcmp(mem, ResourceDataIndexMagic, 8) != 0)
+        return false;
+
+    std::memcpy(&sourceSize, mem + 8, 8);
+    std::memcpy(&sourceTime, mem + 16, 8);
+    std::memcpy(&sourceHash, mem + 24, 8);
+
+    return true;
+}
+
+/**
+ * @brief Use the given index image
+ *
+ * @param mem Pointer to the index image
+ * @param size Size of the index image
+ * @return True if the image is valid, false otherwise
+ */
+bool ResourceDataIndex::Open(const std::byte *mem, uint64_t size)
+{
+    if (size < ResourceDataIndexHeaderSize || std::memcmp(mem, ResourceDataIndexMagic, 8) != 0)
+        return false;
+
+    uint64_t header[7];
+    std::memcpy(header, mem + 8, sizeof(header));
+
+    uint64_t entryCount = header[3];
+    uint64_t slotCount = header[4];
+    uint64_t stringPoolSize = header[5];
+
+    if (slotCount == 0 || (slotCount & (slotCount - 1)) != 0 || entryCount >= slotCount
+        || slotCount > (size - ResourceDataIndexHeaderSize) / sizeof(ResourceDataSlot)
+        || ResourceDataIndexHeaderSize + slotCount * sizeof(ResourceDataSlot) + stringPoolSize != size) {
+            return false;
+    }
+
+    Mem = mem;
+    EntryCount = entryCount;
+    SlotCount = slotCount;
+    Slots = (const ResourceDataSlot*)(mem + ResourceDataIndexHeaderSize);
+    StringPool = (const char*)(mem + ResourceDataIndexHeaderSize + slotCount * sizeof(ResourceDataSlot));
+    StringPoolSize = stringPoolSize;
+
+    return true;
+}
+
+/**
+ * @brief Replace the cache file with the index image held in memory
+ *
+ * @param cachePath Path to the index cache file
+ */
+void ResourceDataIndex::Save(const std::string &cachePath) const
+{
+    std::string tempPath = cachePath + ".tmp";
+
+    try {
+        std::ofstream cacheFile(tempPath, std::ios::binary);
+        cacheFile.write((char*)Image.data(), Image.size());
+        cacheFile.close();
+
+        if (cacheFile)
+            std::filesystem::rename(tempPath, cachePath);
+        else
+            std::filesystem::remove(tempPath);
+    }
+    catch (...) {
+    }
+}
+
+/**
+ * @brief Load the resource data index
+ *
+ * The index is memory mapped from the cache file if it was built from the same resource data file,
+ * otherwise the resource data file is parsed and the cache file is replaced.
+ * The cache is matched by the resource data file's size and last write time, so rs_data is only
+ * read and hashed when its write time changed with the same size, e.g. after being copied.
+ *
+ * @param fileName Resource data filename
+ * @param cachePath Path to the index cache file, or an empty string to not use one
+ * @return True on success, false otherwise
+ */
+bool ResourceDataIndex::Load(std::string &fileName, std::string cachePath)
+{
+    Clear();
+
+    std::vector<std::byte> fileBytes;
+    uint64_t sourceSize;
+    int64_t sourceTime;
+
+    try {
+        sourceSize = std::filesystem::file_size(fileName);
+        sourceTime = std::filesystem::last_write_time(fileName).time_since_epoch().count();
+    }
+    catch (...) {
+        return false;
+    }
+
+    if (!cachePath.empty() && std::filesystem::exists(cachePath)) {
+        try {
+            CacheFile = new MemoryMappedFile(cachePath, true);
+
+            uint64_t cachedSize, cachedHash;
+            int64_t cachedTime;
+
+            if (ReadResourceDataIndexSource(CacheFile->Mem, CacheFile->Size, cachedSize, cachedTime, cachedHash) && cachedSize == sourceSize) {
+                if (cachedTime == sourceTime && Open(CacheFile->Mem, CacheFile->Size))
+                    return !Empty();
+
+                // Same size but a different write time, check the contents before using the index again
+                if (ReadResourceDataFile(fileName, fileBytes) && fileBytes.size() == cachedSize
+                    && HashBytes(fileBytes.data(), fileBytes.size()) == cachedHash) {
+                        Image.assign(CacheFile->Mem, CacheFile->Mem + CacheFile->Size);
+                        delete CacheFile;
+                        CacheFile = NULL;
+
+                        std::copy((std::byte*)&sourceTime, (std::byte*)&sourceTime + 8, Image.begin() + 16);
+
+                        if (Open(Image.data(), Image.size())) {
+                            Save(cachePath);
+                            return !Empty();
+                        }
+                }
+            }
+        }
+        catch (...) {
         }
 
-        resourceDataMap[fileNameHash] = resourceDataEntry;
+        Clear();
     }
 
-    return resourceDataMap;
+    if (fileBytes.empty() && !ReadResourceDataFile(fileName, fileBytes))
+        return false;
+
+    uint64_t sourceHash = HashBytes(fileBytes.data(), fileBytes.size());
+    Image = ParseResourceData(fileName, fileBytes, sourceTime, sourceHash);
+
+    if (Image.empty() || !Open(Image.data(), Image.size())) {
+        Clear();
+        return false;
+    }
+
+    if (!cachePath.empty())
+        Save(cachePath);
+
+    return !Empty();
+}
+
+/**
+ * @brief Find the resource data entry for the given filename hash
+ *
+ * @param fileNameHash Filename hash to look up
+ * @param resourceDataEntry ResourceDataEntry object to fill with the entry's data
+ * @return True if the entry was found, false otherwise
+ */
+bool ResourceDataIndex::Find(uint64_t fileNameHash, ResourceDataEntry &resourceDataEntry) const
+{
+    if (SlotCount == 0)
+        return false;
+
+    uint64_t index = GetResourceDataSlotIndex(fileNameHash, SlotCount);
+
+    for (uint64_t i = 0; i < SlotCount; i++) {
+        ResourceDataSlot slot;
+        std::memcpy(&slot, Slots + index, sizeof(ResourceDataSlot));
+
+        if (slot.Used == 0)
+            return false;
+
+        if (slot.FileNameHash == fileNameHash) {
+            if ((uint64_t)slot.ResourceTypeOffset + slot.ResourceTypeSize > StringPoolSize
+                || (uint64_t)slot.MapResourceTypeOffset + slot.MapResourceTypeSize > StringPoolSize
+                || (uint64_t)slot.MapResourceNameOffset + slot.MapResourceNameSize > StringPoolSize) {
+                    return false;
+            }
+
+            resourceDataEntry.StreamDbHash = slot.StreamDbHash;
+            resourceDataEntry.ResourceType = std::string(StringPool + slot.ResourceTypeOffset, slot.ResourceTypeSize);
+            resourceDataEntry.MapResourceType = std::string(StringPool + slot.MapResourceTypeOffset, slot.MapResourceTypeSize);
+            resourceDataEntry.MapResourceName = std::string(StringPool + slot.MapResourceNameOffset, slot.MapResourceNameSize);
+            resourceDataEntry.Version = slot.Version;
+            resourceDataEntry.SpecialByte1 = slot.SpecialByte1;
+            resourceDataEntry.SpecialByte2 = slot.SpecialByte2;
+            resourceDataEntry.SpecialByte3 = slot.SpecialByte3;
+
+            return true;
+        }
+
+        index = (index + 1) & (SlotCount - 1);
+    }
+
+    return false;
+}
+
+/**
+ * @brief Check if the index has no entries
+ *
+ * @return True if the index is empty, false otherwise
+ */
+bool ResourceDataIndex::Empty() const
+{
+    return EntryCount == 0;
+}
+
+/**
+ * @brief Unload the index
+ *
+ */
+void ResourceDataIndex::Clear()
+{
+    delete CacheFile;
+    CacheFile = NULL;
+    Image.clear();
+    Image.shrink_to_fit();
+    Mem = NULL;
+    EntryCount = 0;
+    SlotCount = 0;
+    Slots = NULL;
+    StringPool = NULL;
+    StringPoolSize = 0;
 }
 
 /**
@@ -19,6 +19,13 @@
 #ifndef RESOURCEDATA_HPP
 #define RESOURCEDATA_HPP
 
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include "MemoryMappedFile/MemoryMappedFile.hpp"
+
 /**
  * @brief ResourceData entry class
  * 
@@ -35,7 +42,59 @@ public:
     std::byte SpecialByte3 = (std::byte)0;
 };
 
-std::map<uint64_t, ResourceDataEntry> ParseResourceData(std::string &fileName);
+/**
+ * @brief Slot of the resource data index's hash table
+ *
+ * Strings are stored as offsets into the index's string pool.
+ */
+class ResourceDataSlot {
+public:
+    uint64_t FileNameHash;
+    uint64_t StreamDbHash;
+    uint32_t ResourceTypeOffset;
+    uint32_t MapResourceTypeOffset;
+    uint32_t MapResourceNameOffset;
+    uint16_t ResourceTypeSize;
+    uint16_t MapResourceTypeSize;
+    uint16_t MapResourceNameSize;
+    std::byte Version;
+    std::byte SpecialByte1;
+    std::byte SpecialByte2;
+    std::byte SpecialByte3;
+    uint8_t Used;
+    uint8_t Padding;
+};
+
+/**
+ * @brief Index of the resource data entries, by filename hash
+ *
+ * The entries are kept in an open addressing hash table followed by a string pool, in a single
+ * image that's saved to a cache file next to rs_data and memory mapped on later runs, so startup
+ * doesn't have to decompress and parse rs_data again, and lookups only touch the pages they need.
+ */
+class ResourceDataIndex {
+public:
+    ~ResourceDataIndex();
+
+    bool Load(std::string &fileName, std::string cachePath);
+    bool Find(uint64_t fileNameHash, ResourceDataEntry &resourceDataEntry) const;
+    bool Empty() const;
+    void Clear();
+private:
+    MemoryMappedFile *CacheFile = NULL;
+    std::vector<std::byte> Image;
+    const std::byte *Mem = NULL;
+    uint64_t EntryCount = 0;
+    uint64_t SlotCount = 0;
+    const ResourceDataSlot *Slots = NULL;
+    const char *StringPool = NULL;
+    uint64_t StringPoolSize = 0;
+
+    bool Open(const std::byte *mem, uint64_t size);
+    void Save(const std::string &cachePath) const;
+};
+
+std::vector<std::byte> ParseResourceData(std::string &fileName, std::vector<std::byte> &fileBytes, int64_t sourceTime, uint64_t sourceHash);
 uint64_t CalculateResourceFileNameHash(std::string &input);
 
 #endif
\ No newline at end of file
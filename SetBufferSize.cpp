@@ -18,6 +18,7 @@
 
 
 #include <iostream>
+#include <filesystem>
 
 #ifndef _WIN32
 #include <sys/stat.h>
@@ -60,4 +61,27 @@ void SetOptimalBufferSize(std::string driveRootPath)
         BufferSize = 4096;
 
     Buffer = new std::byte[BufferSize];
+}
+
+/**
+ * @brief Set the buffer used for file i/o, if it isn't set yet
+ *
+ */
+void SetBuffer()
+{
+    if (Buffer != NULL)
+        return;
+
+    try {
+        SetOptimalBufferSize(std::filesystem::absolute(".").root_path().string());
+    }
+    catch (...) {
+        std::cout << RED << "ERROR: " << RESET << "Error while determining the optimal buffer size, using 4096 as the default." << std::endl;
+
+        if (Buffer != NULL)
+            delete[] Buffer;
+
+        Buffer = new std::byte[4096];
+        BufferSize = 4096;
+    }
 }
\ No newline at end of file
@@ -2,13 +2,105 @@
 #include <algorithm>
 #include <cstring>
 #include <filesystem>
+#include <fstream>
 
 #include "EternalModLoader.hpp"
 
+// Size of the buffer used to compare mod files left on disk with the container's data
+const int64_t CompareBufferSize = 1024 * 1024;
+
+/**
+ * @brief Check if any other chunk's data is stored in the given range of the container
+ * 
+ * @param resourceContainer ResourceContainer object containing the resources's data
+ * @param dataOffset Offset of the range to check, the data offset of the chunk owning it
+ * @param size Size of the range to check
+ * @return True if the range is shared with another chunk, false otherwise
+ */
+bool IsChunkDataShared(ResourceContainer &resourceContainer, int64_t dataOffset, int64_t size)
+{
+    auto x = resourceContainer.ChunkDataReferences.find(dataOffset);
+
+    if (x != resourceContainer.ChunkDataReferences.end() && x->second > 1)
+        return true;
+
+    auto next = resourceContainer.ChunkDataReferences.upper_bound(dataOffset);
+    return next != resourceContainer.ChunkDataReferences.end() && next->first < dataOffset + size;
+}
+
+/**
+ * @brief Move one reference to a chunk's data from one offset to another
+ * 
+ * @param resourceContainer ResourceContainer object containing the resources's data
+ * @param oldDataOffset Offset the chunk's data was stored at
+ * @param newDataOffset Offset the chunk's data is stored at now
+ */
+void MoveChunkDataReference(ResourceContainer &resourceContainer, int64_t oldDataOffset, int64_t newDataOffset)
+{
+    auto x = resourceContainer.ChunkDataReferences.find(oldDataOffset);
+
+    if (x != resourceContainer.ChunkDataReferences.end() && --x->second <= 0)
+        resourceContainer.ChunkDataReferences.erase(x);
+
+    resourceContainer.ChunkDataReferences[newDataOffset]++;
+}
+
+/**
+ * @brief Check if the mod file's data is identical to the data the chunk currently points to
+ * 
+ * @param storage ContainerStorage object containing the resource to check
+ * @param resourceContainer ResourceContainer object containing the resources's data
+ * @param chunk ResourceChunk object containing the chunk's data
+ * @param modFile ResourceModFile object containing the mod file's data
+ * @return True if identical, false otherwise
+ */
+bool IsChunkDataUnchanged(ContainerStorage &storage, ResourceContainer &resourceContainer, ResourceChunk &chunk, ResourceModFile &modFile)
+{
+    int64_t dataOffset, size;
+    storage.Read(chunk.FileOffset, (std::byte*)&dataOffset, 8);
+    storage.Read(chunk.FileOffset + 8, (std::byte*)&size, 8);
+
+    if (size != modFile.GetSize() || dataOffset < resourceContainer.DataOffset || dataOffset + size > storage.Size)
+        return false;
+
+    // Data replaced earlier in this run hasn't been written yet
+    if (resourceContainer.WriteQueue.IsPending(dataOffset, size))
+        return false;
+
+    if (!modFile.FileSource.has_value())
+        return std::memcmp(modFile.FileBytes.data(), storage.Mem + dataOffset, size) == 0;
+
+    std::ifstream sourceFile(modFile.FileSource.value().Path, std::ios::binary);
+
+    if (!sourceFile.seekg(modFile.FileSource.value().Offset))
+        return false;
+
+    std::vector<std::byte> buffer(std::min<int64_t>(size, CompareBufferSize));
+
+    for (int64_t pos = 0; pos < size; pos += buffer.size()) {
+        int64_t toCompare = std::min<int64_t>(size - pos, buffer.size());
+
+        if (!sourceFile.read((char*)buffer.data(), toCompare))
+            return false;
+
+        if (std::memcmp(buffer.data(), storage.Mem + dataOffset + pos, toCompare) != 0)
+            return false;
+    }
+
+    return true;
+}
+
 /**
  * @brief Set the mod data in the given chunk
+ *
+ * Data identical to the chunk's current data isn't written again.
+ * In fast mode, the data is queued in the container's write queue and only written on commit,
+ * data left on disk being copied straight from its file.
+ * With in-place overwrites enabled, data that fits in the chunk's current slot replaces it there,
+ * unless the slot holds the container's original data, kept for restoring it.
+ * Otherwise it's placed in the smallest unused region of the data section that fits it, or appended if there's none.
  * 
- * @param memoryMappedFile MemoryMappedFile object containing the resource to modify
+ * @param storage ContainerStorage object containing the resource to modify
  * @param resourceContainer ResourceContainer object containing the resources's data
  * @param chunk ResourceChunk object containing the chunk's data
  * @param modFile ResourceModFile object containing the mod file's data
@@ -18,7 +110,7 @@
  * @return True on success, false otherwise
  */
 bool SetModDataForChunk(
-    MemoryMappedFile &memoryMappedFile,
+    ContainerStorage &storage,
     ResourceContainer &resourceContainer,
     ResourceChunk &chunk,
     ResourceModFile &modFile,
@@ -29,31 +121,62 @@ bool SetModDataForChunk(
 {
     chunk.Size = uncompressedSize;
     chunk.SizeZ = compressedSize;
-    int64_t resourceFileSize = memoryMappedFile.Size;
+    int64_t resourceFileSize = storage.Size;
 
-    if (!SlowMode) {
-        int64_t dataSectionLength = resourceFileSize - resourceContainer.DataOffset;
-        int64_t placement = 0x10 - (dataSectionLength % 0x10) + 0x30;
-        int64_t newContainerSize = resourceFileSize + modFile.FileBytes.size() + placement;
-        int64_t dataOffset = newContainerSize - modFile.FileBytes.size();
+    if (IsChunkDataUnchanged(storage, resourceContainer, chunk, modFile)) {
+        resourceContainer.UnchangedFileCount++;
+    }
+    else if (!SlowMode) {
+        int64_t modFileSize = modFile.GetSize();
+        int64_t dataOffset = -1;
+        int64_t paddingSize = 0;
+
+        int64_t slotOffset, slotSize;
+        storage.Read(chunk.FileOffset, (std::byte*)&slotOffset, 8);
+        storage.Read(chunk.FileOffset + 8, (std::byte*)&slotSize, 8);
+
+        if (InPlaceOverwrite) {
+            if (modFileSize <= slotSize && slotOffset >= std::max(resourceContainer.DataOffset, resourceContainer.OriginalDataEnd)
+                && slotOffset + slotSize <= resourceContainer.WriteQueue.FileSize
+                && !IsChunkDataShared(resourceContainer, slotOffset, slotSize)) {
+                    dataOffset = slotOffset;
+                    paddingSize = slotSize - modFileSize;
+            }
+        }
 
-        if (!memoryMappedFile.ResizeFile(newContainerSize))
-            return false;
+        if (dataOffset == -1)
+            dataOffset = resourceContainer.DataSectionAllocator.Allocate(modFileSize);
+
+        if (dataOffset == -1) {
+            int64_t dataSectionLength = resourceContainer.WriteQueue.FileSize - resourceContainer.DataOffset;
+            int64_t placement = 0x10 - (dataSectionLength % 0x10) + 0x30;
+            dataOffset = resourceContainer.WriteQueue.FileSize + placement;
+            resourceContainer.DataSectionAllocator.AppendedBytes += modFileSize;
+        }
+
+        if (modFile.FileSource.has_value())
+            resourceContainer.WriteQueue.Push(PendingWrite(dataOffset, modFile.FileSource.value()));
+        else
+            resourceContainer.WriteQueue.Push(dataOffset, std::move(modFile.FileBytes));
+
+        // Clear what's left of the old data
+        if (paddingSize > 0)
+            resourceContainer.WriteQueue.Push(dataOffset + modFileSize, std::vector<std::byte>(paddingSize));
 
-        std::copy(modFile.FileBytes.begin(), modFile.FileBytes.end(), memoryMappedFile.Mem + dataOffset);
-        std::copy((std::byte*)&dataOffset, (std::byte*)&dataOffset + 8, memoryMappedFile.Mem + chunk.FileOffset);
+        storage.Write(chunk.FileOffset, (std::byte*)&dataOffset, 8);
+        MoveChunkDataReference(resourceContainer, slotOffset, dataOffset);
     }
     else {
         int64_t fileOffset, size;
-        std::copy(memoryMappedFile.Mem + chunk.FileOffset, memoryMappedFile.Mem + chunk.FileOffset + 8, (std::byte*)&fileOffset);
-        std::copy(memoryMappedFile.Mem + chunk.FileOffset + 8, memoryMappedFile.Mem + chunk.FileOffset + 16, (std::byte*)&size);
+        storage.Read(chunk.FileOffset, (std::byte*)&fileOffset, 8);
+        storage.Read(chunk.FileOffset + 8, (std::byte*)&size, 8);
 
         int64_t sizeDiff = modFile.FileBytes.size() - size;
 
         if (sizeDiff > 0) {
             int64_t newContainerSize = resourceFileSize + sizeDiff;
 
-        if (!memoryMappedFile.ResizeFile(resourceFileSize))
+        if (!storage.Grow(resourceFileSize))
             return false;
 
             int32_t toRead;
@@ -62,20 +185,20 @@ bool SetModDataForChunk(
                 toRead = (resourceFileSize - BufferSize) >= (fileOffset + size) ? BufferSize : (resourceFileSize - fileOffset - size);
                 resourceFileSize -= toRead;
 
-                std::copy(memoryMappedFile.Mem + resourceFileSize, memoryMappedFile.Mem + resourceFileSize + toRead, Buffer);
-                std::copy(Buffer, Buffer + toRead, memoryMappedFile.Mem + resourceFileSize + sizeDiff);
+                storage.Read(resourceFileSize, Buffer, toRead);
+                storage.Write(resourceFileSize + sizeDiff, Buffer, toRead);
             }
 
-            std::copy(modFile.FileBytes.begin(), modFile.FileBytes.end(), memoryMappedFile.Mem + fileOffset);
+            storage.Write(fileOffset, modFile.FileBytes.data(), modFile.FileBytes.size());
         }
         else {
-            std::copy(modFile.FileBytes.begin(), modFile.FileBytes.end(), memoryMappedFile.Mem + fileOffset);
+            storage.Write(fileOffset, modFile.FileBytes.data(), modFile.FileBytes.size());
 
             if (sizeDiff < 0) {
                 std::byte *emptyArray = new std::byte[-sizeDiff];
                 std::memset(emptyArray, 0, -sizeDiff);
 
-                std::copy(emptyArray, emptyArray - sizeDiff, memoryMappedFile.Mem + fileOffset + modFile.FileBytes.size());
+                storage.Write(fileOffset + modFile.FileBytes.size(), emptyArray, -sizeDiff);
                 delete[] emptyArray;
             }
         }
@@ -85,18 +208,18 @@ bool SetModDataForChunk(
             int32_t index = std::distance(resourceContainer.ChunkList.begin(), x);
 
             for (int32_t i = index + 1; i < resourceContainer.ChunkList.size(); i++) {
-                std::copy(memoryMappedFile.Mem + resourceContainer.ChunkList[i].FileOffset, memoryMappedFile.Mem + resourceContainer.ChunkList[i].FileOffset + 8, (std::byte*)&fileOffset);
+                storage.Read(resourceContainer.ChunkList[i].FileOffset, (std::byte*)&fileOffset, 8);
                 int64_t newFileOffset = fileOffset + sizeDiff;
-                std::copy((std::byte*)&newFileOffset, (std::byte*)&newFileOffset + 8, memoryMappedFile.Mem + resourceContainer.ChunkList[i].FileOffset);
+                storage.Write(resourceContainer.ChunkList[i].FileOffset, (std::byte*)&newFileOffset, 8);
             }
         }
     }
 
-    std::copy((std::byte*)&compressedSize, (std::byte*)&compressedSize + 8, memoryMappedFile.Mem + chunk.SizeOffset);
-    std::copy((std::byte*)&uncompressedSize, (std::byte*)&uncompressedSize + 8, memoryMappedFile.Mem + chunk.SizeOffset + 8);
+    storage.Write(chunk.SizeOffset, (std::byte*)&compressedSize, 8);
+    storage.Write(chunk.SizeOffset + 8, (std::byte*)&uncompressedSize, 8);
 
     if (compressionMode != NULL)
-        memoryMappedFile.Mem[chunk.SizeOffset + 0x30] = *compressionMode;
+        storage.Write(chunk.SizeOffset + 0x30, compressionMode, 1);
 
     return true;
 }
\ No newline at end of file
@@ -0,0 +1,216 @@
+/*
+* This file is part of EternalModLoaderCpp (https://github.com/PowerBall253/EternalModLoaderCpp).
+* Copyright (C) 2021 PowerBall253
+*
+* EternalModLoaderCpp is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* EternalModLoaderCpp is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with EternalModLoaderCpp. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <iostream>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+#include "EternalModLoader.hpp"
+
+/**
+ * @brief Get the current size of the given container's metadata, read from its header
+ *
+ * @param containerPath Path to the resource or sound container
+ * @return Size of the metadata, or -1 on error
+ */
+int64_t GetContainerMetadataSize(const std::string &containerPath)
+{
+    std::ifstream containerFile(containerPath, std::ios::binary);
+
+    if (EndsWith(containerPath, ".snd")) {
+        uint32_t infoSize;
+
+        if (!containerFile.seekg(4) || !containerFile.read((char*)&infoSize, 4))
+            return -1;
+
+        return (int64_t)infoSize + 12;
+    }
+
+    int64_t dataOffset;
+
+    if (!containerFile.seekg(0x68) || !containerFile.read((char*)&dataOffset, 8))
+        return -1;
+
+    return dataOffset;
+}
+
+/**
+ * @brief Take a snapshot of the container the first time mods are loaded into it, or load the existing one
+ *
+ * Slow mode overwrites the container's original data, so it discards the snapshot instead.
+ * When only planning, the snapshot is never written.
+ *
+ * @param storage ContainerStorage object containing the container, before any changes
+ * @param metadataSize Size of the container's metadata
+ * @param originalDataEnd Set to the end of the container's original data, which must be left untouched
+ * @param os StringStream to output to
+ * @return True on success, false if the container should be left alone
+ */
+bool PrepareContainerSnapshot(ContainerStorage &storage, int64_t metadataSize, int64_t &originalDataEnd, std::stringstream &os)
+{
+    ContainerSnapshot snapshot;
+    snapshot.ContainerPath = storage.FilePath;
+    originalDataEnd = 0;
+
+    if (SlowMode) {
+        if (snapshot.Exists() && snapshot.Remove())
+            os << RED << "WARNING: " << RESET << "Slow mode overwrites the original data, discarded the snapshot of " << YELLOW << storage.FilePath << RESET << '\n';
+
+        return true;
+    }
+
+    if (!snapshot.Exists() && PlanOnly) {
+        originalDataEnd = storage.Size;
+        return true;
+    }
+
+    if (!snapshot.Exists()) {
+        snapshot.OriginalSize = storage.Size;
+        snapshot.Metadata.resize(metadataSize);
+        storage.Read(0, snapshot.Metadata.data(), snapshot.Metadata.size());
+
+        if (!snapshot.Save()) {
+            os << RED << "ERROR: " << RESET << "Failed to save a snapshot of " << YELLOW << storage.FilePath << RESET << ", skipping" << '\n';
+            return false;
+        }
+
+        originalDataEnd = snapshot.OriginalSize;
+        return true;
+    }
+
+    if (!snapshot.Load(storage.FilePath) || (uint64_t)metadataSize < snapshot.Metadata.size()
+        || snapshot.DisplacedData.size() < std::min<uint64_t>(metadataSize, snapshot.OriginalSize) - snapshot.Metadata.size()) {
+            os << RED << "ERROR: " << RESET << "The snapshot of " << YELLOW << storage.FilePath << RESET << " is corrupted, skipping" << '\n';
+            return false;
+    }
+
+    if (snapshot.RestoreStarted) {
+        os << RED << "ERROR: " << RESET << "The restore of " << YELLOW << storage.FilePath << RESET << " was interrupted, run with --restore again, skipping" << '\n';
+        return false;
+    }
+
+    originalDataEnd = snapshot.OriginalSize;
+    return true;
+}
+
+/**
+ * @brief Save the original data the container's metadata is about to grow over in its snapshot
+ *
+ * Nothing is saved when the container has no snapshot to restore, or when only planning.
+ *
+ * @param storage ContainerStorage object containing the container, before the new metadata is written
+ * @param offset Current size of the container's metadata
+ * @param size Number of bytes the metadata grows by
+ * @param os StringStream to output to
+ * @return True on success, false if the metadata can't be grown without losing the original data
+ */
+bool SaveDisplacedData(ContainerStorage &storage, int64_t offset, int64_t size, std::stringstream &os)
+{
+    ContainerSnapshot snapshot;
+    snapshot.ContainerPath = storage.FilePath;
+
+    if (SlowMode || PlanOnly || MemoryOnly || !snapshot.Exists())
+        return true;
+
+    if (!snapshot.Load(storage.FilePath) || (uint64_t)offset < snapshot.Metadata.size()
+        || offset - snapshot.Metadata.size() > snapshot.DisplacedData.size()) {
+            os << RED << "ERROR: " << RESET << "The snapshot of " << YELLOW << storage.FilePath << RESET << " is corrupted" << '\n';
+            return false;
+    }
+
+    // Only the original data has to be restored, anything past it was appended by mods
+    uint64_t displacedEnd = std::min<uint64_t>(offset + size, snapshot.OriginalSize);
+
+    if (displacedEnd <= (uint64_t)offset)
+        return true;
+
+    snapshot.DisplacedData.resize(displacedEnd - snapshot.Metadata.size());
+
+    if (!storage.Read(offset, snapshot.DisplacedData.data() + offset - snapshot.Metadata.size(), displacedEnd - offset) || !snapshot.Save()) {
+        os << RED << "ERROR: " << RESET << "Failed to save the original data of " << YELLOW << storage.FilePath << RESET << " in its snapshot" << '\n';
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Restore the container to the state it was in when its snapshot was taken, and remove the snapshot
+ *
+ * @param containerPath Path to the container
+ * @return True on success, false otherwise
+ */
+bool RestoreContainer(const std::string &containerPath)
+{
+    ContainerSnapshot snapshot;
+    int64_t metadataSize = GetContainerMetadataSize(containerPath);
+
+    if (!snapshot.Load(containerPath) || metadataSize == -1 || (!snapshot.RestoreStarted && (uint64_t)metadataSize < snapshot.Metadata.size())) {
+        std::cout << RED << "ERROR: " << RESET << "Failed to load the snapshot of " << YELLOW << containerPath << RESET << ", skipping" << '\n';
+        return false;
+    }
+
+    if (!snapshot.Restore() || !snapshot.Remove()) {
+        std::cout << RED << "ERROR: " << RESET << "Failed to restore " << YELLOW << containerPath << RESET << '\n';
+        return false;
+    }
+
+    // The mods recorded in the container's manifest aren't loaded anymore
+    try {
+        std::filesystem::remove(containerPath + ".manifest");
+    }
+    catch (...) {}
+
+    return true;
+}
+
+/**
+ * @brief Restore all the containers with a snapshot to the state they were in when it was taken
+ *
+ */
+void RestoreContainers()
+{
+    std::vector<std::string> containerPaths;
+
+    try {
+        for (auto &file : std::filesystem::recursive_directory_iterator(BasePath)) {
+            if (file.is_regular_file() && file.path().extension() == ".snapshot")
+                containerPaths.push_back(file.path().parent_path().append(file.path().stem().string()).string());
+        }
+    }
+    catch (...) {
+        std::cout << RED << "ERROR: " << RESET << "Failed to look for container snapshots in " << BasePath << std::endl;
+        return;
+    }
+
+    int32_t restoredCount = 0;
+
+    for (auto &containerPath : containerPaths) {
+        if (!RestoreContainer(containerPath))
+            continue;
+
+        if (Verbose)
+            std::cout << "Restored " << YELLOW << containerPath << RESET << "." << '\n';
+
+        restoredCount++;
+    }
+
+    std::cout << "Restored " << GREEN << restoredCount << " container(s)" << RESET << "." << '\n';
+}
\ No newline at end of file
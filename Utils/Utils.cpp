@@ -20,6 +20,8 @@
 #include <vector>
 #include <algorithm>
 #include <cstring>
+#include <cstdint>
+#include <cstddef>
 
 /**
  * @brief Remove all whitespace from a string
@@ -120,4 +122,30 @@ std::string NormalizeResourceFilename(std::string filename)
         filename = filename.substr(filename.find_first_of('#'));
 
     return filename;
+}
+
+/**
+ * @brief Hash the given bytes, eight at a time, to identify their contents
+ *
+ * @param bytes Bytes to hash
+ * @param size Number of bytes to hash
+ * @param hash Hash to continue from, to hash data split in several parts
+ * @return 64-bit hash of the bytes
+ */
+uint64_t HashBytes(const std::byte *bytes, size_t size, uint64_t hash)
+{
+    size_t pos = 0;
+
+    for (; pos + 8 <= size; pos += 8) {
+        uint64_t word;
+        std::memcpy(&word, bytes + pos, 8);
+
+        hash = (hash ^ word) * 0x100000001B3;
+        hash ^= hash >> 29;
+    }
+
+    for (; pos < size; pos++)
+        hash = (hash ^ (uint8_t)bytes[pos]) * 0x100000001B3;
+
+    return hash;
 }
\ No newline at end of file
@@ -25,5 +25,6 @@ std::vector<std::string> SplitString(std::string stringToSplit, char delimiter);
 bool EndsWith(const std::string &fullString, const std::string &suffix);
 bool StartsWith(const std::string &fullString, const std::string &prefix);
 std::string NormalizeResourceFilename(std::string filename);
+uint64_t HashBytes(const std::byte *bytes, size_t size, uint64_t hash = 0xCBF29CE484222325);
 
 #endif
\ No newline at end of file
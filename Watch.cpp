@@ -0,0 +1,197 @@
+/*
+* This file is part of EternalModLoaderCpp (https://github.com/PowerBall253/EternalModLoaderCpp).
+* Copyright (C) 2021 PowerBall253
+*
+* EternalModLoaderCpp is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* EternalModLoaderCpp is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with EternalModLoaderCpp. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <iostream>
+#include <filesystem>
+#include <map>
+
+#ifdef __linux__
+#include <cerrno>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#endif
+
+#include "ModLoader/ModLoader.hpp"
+
+// Time without changes to the Mods folder to wait for before loading the mods again
+const int32_t DebounceMilliseconds = 500;
+
+// Longest time to wait for changes to the Mods folder before checking if watching should stop
+const int32_t StopCheckMilliseconds = 200;
+
+/**
+ * @brief Load the mods again into the containers whose mods changed
+ *
+ * The mods are discovered and applied like on the first run, reusing the rs_data index, container paths and parsed PackageMapSpec file.
+ * Containers mod files were removed from, or whose EternalMod files changed, are restored from their snapshot first,
+ * so the old files' data doesn't stay in them.
+ */
+void ModLoader::ReloadMods()
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+
+    if (!DiscoverMods(DiscoveryMode::Load, GamePath + Separator + "Mods", true))
+        return;
+
+    ApplyMods();
+
+    TextureCompressionCache.Clear();
+    TextureCompressionCache.Prune();
+
+    PrintTimings();
+}
+
+#ifdef __linux__
+/**
+ * @brief Watch the given directory and all its subdirectories
+ *
+ * @param inotifyDescriptor inotify instance's file descriptor
+ * @param directoryPath Path to the directory to watch
+ * @param watchedDirectories Map to add the watched directories to, keyed by their watch descriptor
+ * @return True on success, false otherwise
+ */
+bool AddDirectoryWatches(int inotifyDescriptor, const std::string &directoryPath, std::map<int, std::string> &watchedDirectories)
+{
+    const uint32_t watchMask = IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF;
+    std::vector<std::string> directoryPaths = { directoryPath };
+
+    try {
+        for (auto &file : std::filesystem::recursive_directory_iterator(directoryPath)) {
+            if (file.is_directory())
+                directoryPaths.push_back(file.path().string());
+        }
+    }
+    catch (...) {
+        return false;
+    }
+
+    for (auto &path : directoryPaths) {
+        int watchDescriptor = inotify_add_watch(inotifyDescriptor, path.c_str(), watchMask);
+
+        if (watchDescriptor == -1)
+            return false;
+
+        watchedDirectories[watchDescriptor] = path;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Read the pending events of the inotify instance, and watch the directories created
+ *
+ * @param inotifyDescriptor inotify instance's file descriptor
+ * @param watchedDirectories Map of the watched directories, keyed by their watch descriptor
+ * @return True on success, false otherwise
+ */
+bool ReadWatchEvents(int inotifyDescriptor, std::map<int, std::string> &watchedDirectories)
+{
+    alignas(struct inotify_event) char eventBuffer[64 * 1024];
+    ssize_t readBytes = read(inotifyDescriptor, eventBuffer, sizeof(eventBuffer));
+
+    if (readBytes <= 0)
+        return false;
+
+    for (char *eventPos = eventBuffer; eventPos < eventBuffer + readBytes;) {
+        struct inotify_event *event = (struct inotify_event*)eventPos;
+        eventPos += sizeof(struct inotify_event) + event->len;
+
+        if (event->mask & IN_IGNORED) {
+            watchedDirectories.erase(event->wd);
+            continue;
+        }
+
+        auto watchedDirectory = watchedDirectories.find(event->wd);
+
+        if (watchedDirectory == watchedDirectories.end() || event->len == 0)
+            continue;
+
+        if ((event->mask & IN_ISDIR) && (event->mask & (IN_CREATE | IN_MOVED_TO)))
+            AddDirectoryWatches(inotifyDescriptor, watchedDirectory->second + Separator + event->name, watchedDirectories);
+    }
+
+    return true;
+}
+#endif
+
+/**
+ * @brief Keep running, and load the mods again whenever the Mods folder changes
+ *
+ * Changes are debounced: mods are only loaded again once the folder stopped changing for a moment,
+ * so a file being saved or a zip being copied triggers a single run.
+ * Stop requests are checked between waits, and aren't handled while the mods are being loaded again.
+ *
+ * @param modsPath Path to the Mods folder
+ * @return Exit code indicating failure if watching failed, or 0 if it was stopped with StopWatching()
+ */
+int32_t ModLoader::WatchMods(const std::string &modsPath)
+{
+#ifdef __linux__
+    std::map<int, std::string> watchedDirectories;
+    int inotifyDescriptor = inotify_init1(IN_CLOEXEC);
+
+    if (inotifyDescriptor == -1 || !AddDirectoryWatches(inotifyDescriptor, modsPath, watchedDirectories)) {
+        std::cout << RED << "ERROR: " << RESET << "Failed to watch " << modsPath << " for changes" << std::endl;
+
+        if (inotifyDescriptor != -1)
+            close(inotifyDescriptor);
+
+        return 1;
+    }
+
+    std::cout << YELLOW << "INFO: Watching " << modsPath << " for changes, press Ctrl+C to stop." << RESET << std::endl;
+
+    struct pollfd pollDescriptor = { inotifyDescriptor, POLLIN, 0 };
+
+    while (!watchedDirectories.empty() && !IsWatchStopRequested) {
+        // Wait for a change, checking if watching should stop in between
+        int pollResult = poll(&pollDescriptor, 1, StopCheckMilliseconds);
+
+        if (pollResult == 0 || (pollResult == -1 && errno == EINTR))
+            continue;
+
+        if (pollResult == -1 || !ReadWatchEvents(inotifyDescriptor, watchedDirectories))
+            break;
+
+        // Wait for the changes to settle
+        while (!IsWatchStopRequested && poll(&pollDescriptor, 1, DebounceMilliseconds) > 0) {
+            if (!ReadWatchEvents(inotifyDescriptor, watchedDirectories))
+                break;
+        }
+
+        if (IsWatchStopRequested)
+            break;
+
+        ReloadMods();
+    }
+
+    close(inotifyDescriptor);
+
+    if (IsWatchStopRequested) {
+        std::cout << YELLOW << "INFO: Stopped watching " << modsPath << " for changes." << RESET << std::endl;
+        return 0;
+    }
+
+    std::cout << RED << "ERROR: " << RESET << "Stopped watching " << modsPath << " for changes" << std::endl;
+#else
+    std::cout << RED << "ERROR: " << RESET << "Watch mode is only supported on Linux." << std::endl;
+#endif
+
+    return 1;
+}
\ No newline at end of file
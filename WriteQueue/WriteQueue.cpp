@@ -0,0 +1,814 @@
+/*
+* This file is part of EternalModLoaderCpp (https://github.com/PowerBall253/EternalModLoaderCpp).
+* Copyright (C) 2021 PowerBall253
+*
+* EternalModLoaderCpp is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* EternalModLoaderCpp is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with EternalModLoaderCpp. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <atomic>
+#include <fstream>
+#include <map>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <linux/fs.h>
+#include <cerrno>
+#include <cstdlib>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define HAS_STREAMING_STORES
+#endif
+
+#include "WriteQueue/WriteQueue.hpp"
+#include "IoUring/IoUring.hpp"
+
+extern bool MultiThreading;
+extern bool StreamingStores;
+extern WriteBackend PayloadWriteBackend;
+extern bool DirectIo;
+
+// Payloads are split in slices of this size so a single big texture can be copied by several threads
+const size_t CopySliceSize = 8 * 1024 * 1024;
+
+// Payloads at least this big bypass the CPU caches when streaming stores are enabled
+const size_t StreamingCopyThreshold = 64 * 1024 * 1024;
+
+// Maximum size of a single write with the pwrite and io_uring backends
+const int64_t IoWriteSize = 1024 * 1024;
+
+// Number of writes kept in flight with the io_uring backend
+const uint32_t IoUringQueueDepth = 64;
+
+// Number of containers being loaded at the same time, sharing the hardware threads with their copies
+std::atomic<int32_t> ActiveContainerCount = 0;
+
+// Number of registered staging buffers for direct writes with the io_uring backend
+const int32_t IoUringStagingBufferCount = 16;
+
+// Pieces at least this big are written with direct I/O when enabled, in blocks of this alignment
+const int64_t DirectIoThreshold = 4 * 1024 * 1024;
+const int64_t DirectIoAlignment = 4096;
+
+/**
+ * @brief Part of a queued write not overwritten by later writes
+ *
+ */
+class WritePiece {
+public:
+    int64_t Offset;
+    int64_t Size;
+    PendingWrite *Write;
+};
+
+/**
+ * @brief Copy slice class
+ *
+ */
+class CopySlice {
+public:
+    std::byte *Dest;
+    const std::byte *Src;
+    size_t Size;
+    bool Streaming;
+};
+
+#ifdef HAS_STREAMING_STORES
+/**
+ * @brief Copy the given data with non-temporal stores, without polluting the CPU caches
+ *
+ * @param dest Destination pointer
+ * @param src Source pointer
+ * @param size Number of bytes to copy
+ */
+void StreamingCopy(std::byte *dest, const std::byte *src, size_t size)
+{
+    size_t head = (16 - ((uintptr_t)dest & 15)) & 15;
+
+    if (head > size)
+        head = size;
+
+    std::memcpy(dest, src, head);
+    dest += head;
+    src += head;
+    size -= head;
+
+    while (size >= 64) {
+        __m128i a = _mm_loadu_si128((const __m128i*)src);
+        __m128i b = _mm_loadu_si128((const __m128i*)(src + 16));
+        __m128i c = _mm_loadu_si128((const __m128i*)(src + 32));
+        __m128i d = _mm_loadu_si128((const __m128i*)(src + 48));
+        _mm_stream_si128((__m128i*)dest, a);
+        _mm_stream_si128((__m128i*)(dest + 16), b);
+        _mm_stream_si128((__m128i*)(dest + 32), c);
+        _mm_stream_si128((__m128i*)(dest + 48), d);
+
+        dest += 64;
+        src += 64;
+        size -= 64;
+    }
+
+    while (size >= 16) {
+        _mm_stream_si128((__m128i*)dest, _mm_loadu_si128((const __m128i*)src));
+
+        dest += 16;
+        src += 16;
+        size -= 16;
+    }
+
+    std::memcpy(dest, src, size);
+    _mm_sfence();
+}
+#endif
+
+/**
+ * @brief Copy the given slices, using as many threads as useful
+ *
+ * The hardware threads are shared with the other containers being loaded at the same time,
+ * so a run over many containers doesn't start a copy thread per hardware thread in each of them.
+ *
+ * @param slices Vector containing the slices to copy
+ */
+void CopySlices(std::vector<CopySlice> &slices)
+{
+    size_t threadCount = 1;
+
+    if (MultiThreading) {
+        size_t hardwareThreadCount = std::max(std::thread::hardware_concurrency(), 1U);
+        size_t activeContainerCount = std::max<int32_t>(ActiveContainerCount, 1);
+        threadCount = std::min<size_t>(std::max<size_t>(hardwareThreadCount / activeContainerCount, 1), slices.size());
+    }
+
+    std::atomic<size_t> nextSlice = 0;
+
+    auto copyWorker = [&slices, &nextSlice]() {
+        for (size_t i = nextSlice++; i < slices.size(); i = nextSlice++) {
+#ifdef HAS_STREAMING_STORES
+            if (slices[i].Streaming) {
+                StreamingCopy(slices[i].Dest, slices[i].Src, slices[i].Size);
+                continue;
+            }
+#endif
+            std::memcpy(slices[i].Dest, slices[i].Src, slices[i].Size);
+        }
+    };
+
+    if (threadCount <= 1) {
+        copyWorker();
+        return;
+    }
+
+    std::vector<std::thread> copyThreads;
+    copyThreads.reserve(threadCount - 1);
+
+    for (size_t i = 0; i < threadCount - 1; i++)
+        copyThreads.push_back(std::thread(copyWorker));
+
+    copyWorker();
+
+    for (auto &thread : copyThreads)
+        thread.join();
+}
+
+#ifdef __linux__
+/**
+ * @brief Share the given range of a file with the container, on filesystems supporting reflinks
+ *
+ * @param containerFileDescriptor File descriptor of the container
+ * @param sourceFileDescriptor File descriptor of the source file
+ * @param source Range of the source file to share
+ * @param offset Offset in the container to share the range at
+ * @return True on success, false otherwise
+ */
+bool CloneFileRange(int containerFileDescriptor, int sourceFileDescriptor, FileRange &source, int64_t offset)
+{
+    struct stat containerInfo;
+
+    if (fstat(containerFileDescriptor, &containerInfo) == -1 || containerInfo.st_blksize <= 0)
+        return false;
+
+    // Both ranges must start and end on block boundaries
+    int64_t blockSize = containerInfo.st_blksize;
+
+    if (source.Offset % blockSize != 0 || offset % blockSize != 0 || source.Size % blockSize != 0)
+        return false;
+
+    struct file_clone_range cloneRange;
+    cloneRange.src_fd = sourceFileDescriptor;
+    cloneRange.src_offset = source.Offset;
+    cloneRange.src_length = source.Size;
+    cloneRange.dest_offset = offset;
+
+    return ioctl(containerFileDescriptor, FICLONERANGE, &cloneRange) == 0;
+}
+
+/**
+ * @brief Copy the given range of a file into the container inside the kernel
+ *
+ * @param containerFileDescriptor File descriptor of the container
+ * @param sourceFileDescriptor File descriptor of the source file
+ * @param source Range of the source file to copy
+ * @param offset Offset in the container to copy the range to
+ * @return True on success, false otherwise
+ */
+bool KernelCopyFileRange(int containerFileDescriptor, int sourceFileDescriptor, FileRange &source, int64_t offset)
+{
+    loff_t sourceOffset = source.Offset;
+    loff_t containerOffset = offset;
+    int64_t remaining = source.Size;
+
+    while (remaining > 0) {
+        ssize_t copied = copy_file_range(sourceFileDescriptor, &sourceOffset, containerFileDescriptor, &containerOffset, remaining, 0);
+
+        if (copied <= 0)
+            return false;
+
+        remaining -= copied;
+    }
+
+    return true;
+}
+#endif
+
+/**
+ * @brief Copy the given range of a file into the container
+ *
+ * The kernel is asked to share or copy the range first, and the range is read into the memory mapped file if it can't.
+ *
+ * @param storage ContainerStorage object to write to
+ * @param containerFileDescriptor File descriptor of the container, or -1 if not available
+ * @param source Range of the source file to copy
+ * @param offset Offset in the container to copy the range to
+ * @return True on success, false otherwise
+ */
+bool CopyFileRange(ContainerStorage &storage, int containerFileDescriptor, FileRange &source, int64_t offset)
+{
+#ifdef __linux__
+    if (containerFileDescriptor != -1) {
+        int sourceFileDescriptor = open(source.Path.c_str(), O_RDONLY);
+
+        if (sourceFileDescriptor != -1) {
+            bool copied = CloneFileRange(containerFileDescriptor, sourceFileDescriptor, source, offset)
+                || KernelCopyFileRange(containerFileDescriptor, sourceFileDescriptor, source, offset);
+
+            close(sourceFileDescriptor);
+
+            if (copied)
+                return true;
+        }
+    }
+#endif
+
+    std::ifstream sourceFile(source.Path, std::ios::binary);
+
+    if (!sourceFile.seekg(source.Offset))
+        return false;
+
+    return (bool)sourceFile.read((char*)storage.Mem + offset, source.Size);
+}
+
+#ifdef __linux__
+/**
+ * @brief Part of a payload written with a single system call or io_uring request
+ *
+ */
+class FileWrite {
+public:
+    const std::byte *Data;
+    int64_t Offset;
+    int64_t Size;
+    int64_t Written = 0;
+    bool Direct = false;
+};
+
+/**
+ * @brief Split the pieces held in memory in writes of at most IoWriteSize bytes
+ *
+ * With direct I/O, the block aligned interior of big pieces is written bypassing the page cache,
+ * and the unaligned head and tail go through it.
+ *
+ * @param pieces Pieces to split
+ * @param directIo Whether to use direct I/O for big pieces
+ * @return Vector containing the writes, in container offset order
+ */
+std::vector<FileWrite> SplitFileWrites(std::vector<WritePiece> &pieces, bool directIo)
+{
+    std::vector<FileWrite> writes;
+
+    auto addWrites = [&writes](const std::byte *data, int64_t offset, int64_t size, bool direct) {
+        for (int64_t pos = 0; pos < size; pos += IoWriteSize) {
+            FileWrite write;
+            write.Data = data + pos;
+            write.Offset = offset + pos;
+            write.Size = std::min<int64_t>(IoWriteSize, size - pos);
+            write.Direct = direct;
+            writes.push_back(write);
+        }
+    };
+
+    for (auto &piece : pieces) {
+        const std::byte *data = piece.Write->Bytes.data() + (piece.Offset - piece.Write->Offset);
+        int64_t alignedStart = (piece.Offset + DirectIoAlignment - 1) / DirectIoAlignment * DirectIoAlignment;
+        int64_t alignedEnd = (piece.Offset + piece.Size) / DirectIoAlignment * DirectIoAlignment;
+
+        if (!directIo || piece.Size < DirectIoThreshold || alignedEnd - alignedStart < DirectIoAlignment) {
+            addWrites(data, piece.Offset, piece.Size, false);
+            continue;
+        }
+
+        addWrites(data, piece.Offset, alignedStart - piece.Offset, false);
+        addWrites(data + (alignedStart - piece.Offset), alignedStart, alignedEnd - alignedStart, true);
+        addWrites(data + (alignedEnd - piece.Offset), alignedEnd, piece.Offset + piece.Size - alignedEnd, false);
+    }
+
+    return writes;
+}
+
+/**
+ * @brief Write the whole buffer to the file at the given offset
+ *
+ * @param fileDescriptor File descriptor to write to
+ * @param data Bytes to write
+ * @param size Number of bytes to write
+ * @param offset Offset in the file to write the bytes to
+ * @return True on success, false otherwise
+ */
+bool WriteAll(int fileDescriptor, const std::byte *data, int64_t size, int64_t offset)
+{
+    while (size > 0) {
+        ssize_t written = pwrite(fileDescriptor, data, size, offset);
+
+        if (written == -1) {
+            if (errno == EINTR)
+                continue;
+
+            return false;
+        }
+
+        data += written;
+        size -= written;
+        offset += written;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Write the given writes one by one with pwrite
+ *
+ * Direct writes go through an aligned staging buffer, and fall back to buffered writes if they fail.
+ *
+ * @param fileDescriptor File descriptor of the container
+ * @param directFileDescriptor File descriptor of the container opened for direct I/O, or -1 if not available
+ * @param writes Writes to do
+ * @return True on success, false otherwise
+ */
+bool PwriteFileWrites(int fileDescriptor, int directFileDescriptor, std::vector<FileWrite> &writes)
+{
+    std::byte *stagingBuffer = NULL;
+
+    if (directFileDescriptor != -1)
+        stagingBuffer = (std::byte*)aligned_alloc(DirectIoAlignment, IoWriteSize);
+
+    bool success = true;
+
+    for (auto &write : writes) {
+        if (write.Direct && stagingBuffer != NULL) {
+            std::memcpy(stagingBuffer, write.Data, write.Size);
+
+            if (pwrite(directFileDescriptor, stagingBuffer, write.Size, write.Offset) == write.Size)
+                continue;
+        }
+
+        success = WriteAll(fileDescriptor, write.Data, write.Size, write.Offset) && success;
+    }
+
+    free(stagingBuffer);
+
+    return success;
+}
+
+/**
+ * @brief Write the given writes with io_uring, keeping up to the ring's size in flight
+ *
+ * Buffered writes are submitted straight from the payloads' memory.
+ * Direct writes are staged in registered, aligned buffers, and retried buffered if they fail or come up short.
+ *
+ * @param ring Initialized IoUring object to use
+ * @param fileDescriptor File descriptor of the container
+ * @param directFileDescriptor File descriptor of the container opened for direct I/O, or -1 if not available
+ * @param writes Writes to do
+ * @return True on success, false otherwise
+ */
+bool IoUringFileWrites(IoUring &ring, int fileDescriptor, int directFileDescriptor, std::vector<FileWrite> &writes)
+{
+    std::vector<std::byte*> stagingBuffers;
+
+    if (directFileDescriptor != -1 && std::any_of(writes.begin(), writes.end(), [](FileWrite &write) { return write.Direct; })) {
+        for (int32_t i = 0; i < IoUringStagingBufferCount; i++)
+            stagingBuffers.push_back((std::byte*)aligned_alloc(DirectIoAlignment, IoWriteSize));
+
+        ring.RegisterBuffers(stagingBuffers, IoWriteSize);
+    }
+
+    std::vector<int32_t> freeBuffers;
+    std::vector<int32_t> writeBuffers(writes.size(), -1);
+
+    for (int32_t i = stagingBuffers.size() - 1; i >= 0; i--)
+        freeBuffers.push_back(i);
+
+    // Writes left to submit, the next one at the back
+    std::vector<uint64_t> toSubmit;
+
+    for (size_t i = writes.size(); i > 0; i--) {
+        if (writes[i - 1].Direct && stagingBuffers.empty())
+            writes[i - 1].Direct = false;
+
+        toSubmit.push_back(i - 1);
+    }
+
+    uint32_t inFlight = 0;
+    bool success = true;
+
+    while (success && (!toSubmit.empty() || inFlight > 0)) {
+        while (!toSubmit.empty() && inFlight < ring.Entries) {
+            uint64_t index = toSubmit.back();
+            FileWrite &write = writes[index];
+            int32_t bufferIndex = -1;
+            const std::byte *data = write.Data + write.Written;
+            int targetFileDescriptor = fileDescriptor;
+
+            if (write.Direct) {
+                if (freeBuffers.empty())
+                    break;
+
+                bufferIndex = freeBuffers.back();
+                std::memcpy(stagingBuffers[bufferIndex], write.Data, write.Size);
+                data = stagingBuffers[bufferIndex];
+                targetFileDescriptor = directFileDescriptor;
+            }
+
+            if (!ring.PrepareWrite(targetFileDescriptor, data, write.Size - write.Written, write.Offset + write.Written, bufferIndex, index))
+                break;
+
+            if (bufferIndex != -1) {
+                freeBuffers.pop_back();
+                writeBuffers[index] = bufferIndex;
+            }
+
+            toSubmit.pop_back();
+            inFlight++;
+        }
+
+        if (!ring.Submit(inFlight > 0 ? 1 : 0)) {
+            success = false;
+            break;
+        }
+
+        uint64_t index;
+        int32_t result;
+
+        while (ring.PopCompletion(index, result)) {
+            inFlight--;
+            FileWrite &write = writes[index];
+
+            if (writeBuffers[index] != -1) {
+                freeBuffers.push_back(writeBuffers[index]);
+                writeBuffers[index] = -1;
+            }
+
+            if (result == -EINTR || result == -EAGAIN) {
+                toSubmit.push_back(index);
+                continue;
+            }
+
+            if (write.Direct && result != write.Size) {
+                write.Direct = false;
+                toSubmit.push_back(index);
+                continue;
+            }
+
+            if (result <= 0) {
+                success = WriteAll(fileDescriptor, write.Data + write.Written, write.Size - write.Written, write.Offset + write.Written) && success;
+                continue;
+            }
+
+            write.Written += result;
+
+            if (write.Written < write.Size)
+                toSubmit.push_back(index);
+        }
+    }
+
+    // The kernel may still be reading from the staging buffers
+    while (inFlight > 0 && ring.Submit(1)) {
+        uint64_t index;
+        int32_t result;
+
+        while (ring.PopCompletion(index, result))
+            inFlight--;
+    }
+
+    if (inFlight == 0) {
+        for (auto &buffer : stagingBuffers)
+            free(buffer);
+    }
+
+    return success;
+}
+
+/**
+ * @brief Write the pieces held in memory to the container through its file descriptor, with the selected backend
+ *
+ * The io_uring backend falls back to pwrite if a ring can't be set up.
+ *
+ * @param path Path to the container
+ * @param pieces Pieces to write
+ * @return True on success, false otherwise
+ */
+bool WriteFilePieces(const std::string &path, std::vector<WritePiece> &pieces)
+{
+    int fileDescriptor = open(path.c_str(), O_RDWR);
+
+    if (fileDescriptor == -1)
+        return false;
+
+    int directFileDescriptor = DirectIo ? open(path.c_str(), O_RDWR | O_DIRECT) : -1;
+    std::vector<FileWrite> writes = SplitFileWrites(pieces, directFileDescriptor != -1);
+    bool success;
+
+    IoUring ring;
+
+    if (PayloadWriteBackend == WriteBackend::IoUring && ring.Init(IoUringQueueDepth))
+        success = IoUringFileWrites(ring, fileDescriptor, directFileDescriptor, writes);
+    else
+        success = PwriteFileWrites(fileDescriptor, directFileDescriptor, writes);
+
+    if (directFileDescriptor != -1)
+        close(directFileDescriptor);
+
+    close(fileDescriptor);
+
+    return success;
+}
+#endif
+
+/**
+ * @brief Reset the queue for a container of the given size
+ *
+ * The number of bytes committed so far is kept.
+ *
+ * @param fileSize Current size of the container
+ */
+void WriteQueue::Reset(uint64_t fileSize)
+{
+    Writes.clear();
+    FileSize = fileSize;
+}
+
+/**
+ * @brief Queue a write of the given bytes
+ *
+ * @param offset Offset in the container to write the bytes to
+ * @param bytes Bytes to write
+ */
+void WriteQueue::Push(int64_t offset, std::vector<std::byte> bytes)
+{
+    Push(PendingWrite(offset, std::move(bytes)));
+}
+
+/**
+ * @brief Queue the given write
+ *
+ * @param write PendingWrite object to queue
+ */
+void WriteQueue::Push(PendingWrite write)
+{
+    int64_t end = write.Offset + write.Size();
+
+    if (end > FileSize)
+        FileSize = end;
+
+    bool partialOverlap = false;
+
+    for (int32_t i = Writes.size() - 1; i >= 0; i--) {
+        int64_t writeEnd = Writes[i].Offset + Writes[i].Size();
+
+        if (Writes[i].Offset >= end || write.Offset >= writeEnd)
+            continue;
+
+        // Overwrite a pending write from within: patch its bytes
+        if (write.Offset >= Writes[i].Offset && end <= writeEnd && !partialOverlap
+            && !write.Source.has_value() && !Writes[i].Source.has_value()) {
+                std::copy(write.Bytes.begin(), write.Bytes.end(), Writes[i].Bytes.begin() + (write.Offset - Writes[i].Offset));
+                return;
+        }
+
+        // Completely replaced by the new write
+        if (write.Offset <= Writes[i].Offset && end >= writeEnd) {
+            Writes.erase(Writes.begin() + i);
+            continue;
+        }
+
+        partialOverlap = true;
+    }
+
+    Writes.push_back(std::move(write));
+}
+
+/**
+ * @brief Get the parts of the queued writes that aren't overwritten by a later write, sorted by offset
+ *
+ * @param writes Vector containing the queued writes, in queue order
+ * @return Vector containing the disjoint pieces to copy
+ */
+std::vector<WritePiece> GetVisiblePieces(std::vector<PendingWrite> &writes)
+{
+    std::vector<WritePiece> pieces;
+    std::map<int64_t, int64_t> coveredRanges;
+
+    for (int32_t i = writes.size() - 1; i >= 0; i--) {
+        int64_t start = writes[i].Offset;
+        int64_t end = start + writes[i].Size();
+
+        if (start == end)
+            continue;
+
+        auto x = coveredRanges.upper_bound(start);
+
+        if (x != coveredRanges.begin() && std::prev(x)->second > start)
+            x = std::prev(x);
+
+        for (int64_t position = start; position < end; x++) {
+            if (x == coveredRanges.end() || x->first >= end) {
+                pieces.push_back(WritePiece{ position, end - position, &writes[i] });
+                break;
+            }
+
+            if (x->first > position)
+                pieces.push_back(WritePiece{ position, x->first - position, &writes[i] });
+
+            position = std::max(position, x->second);
+        }
+
+        // Merge the write's range into the covered ranges
+        auto y = coveredRanges.lower_bound(start);
+
+        if (y != coveredRanges.begin() && std::prev(y)->second >= start)
+            y = std::prev(y);
+
+        while (y != coveredRanges.end() && y->first <= end) {
+            start = std::min(start, y->first);
+            end = std::max(end, y->second);
+            y = coveredRanges.erase(y);
+        }
+
+        coveredRanges[start] = end;
+    }
+
+    std::sort(pieces.begin(), pieces.end(),
+        [](const WritePiece &piece1, const WritePiece &piece2) { return piece1.Offset < piece2.Offset; });
+
+    return pieces;
+}
+
+/**
+ * @brief Grow the container to its final size and copy all queued writes into it
+ *
+ * Where writes overlap, the one queued last wins, and all copies are done in container offset order.
+ *
+ * @param storage ContainerStorage object to write to
+ * @return True on success, false otherwise
+ */
+bool WriteQueue::Commit(ContainerStorage &storage)
+{
+    if (DryRun) {
+        for (auto &piece : GetVisiblePieces(Writes))
+            CommittedBytes += piece.Size;
+
+        Writes.clear();
+        return true;
+    }
+
+    if (FileSize > storage.Size) {
+        if (!storage.Grow(FileSize))
+            return false;
+    }
+
+    for (auto &write : Writes) {
+        if (write.Offset < 0 || write.Offset + write.Size() > storage.Size)
+            return false;
+    }
+
+    std::vector<WritePiece> pieces = GetVisiblePieces(Writes);
+    std::vector<CopySlice> slices;
+    std::vector<WritePiece> memoryPieces;
+    std::vector<WritePiece> filePieces;
+
+    for (auto &piece : pieces) {
+        CommittedBytes += piece.Size;
+
+        if (piece.Write->Source.has_value())
+            filePieces.push_back(piece);
+        else
+            memoryPieces.push_back(piece);
+    }
+
+    bool success = true;
+
+#ifdef __linux__
+    // Copy through the mapping instead if the container can't be written to directly
+    if (PayloadWriteBackend != WriteBackend::Mmap && !memoryPieces.empty() && WriteFilePieces(storage.FilePath, memoryPieces))
+        memoryPieces.clear();
+#endif
+
+    for (auto &piece : memoryPieces) {
+        bool streaming = StreamingStores && piece.Write->Bytes.size() >= StreamingCopyThreshold;
+        const std::byte *src = piece.Write->Bytes.data() + (piece.Offset - piece.Write->Offset);
+
+        for (int64_t pos = 0; pos < piece.Size; pos += CopySliceSize) {
+            CopySlice slice;
+            slice.Dest = storage.Mem + piece.Offset + pos;
+            slice.Src = src + pos;
+            slice.Size = std::min<int64_t>(CopySliceSize, piece.Size - pos);
+            slice.Streaming = streaming;
+            slices.push_back(slice);
+        }
+    }
+
+    CopySlices(slices);
+
+    int containerFileDescriptor = -1;
+
+#ifdef __linux__
+    if (!filePieces.empty())
+        containerFileDescriptor = open(storage.FilePath.c_str(), O_RDWR);
+#endif
+
+    for (auto &piece : filePieces) {
+        FileRange &source = piece.Write->Source.value();
+        FileRange pieceSource(source.Path, source.Offset + (piece.Offset - piece.Write->Offset), piece.Size);
+        success = CopyFileRange(storage, containerFileDescriptor, pieceSource, piece.Offset) && success;
+    }
+
+#ifdef __linux__
+    if (containerFileDescriptor != -1)
+        close(containerFileDescriptor);
+#endif
+
+    Writes.clear();
+
+    return success;
+}
+
+/**
+ * @brief Check if any pending write overlaps the given range
+ *
+ * @param offset Offset of the range to check
+ * @param size Size of the range to check
+ * @return True if the range has pending writes, false otherwise
+ */
+bool WriteQueue::IsPending(int64_t offset, int64_t size)
+{
+    for (auto &write : Writes) {
+        if (write.Offset < offset + size && offset < write.Offset + write.Size())
+            return true;
+    }
+
+    return false;
+}
+
+/**
+ * @brief Commit the queue if any pending write overlaps the given range, so it can be read back
+ *
+ * @param storage ContainerStorage object to write to
+ * @param offset Offset of the range to read
+ * @param size Size of the range to read
+ * @return True on success, false otherwise
+ */
+bool WriteQueue::CommitIfPending(ContainerStorage &storage, int64_t offset, int64_t size)
+{
+    if (IsPending(offset, size))
+        return Commit(storage);
+
+    return true;
+}
\ No newline at end of file
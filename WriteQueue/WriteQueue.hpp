@@ -0,0 +1,136 @@
+/*
+* This file is part of EternalModLoaderCpp (https://github.com/PowerBall253/EternalModLoaderCpp).
+* Copyright (C) 2021 PowerBall253
+*
+* EternalModLoaderCpp is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* EternalModLoaderCpp is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with EternalModLoaderCpp. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef WRITEQUEUE_HPP
+#define WRITEQUEUE_HPP
+
+#include <vector>
+#include <string>
+#include <optional>
+
+#include "ContainerStorage/ContainerStorage.hpp"
+
+/**
+ * @brief Ways to write the payloads held in memory to the container on commit
+ *
+ */
+enum class WriteBackend {
+    Mmap,
+    Pwrite,
+    IoUring
+};
+
+/**
+ * @brief Range of bytes in a file on disk
+ *
+ */
+class FileRange {
+public:
+    std::string Path;
+    int64_t Offset = 0;
+    int64_t Size = 0;
+
+    /**
+     * @brief Construct a new FileRange object
+     *
+     * @param path Path to the file
+     * @param offset Offset of the range in the file
+     * @param size Size of the range
+     */
+    FileRange(std::string path, int64_t offset, int64_t size)
+    {
+        Path = path;
+        Offset = offset;
+        Size = size;
+    }
+
+    FileRange() {}
+};
+
+/**
+ * @brief Pending payload write class
+ *
+ * The payload is either held in memory, or copied from a range of another file on commit.
+ */
+class PendingWrite {
+public:
+    int64_t Offset = 0;
+    std::vector<std::byte> Bytes;
+    std::optional<FileRange> Source = std::nullopt;
+
+    /**
+     * @brief Construct a new PendingWrite object
+     *
+     * @param offset Offset in the container to write the bytes to
+     * @param bytes Bytes to write
+     */
+    PendingWrite(int64_t offset, std::vector<std::byte> bytes)
+    {
+        Offset = offset;
+        Bytes = std::move(bytes);
+    }
+
+    /**
+     * @brief Construct a new PendingWrite object copying from another file
+     *
+     * @param offset Offset in the container to write the bytes to
+     * @param source Range of the file to copy the bytes from
+     */
+    PendingWrite(int64_t offset, FileRange source)
+    {
+        Offset = offset;
+        Source = source;
+    }
+
+    /**
+     * @brief Get the number of bytes to write
+     *
+     * @return Number of bytes to write
+     */
+    int64_t Size() const
+    {
+        return Source.has_value() ? Source.value().Size : Bytes.size();
+    }
+};
+
+/**
+ * @brief Queue of payload writes to a container
+ *
+ * Writes are laid out at fixed offsets when queued, and copied into the
+ * memory mapped file all at once (in parallel, in offset order) on commit.
+ * Writes overlapping earlier ones replace them where they overlap.
+ * Writes from other files are copied by the kernel when possible, without going through memory.
+ * On Linux, payloads held in memory can also be written with pwrite or io_uring instead of through the mapping.
+ * In a dry run, commits only count the bytes that would be written.
+ */
+class WriteQueue {
+public:
+    std::vector<PendingWrite> Writes;
+    uint64_t FileSize = 0;
+    bool DryRun = false;
+    int64_t CommittedBytes = 0;
+
+    void Reset(uint64_t fileSize);
+    void Push(int64_t offset, std::vector<std::byte> bytes);
+    void Push(PendingWrite write);
+    bool Commit(ContainerStorage &storage);
+    bool IsPending(int64_t offset, int64_t size);
+    bool CommitIfPending(ContainerStorage &storage, int64_t offset, int64_t size);
+};
+
+#endif
\ No newline at end of file